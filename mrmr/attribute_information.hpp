@@ -21,68 +21,139 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MRMR_ATTRIBUTE_INFORMATION_HPP
 #define MRMR_ATTRIBUTE_INFORMATION_HPP
 
-#include <array>
-#include <unordered_map>
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
 #include <iterator>
 #include <limits>
-#include <valarray>
+#include <unordered_map>
 #include <vector>
-#include <stdexcept>
+#include "kernels.hpp"
 #include "typedef.hpp"
 
+/*
+ * Summary of a single attribute. The distinct values of the attribute are kept sorted
+ * and each is assigned a dense code, its position in that order, so that columns can be
+ * re-encoded to 0..k-1 and all per-value quantities can be stored in flat arrays.
+ */
 template <typename T>
 class attribute_information {
 	public:
+		using code_type = T;
+
+		attribute_information();
 		template <typename ForwardIterator> attribute_information( ForwardIterator first, ForwardIterator last );
-		T num_values() const;
-		std::vector<T> values() const;
+		attribute_information( std::vector<T> values, std::vector<std::size_t> counts, double entropy );
+		attribute_information( std::vector<T> values, std::vector<std::size_t> counts );
+		std::size_t num_values() const;
+		std::vector<T> const & values() const;
+		T value( code_type code ) const;
 		double entropy() const;
-		probability marginal_probability( T index ) const;
+		probability marginal_probability( T value ) const;
+		std::vector<std::size_t> const & counts() const;
+		std::vector<probability> const & probabilities() const;
+		template <typename ForwardIterator, typename OutputIterator> void encode( ForwardIterator first, ForwardIterator last, OutputIterator out ) const;
+
+		/* Largest value range for which counting and encoding use a direct lookup table. */
+		static const std::size_t lookup_table_limit = 1 << 16;
+
 	private:
 		double _entropy;
-		std::unordered_map< T, probability > _pdf;
 		std::vector<T> _values;
+		std::vector<std::size_t> _counts;
+		std::vector<probability> _probabilities;
 };
 
+template <typename T>
+attribute_information<T>::attribute_information() : _entropy( 0.0 ) {
+}
+
 template <typename T>
 template <typename ForwardIterator>
-attribute_information<T>::attribute_information( ForwardIterator first, ForwardIterator last ) {
+attribute_information<T>::attribute_information( ForwardIterator first, ForwardIterator last ) : _entropy( 0.0 ) {
 	// determine number of elements
 	double count = static_cast< double >( last - first );
+	if( first == last ) {
+		return;
+	}
 
-	while( first != last ) {
-		if ( _pdf.count( *first ) > 0 ) {
-			_pdf[ *first ] += 1;
-		} else {
-			_pdf[ *first ] = 1;
-			_values.push_back( *first );
+	auto range = std::minmax_element( first, last );
+	T min = *range.first;
+	std::size_t table_size = static_cast<std::size_t>( static_cast<std::int64_t>( *range.second ) - static_cast<std::int64_t>( min ) ) + 1;
+
+	if( table_size <= lookup_table_limit ) {
+		std::vector<std::size_t> table( table_size, 0 );
+		for( ForwardIterator it = first; it != last; ++it ) {
+			++table[ static_cast<std::size_t>( static_cast<std::int64_t>( *it ) - static_cast<std::int64_t>( min ) ) ];
+		}
+		for( std::size_t i = 0; i < table_size; ++i ) {
+			if( table[ i ] > 0 ) {
+				_values.push_back( static_cast<T>( static_cast<std::int64_t>( min ) + static_cast<std::int64_t>( i ) ) );
+				_counts.push_back( table[ i ] );
+			}
+		}
+	} else {
+		std::unordered_map< T, std::size_t > table;
+		for( ForwardIterator it = first; it != last; ++it ) {
+			++table[ *it ];
+		}
+		_values.reserve( table.size() );
+		for( auto & entry : table ) {
+			_values.push_back( entry.first );
+		}
+		std::sort( _values.begin(), _values.end() );
+		_counts.reserve( _values.size() );
+		for( auto value : _values ) {
+			_counts.push_back( table[ value ] );
 		}
+	}
 
-		++first;
+	// compute probabilities and entropy
+	_probabilities.resize( _counts.size() );
+	for( std::size_t code = 0; code < _counts.size(); ++code ) {
+		_probabilities[ code ] = _counts[ code ] / count;
 	}
+	_entropy = active_kernels().entropy( _probabilities.data(), _probabilities.size() );
+}
 
-	std::valarray< probability > p( _pdf.size() );
-	int i = 0;
-	for ( auto it = _pdf.begin(); it != _pdf.end(); it++ ) {
-		it->second = it->second / count;
-		p[i++] = it->second;
+/* Restores a summary computed earlier, such as one saved in a binary dataset file. */
+template <typename T>
+attribute_information<T>::attribute_information( std::vector<T> values, std::vector<std::size_t> counts, double entropy ) :
+		_entropy( entropy ), _values( std::move( values ) ), _counts( std::move( counts ) ), _probabilities( _counts.size() ) {
+	assert( _values.size() == _counts.size() );
+	double count = 0.0;
+	for( auto c : _counts ) {
+		count += c;
 	}
+	for( std::size_t code = 0; code < _counts.size(); ++code ) {
+		_probabilities[ code ] = _counts[ code ] / count;
+	}
+}
 
-	// compute entropy
-	_entropy = -1 * ( p * std::log( p ) ).sum() / std::log( 2 );
+/* Summarizes an attribute from the counts of its sorted distinct values, such as counts merged from several parts. */
+template <typename T>
+attribute_information<T>::attribute_information( std::vector<T> values, std::vector<std::size_t> counts ) :
+		attribute_information( std::move( values ), std::move( counts ), 0.0 ) {
+	_entropy = active_kernels().entropy( _probabilities.data(), _probabilities.size() );
 }
 
 template <typename T>
-T attribute_information<T>::num_values() const {
-	return _pdf.size();
+std::size_t attribute_information<T>::num_values() const {
+	return _values.size();
 }
 
 template <typename T>
-std::vector<T> attribute_information<T>::values() const {
+std::vector<T> const & attribute_information<T>::values() const {
 	return _values;
 }
 
+template <typename T>
+T attribute_information<T>::value( code_type code ) const {
+	assert( static_cast<std::size_t>( code ) < _values.size() );
+	return _values[ static_cast<std::size_t>( code ) ];
+}
+
 template <typename T>
 double attribute_information<T>::entropy() const {
 	return _entropy;
@@ -90,11 +161,48 @@ double attribute_information<T>::entropy() const {
 
 template <typename T>
 probability attribute_information<T>::marginal_probability( T value ) const {
-	try {
-		return _pdf.at ( value );
-	} catch (std::out_of_range& err) {
+	auto it = std::lower_bound( _values.begin(), _values.end(), value );
+	if( it == _values.end() || *it != value ) {
 		return 0.0;
 	}
+	return _probabilities[ it - _values.begin() ];
+}
+
+template <typename T>
+std::vector<std::size_t> const & attribute_information<T>::counts() const {
+	return _counts;
+}
+
+template <typename T>
+std::vector<probability> const & attribute_information<T>::probabilities() const {
+	return _probabilities;
+}
+
+template <typename T>
+template <typename ForwardIterator, typename OutputIterator>
+void attribute_information<T>::encode( ForwardIterator first, ForwardIterator last, OutputIterator out ) const {
+	if( _values.empty() ) {
+		return;
+	}
+
+	T min = _values.front();
+	std::size_t table_size = static_cast<std::size_t>( static_cast<std::int64_t>( _values.back() ) - static_cast<std::int64_t>( min ) ) + 1;
+	if( table_size <= lookup_table_limit ) {
+		std::vector<code_type> table( table_size, 0 );
+		for( std::size_t code = 0; code < _values.size(); ++code ) {
+			table[ static_cast<std::size_t>( static_cast<std::int64_t>( _values[ code ] ) - static_cast<std::int64_t>( min ) ) ] = static_cast<code_type>( code );
+		}
+		for( ; first != last; ++first, ++out ) {
+			assert( *first >= min && *first <= _values.back() );
+			*out = table[ static_cast<std::size_t>( static_cast<std::int64_t>( *first ) - static_cast<std::int64_t>( min ) ) ];
+		}
+	} else {
+		for( ; first != last; ++first, ++out ) {
+			auto it = std::lower_bound( _values.begin(), _values.end(), *first );
+			assert( it != _values.end() && *it == *first );
+			*out = static_cast<code_type>( it - _values.begin() );
+		}
+	}
 }
 
 #endif
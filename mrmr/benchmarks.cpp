@@ -0,0 +1,364 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <getopt.h>
+
+#include "attribute_information.hpp"
+#include "dataset.hpp"
+#include "kernels.hpp"
+#include "mrmr.hpp"
+#include "synthetic.hpp"
+#include "utils.hpp"
+
+/*
+ * Times the hot paths on synthetic data across sweeps of rows, attributes and threads and
+ * writes one tab-separated line per measurement, so that runs can be compared by script.
+ */
+
+void short_usage( char const * program ) {
+	std::cout << "Usage: " << program << " [OPTION]...                                            \n";
+	std::cout << "Try '" << program << " --help' for more information.                            \n";
+}
+
+void usage( char const * program ) {
+	std::cout << "Usage: " << program << " [OPTION]...                                            \n";
+	std::cout << "Time text parsing, attribute information, mutual information and mRMR on        \n";
+	std::cout << "synthetic datasets and write tab-separated results, one line per measurement.   \n";
+	std::cout << "                                                                                \n";
+	std::cout << "  -r, --rows=NUM[,NUM]...   row counts to sweep; defaults to 10000,100000       \n";
+	std::cout << "  -a, --attributes=NUM[,NUM]...                                                 \n";
+	std::cout << "                            attribute counts to sweep; defaults to 50,200       \n";
+	std::cout << "  -t, --threads=NUM[,NUM]...                                                    \n";
+	std::cout << "                            thread counts to sweep, 0 for all available cores;  \n";
+	std::cout << "                            defaults to 1                                       \n";
+	std::cout << "  -c, --cardinality=NUM     values per attribute, at most 256; defaults to 4    \n";
+	std::cout << "      --classes=NUM         values of the class, at most 256; defaults to 2     \n";
+	std::cout << "      --balance=VALUE       share of rows in the first class, 0 for all classes \n";
+	std::cout << "                            alike; defaults to 0                                \n";
+	std::cout << "      --relevance=VALUE     share of rows in which the first attribute follows  \n";
+	std::cout << "                            the class, falling to 0 for the last; defaults to   \n";
+	std::cout << "                            0.5                                                 \n";
+	std::cout << "      --redundancy=VALUE    share of rows in which an attribute repeats the one \n";
+	std::cout << "                            before it; defaults to 0.25                         \n";
+	std::cout << "  -n, --number=NUM          attributes mRMR selects; defaults to 20             \n";
+	std::cout << "  -i, --repeat=NUM          times each measurement is taken, keeping the best;  \n";
+	std::cout << "                            defaults to 3                                       \n";
+	std::cout << "  -s, --seed=NUM            seed of the generator; defaults to 0                \n";
+	std::cout << "  -o, --output=FILE         write results to FILE instead of standard output    \n";
+	std::cout << "  -g, --generate=FILE       write the dataset of the first row and attribute    \n";
+	std::cout << "                            counts to FILE as text and exit                     \n";
+	std::cout << "  -h, --help     display this help and exit                                     \n";
+}
+
+bool parse_list( char const * text, std::vector<std::size_t> & values ) {
+	values.clear();
+	while( true ) {
+		char * end;
+		errno = 0;
+		std::size_t value = std::strtoul( text, &end, 10 );
+		if( end == text || errno == ERANGE || ( *end != ',' && *end != '\0' ) ) {
+			return false;
+		}
+		values.push_back( value );
+		if( *end == '\0' ) {
+			return true;
+		}
+		text = end + 1;
+	}
+}
+
+bool parse_share( char const * text, double & value ) {
+	char * end;
+	value = std::strtod( text, &end );
+	return end != text && *end == '\0' && value >= 0.0 && value <= 1.0;
+}
+
+/*
+ * Runs f the given number of times and returns the shortest wall time in seconds.
+ */
+template <typename F>
+double best_time( std::size_t repeat, F f ) {
+	double best = 0.0;
+	for( std::size_t i = 0; i < repeat; ++i ) {
+		auto start = std::chrono::steady_clock::now();
+		f();
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		if( i == 0 || elapsed.count() < best ) {
+			best = elapsed.count();
+		}
+	}
+	return best;
+}
+
+class result_writer {
+	public:
+		explicit result_writer( std::ostream & os, synthetic_options const & options ) : _os( os ), _options( options ) {
+			_os << "benchmark\trows\tattributes\tcardinality\tthreads\tkernel\tseconds\titems\tunit\titems_per_second\n";
+		}
+
+		void write( char const * benchmark, std::size_t threads, double seconds, std::uint64_t items, char const * unit ) {
+			_os << benchmark << '\t' << _options.num_rows << '\t' << _options.num_attributes << '\t' << _options.cardinality << '\t' << threads
+					<< '\t' << active_kernels().name << '\t' << seconds << '\t' << items << '\t' << unit << '\t' << ( seconds > 0.0 ? static_cast<double>( items ) / seconds : 0.0 )
+					<< std::endl;
+		}
+
+	private:
+		std::ostream & _os;
+		synthetic_options const & _options;
+};
+
+/*
+ * Takes every measurement on one generated dataset. Attribute information and single
+ * mutual information calls run on one thread, so they are timed once per dataset.
+ */
+void run_benchmarks( synthetic_options const & options, std::vector<std::size_t> const & thread_counts, std::size_t num_features,
+		std::size_t repeat, result_writer & results ) {
+	using dataset_type = dataset<unsigned char>;
+	synthetic_data synthetic( options );
+	std::string text = synthetic.text();
+	std::size_t num_columns = synthetic.num_columns();
+	std::uint64_t cells = static_cast<std::uint64_t>( options.num_rows ) * num_columns;
+
+	std::vector<std::vector<unsigned char> > columns;
+	for( std::size_t column = 0; column < num_columns; ++column ) {
+		columns.push_back( synthetic.column( column ) );
+	}
+	double seconds = best_time( repeat, [&columns]() {
+		for( auto & column : columns ) {
+			attribute_information<unsigned char> ai( column.cbegin(), column.cend() );
+			static_cast<void>( ai );
+		}
+	} );
+	results.write( "attribute_information", 1, seconds, cells, "values" );
+	columns.clear();
+
+	dataset_type data( text.data(), text.data() + text.size(), dataset_type::ROUND, 1 );
+	seconds = best_time( repeat, [&data, num_columns]() {
+		for( std::size_t column = 1; column < num_columns; ++column ) {
+			data.mutual_information( 0, column );
+		}
+	} );
+	results.write( "mutual_information", 1, seconds, static_cast<std::uint64_t>( options.num_rows ) * ( num_columns - 1 ), "rows" );
+
+	// exhaustive evaluation scores every candidate against the class and each selected attribute
+	std::size_t selected = num_features == 0 ? num_columns - 1 : std::min( num_features, num_columns - 1 );
+	std::uint64_t pairs = 0;
+	for( std::size_t k = 0; k < selected; ++k ) {
+		pairs += num_columns - 1 - k;
+	}
+	for( auto threads : thread_counts ) {
+		seconds = best_time( repeat, [&text, threads]() {
+			dataset_type parsed( text.data(), text.data() + text.size(), dataset_type::ROUND, threads );
+			static_cast<void>( parsed );
+		} );
+		results.write( "parse_text", threads, seconds, text.size(), "bytes" );
+
+		seconds = best_time( repeat, [&data, selected, threads]() {
+			mrmr( data, 0, selected, mrmr_method_type::MID, threads );
+		} );
+		results.write( "mrmr", threads, seconds, pairs * options.num_rows, "rows" );
+	}
+}
+
+int main( int argc, char * argv[] ) {
+	synthetic_options options;
+	std::vector<std::size_t> row_counts = { 10000, 100000 };
+	std::vector<std::size_t> attribute_counts = { 50, 200 };
+	std::vector<std::size_t> thread_counts = { 1 };
+	std::size_t num_features = 20;
+	std::size_t repeat = 3;
+	std::string output_path;
+	std::string generate_path;
+
+	int c;
+	int option_index = 0;
+	while( true ) {
+		static struct option long_options[] = {
+				{ "rows", required_argument, 0, 'r' },
+				{ "attributes", required_argument, 0, 'a' },
+				{ "threads", required_argument, 0, 't' },
+				{ "cardinality", required_argument, 0, 'c' },
+				{ "classes", required_argument, 0, 'C' },
+				{ "balance", required_argument, 0, 'B' },
+				{ "relevance", required_argument, 0, 'V' },
+				{ "redundancy", required_argument, 0, 'D' },
+				{ "number", required_argument, 0, 'n' },
+				{ "repeat", required_argument, 0, 'i' },
+				{ "seed", required_argument, 0, 's' },
+				{ "output", required_argument, 0, 'o' },
+				{ "generate", required_argument, 0, 'g' },
+				{ "help", no_argument, 0, 'h' }
+				};
+		c = getopt_long( argc, argv, "r:a:t:c:n:i:s:o:g:h", long_options, &option_index );
+		if( c == -1 ) {
+			break;
+		}
+		std::vector<std::size_t> values;
+		switch( c ) {
+			case 'r':
+				if( ! parse_list( optarg, row_counts ) || std::count( row_counts.begin(), row_counts.end(), 0 ) > 0 ) {
+					std::cerr << argv[0] << ": " << "-r, --rows=NUM[,NUM]...  row counts must be positive integers\n";
+					return 1;
+				}
+				break;
+
+			case 'a':
+				if( ! parse_list( optarg, attribute_counts ) || std::count( attribute_counts.begin(), attribute_counts.end(), 0 ) > 0 ) {
+					std::cerr << argv[0] << ": " << "-a, --attributes=NUM[,NUM]...  attribute counts must be positive integers\n";
+					return 1;
+				}
+				break;
+
+			case 't':
+				if( ! parse_list( optarg, thread_counts ) ) {
+					std::cerr << argv[0] << ": " << "-t, --threads=NUM[,NUM]...  thread counts must be non-negative integers\n";
+					return 1;
+				}
+				break;
+
+			case 'c':
+				if( ! parse_list( optarg, values ) || values.size() != 1 || values[ 0 ] < 1 || values[ 0 ] > 256 ) {
+					std::cerr << argv[0] << ": " << "-c, --cardinality=NUM  must be between 1 and 256\n";
+					return 1;
+				}
+				options.cardinality = values[ 0 ];
+				break;
+
+			case 'C':
+				if( ! parse_list( optarg, values ) || values.size() != 1 || values[ 0 ] < 1 || values[ 0 ] > 256 ) {
+					std::cerr << argv[0] << ": " << "--classes=NUM  must be between 1 and 256\n";
+					return 1;
+				}
+				options.num_classes = values[ 0 ];
+				break;
+
+			case 'B':
+				if( ! parse_share( optarg, options.class_balance ) ) {
+					std::cerr << argv[0] << ": " << "--balance=VALUE  must be between 0 and 1\n";
+					return 1;
+				}
+				break;
+
+			case 'V':
+				if( ! parse_share( optarg, options.relevance ) ) {
+					std::cerr << argv[0] << ": " << "--relevance=VALUE  must be between 0 and 1\n";
+					return 1;
+				}
+				break;
+
+			case 'D':
+				if( ! parse_share( optarg, options.redundancy ) ) {
+					std::cerr << argv[0] << ": " << "--redundancy=VALUE  must be between 0 and 1\n";
+					return 1;
+				}
+				break;
+
+			case 'n':
+				if( ! parse_list( optarg, values ) || values.size() != 1 ) {
+					std::cerr << argv[0] << ": " << "-n, --number=NUM  must be a non-negative integer\n";
+					return 1;
+				}
+				num_features = values[ 0 ];
+				break;
+
+			case 'i':
+				if( ! parse_list( optarg, values ) || values.size() != 1 || values[ 0 ] == 0 ) {
+					std::cerr << argv[0] << ": " << "-i, --repeat=NUM  must be a positive integer\n";
+					return 1;
+				}
+				repeat = values[ 0 ];
+				break;
+
+			case 's':
+				if( ! parse_list( optarg, values ) || values.size() != 1 ) {
+					std::cerr << argv[0] << ": " << "-s, --seed=NUM  must be a non-negative integer\n";
+					return 1;
+				}
+				options.seed = values[ 0 ];
+				break;
+
+			case 'o':
+				output_path = optarg;
+				break;
+
+			case 'g':
+				generate_path = optarg;
+				break;
+
+			case 'h':
+				usage( argv[0] );
+				return 0;
+
+			default:
+				short_usage( argv[0] );
+				return 1;
+		}
+	}
+	if( optind < argc ) {
+		short_usage( argv[0] );
+		return 1;
+	}
+	if( options.relevance + options.redundancy > 1.0 ) {
+		std::cerr << argv[0] << ": " << "--relevance=VALUE and --redundancy=VALUE  must not add up to more than 1\n";
+		return 1;
+	}
+
+	if( ! generate_path.empty() ) {
+		options.num_rows = row_counts[ 0 ];
+		options.num_attributes = attribute_counts[ 0 ];
+		std::ofstream ofs( generate_path, std::ios::binary );
+		synthetic_data( options ).write_text( ofs );
+		ofs.close();
+		if( ! ofs ) {
+			std::cerr << argv[0] << ": " << "-g, --generate=FILE  cannot write " << generate_path << "\n";
+			return 1;
+		}
+		return 0;
+	}
+
+	std::ofstream ofs;
+	if( ! output_path.empty() ) {
+		ofs.open( output_path );
+		if( ! ofs ) {
+			std::cerr << argv[0] << ": " << "-o, --output=FILE  cannot write " << output_path << "\n";
+			return 1;
+		}
+	}
+	result_writer results( output_path.empty() ? std::cout : ofs, options );
+	for( auto rows : row_counts ) {
+		for( auto attributes : attribute_counts ) {
+			options.num_rows = rows;
+			options.num_attributes = attributes;
+			run_benchmarks( options, thread_counts, num_features, repeat, results );
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,77 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MRMR_BINARY_FORMAT_HPP
+#define MRMR_BINARY_FORMAT_HPP
+
+#include <cstdint>
+#include <cstring>
+
+/*
+ * Layout of a binary dataset file, which holds a dataset after discretization and
+ * encoding so it can be mapped and used without parsing. All offsets are in bytes from
+ * the start of the file and all fields are in the byte order of the machine that wrote
+ * it, which readers detect through byte_order.
+ *
+ *   binary_header
+ *   binary_attribute[ num_attributes ]
+ *   attribute names, each terminated by '\0'
+ *   per attribute: sorted distinct values as int64, then their counts as uint64
+ *   per attribute: packed code column as written by column_store, at a 64 byte boundary
+ */
+namespace binary_format {
+	const char magic[ 8 ] = { 'M', 'R', 'M', 'R', 'C', 'O', 'L', '\0' };
+	const std::uint32_t version = 1;
+	const std::uint32_t byte_order = 0x01020304;
+	const std::uint64_t column_alignment = 64;
+
+	struct header {
+		char magic[ 8 ];
+		std::uint32_t version;
+		std::uint32_t byte_order;
+		std::uint32_t value_size;
+		std::uint32_t value_signed;
+		std::uint64_t num_attributes;
+		std::uint64_t num_instances;
+		std::uint64_t names_offset;
+		std::uint64_t names_size;
+		std::uint64_t file_size;
+	};
+
+	struct attribute {
+		std::uint64_t values_offset;
+		std::uint64_t counts_offset;
+		std::uint64_t column_offset;
+		std::uint64_t num_values;
+		std::uint32_t bits;
+		std::uint32_t reserved;
+		double entropy;
+	};
+
+	inline std::uint64_t align( std::uint64_t offset, std::uint64_t alignment ) {
+		return ( offset + alignment - 1 ) / alignment * alignment;
+	}
+
+	inline bool has_magic( char const * data, std::size_t size ) {
+		return size >= sizeof( magic ) && std::memcmp( data, magic, sizeof( magic ) ) == 0;
+	}
+}
+
+#endif
@@ -0,0 +1,199 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <limits>
+
+#include "column_store.hpp"
+
+column_store::column_store() : _num_rows( 0 ) {
+}
+
+column_store::column_store( std::size_t num_rows, std::size_t num_columns ) : _num_rows( num_rows ), _columns( num_columns ) {
+	for( std::size_t column = 0; column < num_columns; ++column ) {
+		clear_column( column, 1 );
+	}
+}
+
+void column_store::reserve( std::size_t num_columns ) {
+	_columns.reserve( num_columns );
+}
+
+void column_store::add_column() {
+	_columns.emplace_back();
+	clear_column( _columns.size() - 1, 1 );
+}
+
+/* Empties a column into a sparse column of bits bits with no entries. */
+void column_store::clear_column( std::size_t column, unsigned bits ) {
+	auto & c = _columns[ column ];
+	c.bits = bits;
+	c.words.clear();
+	c.words.shrink_to_fit();
+	c.borrowed = nullptr;
+	c.sparse = true;
+	c.default_code = 0;
+	c.rows.clear();
+	c.rows.shrink_to_fit();
+	c.codes.clear();
+	c.codes.shrink_to_fit();
+}
+
+/* Sets a sparse column from the sorted rows whose codes differ from default_code and their codes. */
+void column_store::set_sparse_column( std::size_t column, std::uint32_t default_code, std::vector<std::uint32_t> rows, std::vector<std::uint32_t> codes,
+		std::size_t num_values ) {
+	assert( column < num_columns() && rows.size() == codes.size() && std::is_sorted( rows.begin(), rows.end() ) );
+	clear_column( column, bits_for( num_values ) );
+	_columns[ column ].default_code = default_code;
+	_columns[ column ].rows = std::move( rows );
+	_columns[ column ].codes = std::move( codes );
+}
+
+void column_store::borrow_column( std::size_t column, unsigned bits, std::uint64_t const * words, std::shared_ptr<void const> owner ) {
+	clear_column( column, bits );
+	_columns[ column ].sparse = false;
+	_columns[ column ].borrowed = words;
+	if( std::find( _owners.begin(), _owners.end(), owner ) == _owners.end() ) {
+		_owners.push_back( std::move( owner ) );
+	}
+}
+
+std::size_t column_store::num_rows() const {
+	return _num_rows;
+}
+
+std::size_t column_store::num_columns() const {
+	return _columns.size();
+}
+
+unsigned column_store::bits( std::size_t column ) const {
+	return _columns[ column ].bits;
+}
+
+bool column_store::is_sparse( std::size_t column ) const {
+	return _columns[ column ].sparse;
+}
+
+bool column_store::is_borrowed( std::size_t column ) const {
+	return _columns[ column ].borrowed != nullptr;
+}
+
+std::uint32_t column_store::default_code( std::size_t column ) const {
+	return _columns[ column ].default_code;
+}
+
+std::size_t column_store::num_entries( std::size_t column ) const {
+	return _columns[ column ].rows.size();
+}
+
+std::uint32_t const * column_store::entry_rows( std::size_t column ) const {
+	return _columns[ column ].rows.data();
+}
+
+std::uint32_t const * column_store::entry_codes( std::size_t column ) const {
+	return _columns[ column ].codes.data();
+}
+
+/* The words of a column as packed, also for a sparse column, which has none of its own. */
+std::vector<std::uint64_t> column_store::pack( std::size_t column ) const {
+	if( ! _columns[ column ].sparse ) {
+		return std::vector<std::uint64_t>( words( column ), words( column ) + num_words( column ) );
+	}
+	unsigned bits = _columns[ column ].bits;
+	std::size_t per_word = 64 / bits;
+	std::vector<std::uint64_t> words( words_for( _num_rows, bits ), 0 );
+	std::vector<std::uint32_t> const & rows = _columns[ column ].rows;
+	for( std::size_t row = 0, entry = 0; row < _num_rows; ++row ) {
+		std::uint64_t code = _columns[ column ].default_code;
+		if( entry < rows.size() && rows[ entry ] == row ) {
+			code = _columns[ column ].codes[ entry++ ];
+		}
+		words[ row / per_word ] |= code << ( ( row % per_word ) * bits );
+	}
+	return words;
+}
+
+/* Packed words of a column, or null for a sparse column. */
+std::uint64_t const * column_store::words( std::size_t column ) const {
+	if( _columns[ column ].sparse ) {
+		return nullptr;
+	}
+	return _columns[ column ].borrowed != nullptr ? _columns[ column ].borrowed : _columns[ column ].words.data();
+}
+
+std::size_t column_store::num_words( std::size_t column ) const {
+	return words_for( _num_rows, _columns[ column ].bits );
+}
+
+/* Bytes of column data held by the store itself, not counting borrowed columns. */
+std::size_t column_store::memory_usage() const {
+	std::size_t bytes = 0;
+	for( auto const & c : _columns ) {
+		bytes += c.words.size() * sizeof( std::uint64_t ) + ( c.rows.size() + c.codes.size() ) * sizeof( std::uint32_t );
+	}
+	return bytes;
+}
+
+unsigned column_store::bits_for( std::size_t num_values ) {
+	unsigned bits = 1;
+	while( bits < 32 && ( std::uint64_t( 1 ) << bits ) < num_values ) {
+		bits *= 2;
+	}
+	return bits;
+}
+
+std::size_t column_store::words_for( std::size_t num_rows, unsigned bits ) {
+	std::size_t per_word = 64 / bits;
+	return ( num_rows + per_word - 1 ) / per_word;
+}
+
+/* Whether a column of num_values codes with num_entries rows apart from its default code is kept sparse. */
+bool column_store::keeps_sparse( std::size_t num_rows, std::size_t num_entries, std::size_t num_values ) {
+	return num_rows <= std::numeric_limits<std::uint32_t>::max() && num_entries * entry_bits < num_rows * bits_for( num_values );
+}
+
+namespace column_store_detail {
+	namespace {
+		expansion_tables make_tables() {
+			expansion_tables t;
+			for( unsigned byte = 0; byte < 256; ++byte ) {
+				unsigned char expanded[ 8 ];
+				for( unsigned i = 0; i < 8; ++i ) {
+					expanded[ i ] = static_cast<unsigned char>( ( byte >> i ) & 0x1 );
+				}
+				std::memcpy( &t.bits1[ byte ], expanded, 8 );
+				for( unsigned i = 0; i < 4; ++i ) {
+					expanded[ i ] = static_cast<unsigned char>( ( byte >> ( 2 * i ) ) & 0x3 );
+				}
+				std::memcpy( &t.bits2[ byte ], expanded, 4 );
+				for( unsigned i = 0; i < 2; ++i ) {
+					expanded[ i ] = static_cast<unsigned char>( ( byte >> ( 4 * i ) ) & 0xF );
+				}
+				std::memcpy( &t.bits4[ byte ], expanded, 2 );
+			}
+			return t;
+		}
+	}
+
+	expansion_tables const & tables() {
+		static const expansion_tables t = make_tables();
+		return t;
+	}
+}
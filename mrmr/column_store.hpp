@@ -0,0 +1,205 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MRMR_COLUMN_STORE_HPP
+#define MRMR_COLUMN_STORE_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+/*
+ * Attribute-major store of code columns. Each column is packed at the narrowest of
+ * 1, 2, 4 or 8 bits per code that holds its number of distinct values, falling back to
+ * 16 or 32 bits for wider columns. Codes are laid out little-endian in 64-bit words and
+ * never straddle a word, so any range of rows starting at a multiple of 64 begins on a
+ * word boundary in every column. Unused bits of the last word are zero.
+ *
+ * A column most of whose rows share one code is instead kept sparse, as that default code
+ * and the sorted rows and codes of the other rows, its entries, whenever the entries take
+ * fewer bits than the packed codes would. It keeps the bits it would be packed at, but has
+ * no words; get and unpack read its entries, and pack gives the words it would have.
+ * Columns added before they are set are sparse with no entries, so all their codes are 0.
+ *
+ * Columns are either owned by the store or borrowed from memory kept alive by an owner
+ * shared with the store, such as a mapped binary dataset file.
+ */
+class column_store {
+	public:
+		column_store();
+		column_store( std::size_t num_rows, std::size_t num_columns );
+
+		std::size_t num_rows() const;
+		std::size_t num_columns() const;
+		unsigned bits( std::size_t column ) const;
+		std::uint64_t const * words( std::size_t column ) const;
+		std::size_t num_words( std::size_t column ) const;
+		std::size_t memory_usage() const;
+		std::uint32_t get( std::size_t column, std::size_t row ) const;
+		bool is_sparse( std::size_t column ) const;
+		bool is_borrowed( std::size_t column ) const;
+		std::uint32_t default_code( std::size_t column ) const;
+		std::size_t num_entries( std::size_t column ) const;
+		std::uint32_t const * entry_rows( std::size_t column ) const;
+		std::uint32_t const * entry_codes( std::size_t column ) const;
+		std::vector<std::uint64_t> pack( std::size_t column ) const;
+
+		void reserve( std::size_t num_columns );
+		void add_column();
+		void borrow_column( std::size_t column, unsigned bits, std::uint64_t const * words, std::shared_ptr<void const> owner );
+		template <typename C> void set_column( std::size_t column, C const * codes, std::size_t num_values );
+		void set_sparse_column( std::size_t column, std::uint32_t default_code, std::vector<std::uint32_t> rows, std::vector<std::uint32_t> codes,
+				std::size_t num_values );
+		template <typename C> void unpack( std::size_t column, std::size_t first_row, std::size_t count, C * out ) const;
+
+		static unsigned bits_for( std::size_t num_values );
+		static std::size_t words_for( std::size_t num_rows, unsigned bits );
+		static bool keeps_sparse( std::size_t num_rows, std::size_t num_entries, std::size_t num_values );
+
+		/* Bits an entry of a sparse column takes: its row and its code. */
+		static const std::size_t entry_bits = 64;
+
+	private:
+		struct column {
+			unsigned bits;
+			std::vector<std::uint64_t> words;
+			std::uint64_t const * borrowed;
+			bool sparse;
+			std::uint32_t default_code;
+			std::vector<std::uint32_t> rows;
+			std::vector<std::uint32_t> codes;
+		};
+
+		void clear_column( std::size_t column, unsigned bits );
+
+		std::size_t _num_rows;
+		std::vector<column> _columns;
+		std::vector<std::shared_ptr<void const> > _owners;
+};
+
+inline std::uint32_t column_store::get( std::size_t column, std::size_t row ) const {
+	assert( column < num_columns() && row < num_rows() );
+	if( _columns[ column ].sparse ) {
+		std::vector<std::uint32_t> const & rows = _columns[ column ].rows;
+		auto it = std::lower_bound( rows.begin(), rows.end(), row );
+		return it != rows.end() && *it == row ? _columns[ column ].codes[ static_cast<std::size_t>( it - rows.begin() ) ] : _columns[ column ].default_code;
+	}
+	unsigned bits = _columns[ column ].bits;
+	std::size_t per_word = 64 / bits;
+	std::uint64_t word = words( column )[ row / per_word ];
+	std::uint64_t mask = bits == 64 ? ~std::uint64_t( 0 ) : ( std::uint64_t( 1 ) << bits ) - 1;
+	return static_cast<std::uint32_t>( ( word >> ( ( row % per_word ) * bits ) ) & mask );
+}
+
+template <typename C>
+void column_store::set_column( std::size_t column, C const * codes, std::size_t num_values ) {
+	assert( column < num_columns() );
+	unsigned bits = bits_for( num_values );
+
+	// a column whose most common code leaves few other rows keeps only those
+	std::vector<std::size_t> code_counts( num_values, 0 );
+	for( std::size_t row = 0; row < _num_rows; ++row ) {
+		++code_counts[ static_cast<std::size_t>( codes[ row ] ) ];
+	}
+	std::size_t common = static_cast<std::size_t>( std::max_element( code_counts.begin(), code_counts.end() ) - code_counts.begin() );
+	if( num_values > 0 && keeps_sparse( _num_rows, _num_rows - code_counts[ common ], num_values ) ) {
+		std::vector<std::uint32_t> rows;
+		std::vector<std::uint32_t> entry_codes;
+		rows.reserve( _num_rows - code_counts[ common ] );
+		entry_codes.reserve( _num_rows - code_counts[ common ] );
+		for( std::size_t row = 0; row < _num_rows; ++row ) {
+			if( static_cast<std::size_t>( codes[ row ] ) != common ) {
+				rows.push_back( static_cast<std::uint32_t>( row ) );
+				entry_codes.push_back( static_cast<std::uint32_t>( codes[ row ] ) );
+			}
+		}
+		set_sparse_column( column, static_cast<std::uint32_t>( common ), std::move( rows ), std::move( entry_codes ), num_values );
+		return;
+	}
+
+	std::size_t per_word = 64 / bits;
+	std::vector<std::uint64_t> words( words_for( _num_rows, bits ), 0 );
+	for( std::size_t row = 0; row < _num_rows; ++row ) {
+		words[ row / per_word ] |= static_cast<std::uint64_t>( codes[ row ] ) << ( ( row % per_word ) * bits );
+	}
+	clear_column( column, bits );
+	_columns[ column ].sparse = false;
+	_columns[ column ].words = std::move( words );
+}
+
+namespace column_store_detail {
+	/* Tables expanding one packed byte of 1, 2 or 4 bit codes into one byte per code. */
+	struct expansion_tables {
+		std::uint64_t bits1[ 256 ];
+		std::uint32_t bits2[ 256 ];
+		std::uint16_t bits4[ 256 ];
+	};
+
+	expansion_tables const & tables();
+}
+
+template <typename C>
+void column_store::unpack( std::size_t column, std::size_t first_row, std::size_t count, C * out ) const {
+	assert( column < num_columns() && first_row + count <= num_rows() );
+	if( _columns[ column ].sparse ) {
+		std::vector<std::uint32_t> const & rows = _columns[ column ].rows;
+		std::fill( out, out + count, static_cast<C>( _columns[ column ].default_code ) );
+		for( auto it = std::lower_bound( rows.begin(), rows.end(), first_row ); it != rows.end() && *it < first_row + count; ++it ) {
+			out[ *it - first_row ] = static_cast<C>( _columns[ column ].codes[ static_cast<std::size_t>( it - rows.begin() ) ] );
+		}
+		return;
+	}
+	unsigned bits = _columns[ column ].bits;
+	std::size_t per_word = 64 / bits;
+	std::uint64_t const * words = this->words( column );
+
+	// byte outputs of sub-byte codes at a byte boundary are expanded a packed byte at a time
+	if( sizeof( C ) == 1 && bits < 8 && first_row % per_word == 0 ) {
+		column_store_detail::expansion_tables const & tables = column_store_detail::tables();
+		std::size_t per_byte = 8 / bits;
+		unsigned char const * bytes = reinterpret_cast<unsigned char const *>( words + first_row / per_word );
+		std::size_t whole_bytes = count / per_byte;
+		unsigned char * target = reinterpret_cast<unsigned char *>( out );
+		for( std::size_t i = 0; i < whole_bytes; ++i, target += per_byte ) {
+			if( bits == 1 ) {
+				std::memcpy( target, &tables.bits1[ bytes[ i ] ], 8 );
+			} else if( bits == 2 ) {
+				std::memcpy( target, &tables.bits2[ bytes[ i ] ], 4 );
+			} else {
+				std::memcpy( target, &tables.bits4[ bytes[ i ] ], 2 );
+			}
+		}
+		for( std::size_t row = first_row + whole_bytes * per_byte; row < first_row + count; ++row ) {
+			out[ row - first_row ] = static_cast<C>( get( column, row ) );
+		}
+		return;
+	}
+
+	std::uint64_t mask = ( std::uint64_t( 1 ) << bits ) - 1;
+	for( std::size_t row = first_row; row < first_row + count; ++row ) {
+		out[ row - first_row ] = static_cast<C>( ( words[ row / per_word ] >> ( ( row % per_word ) * bits ) ) & mask );
+	}
+}
+
+#endif
@@ -23,14 +23,32 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define MRMR_DATASET_HPP
 
 #include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <iterator>
-#include <valarray>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <type_traits>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include "attribute_information.hpp"
-#include "matrix.hpp"
+#include "binary_format.hpp"
+#include "column_store.hpp"
+#include "discretizer.hpp"
+#include "kernels.hpp"
+#include "mapped_file.hpp"
+#include "stats.hpp"
+#include "text_parser.hpp"
+#include "thread_pool.hpp"
 #include "typedef.hpp"
 
 template <typename T>
@@ -44,88 +62,512 @@ class dataset {
 			CEILING = 2
 		};
 		dataset();
-		dataset( std::istream &, discretization_method dm = ROUND );
+		dataset( std::istream &, discretization_method dm = ROUND, std::size_t num_threads = 1, binning_options const & binning = binning_options() );
+		dataset( char const * first, char const * last, discretization_method dm = ROUND, std::size_t num_threads = 1,
+				binning_options const & binning = binning_options() );
+		dataset( char const * first, char const * last, std::size_t shard_first, std::size_t shard_last, discretization_method dm = ROUND,
+				std::size_t num_threads = 1 );
 		std::size_t num_instances() const;
 		std::size_t num_attributes() const;
 		std::string attribute_name( std::size_t attribute_num ) const;
 		std::size_t num_rows() const;
-		int attribute_value( std::string& name ) const;
-		int set_attribute( std::string& name, T * data, std::size_t length );
+		int attribute_value( std::string const & name ) const;
+		void reserve( std::size_t num_attributes, std::size_t num_instances );
+		template <typename U> int set_attribute( std::string const & name, U const * data, std::size_t length );
+		template <typename U> int set_attributes( std::vector<std::string> const & names, U const * data, std::size_t length,
+				std::ptrdiff_t instance_stride, std::ptrdiff_t attribute_stride, std::size_t num_threads = 1 );
 		double attribute_entropy( std::size_t attribute_num ) const;
+		attribute_information<T> const & attribute_info( std::size_t attribute_num ) const;
+		column_store const & columns() const;
 		double mutual_information( std::size_t attribute1, std::size_t attribute2 ) const;
+		void mutual_information_many( std::size_t anchor, std::size_t const * candidates, std::size_t num_candidates, double * out ) const;
+		void mutual_information_table( std::size_t const * anchors, std::size_t num_anchors, std::size_t const * candidates, std::size_t num_candidates,
+				double * out ) const;
+		template <typename Visitor> void joint_count_tables( std::size_t const * anchors, std::size_t num_anchors, std::size_t const * candidates,
+				std::size_t num_candidates, Visitor visit ) const;
+		std::size_t histogram_budget() const;
+		void set_histogram_budget( std::size_t bytes );
+		dataset sample_rows( std::size_t num_rows, std::uint64_t seed = 0, std::size_t num_threads = 1 ) const;
+		void save_binary( std::ostream & os ) const;
+
+		static dataset open_binary( std::string const & path );
+		static dataset from_libsvm( char const * first, char const * last, discretization_method dm = ROUND, std::size_t num_threads = 1 );
+		static bool is_binary( std::string const & path );
+		static std::vector<std::size_t> sample_row_indices( std::size_t num_instances, std::size_t num_rows, std::uint64_t seed );
+
+		static const std::size_t default_histogram_budget = 1 << 20;
+
+		/* Rounds a raw value as dm says, as is done to every value of an attribute that is not binned. */
+		static double discretize( double value, discretization_method dm );
+
+		/* Whether a discretized value is one T can hold; converting any other is undefined. */
+		static bool holds( double value );
+
+		/* Most candidates sharing one pass over the anchor columns in mutual_information_table. */
+		static const std::size_t max_block_candidates = 16;
+
+		/* Bytes of unpacked column data per row tile in mutual_information_many, sized to stay in L2. */
+		static const std::size_t tile_bytes = 1 << 18;
 
 	private:
+		/*
+		 * Discretizes rows as they are parsed into one buffer of values per attribute, held as
+		 * bytes, 16-bit values or T: the narrowest width its values have fit so far. Rows
+		 * arrive from several threads at once, so a value too wide for its buffer only raises
+		 * the width its attribute needs, and read_rows parses those attributes again at that
+		 * width. Attributes given the width SKIPPED are not stored, and attributes bins are
+		 * fitted for store the numbers of their bins rather than rounded values.
+		 */
+		class column_sink : public table_sink {
+			public:
+				enum width : unsigned char { BYTE_VALUES, SHORT_VALUES, FULL_VALUES, SKIPPED };
+
+				column_sink( dataset const & data, discretization_method dm, discretizer const * bins, std::vector<width> widths );
+				void begin( std::size_t num_rows, std::size_t num_columns ) override;
+				std::size_t store_row( std::size_t row, double const * values ) override;
+				std::size_t num_rows() const;
+				width needed_width( std::size_t attribute_num ) const;
+				template <typename Function> void release( std::size_t attribute_num, Function f );
+				static width width_for( double value );
+
+			private:
+				void widen( std::size_t attribute_num, double value );
+
+				dataset const & _data;
+				discretization_method _dm;
+				discretizer const * _bins;
+				std::size_t _num_rows;
+				std::vector<width> _widths;
+				std::unique_ptr<std::atomic<unsigned char>[]> _needed;
+				std::vector<std::vector<std::uint8_t> > _bytes;
+				std::vector<std::vector<std::uint16_t> > _shorts;
+				std::vector<std::vector<T> > _values;
+		};
+
+		/* Values of one attribute read in place from a buffer at a fixed stride in elements. */
+		template <typename U> class strided_values {
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = U;
+				using difference_type = std::ptrdiff_t;
+				using pointer = U const *;
+				using reference = U const &;
+
+				strided_values() : _p( nullptr ), _stride( 1 ) {}
+				strided_values( U const * p, std::ptrdiff_t stride ) : _p( p ), _stride( stride ) {}
+				reference operator*() const { return *_p; }
+				strided_values & operator++() { _p += _stride; return *this; }
+				strided_values operator++( int ) { strided_values old = *this; _p += _stride; return old; }
+				strided_values operator+( std::size_t n ) const { return strided_values( _p + static_cast<std::ptrdiff_t>( n ) * _stride, _stride ); }
+				difference_type operator-( strided_values const & other ) const { return ( _p - other._p ) / _stride; }
+				bool operator==( strided_values const & other ) const { return _p == other._p; }
+				bool operator!=( strided_values const & other ) const { return _p != other._p; }
+
+			private:
+				U const * _p;
+				std::ptrdiff_t _stride;
+		};
+
+		/* Codes of one attribute over a row tile, unpacked to the width a kernel takes. */
+		template <typename C> struct unpacked_tile {
+			std::vector<C> codes;
+			std::size_t attribute = std::numeric_limits<std::size_t>::max();
+			std::size_t first_row = 0;
+		};
+
+		struct unpacked_tiles {
+			unpacked_tile<std::uint8_t> uint8;
+			unpacked_tile<std::uint16_t> uint16;
+			unpacked_tile<std::int32_t> int32;
+			void clear();
+		};
+
+		bool is_dense( std::size_t attribute1, std::size_t attribute2 ) const;
+		void read_text( char const * first, char const * last, discretization_method dm, std::size_t num_threads, binning_options const & binning );
+		void read_rows( char const * first, char const * last, discretization_method dm, std::size_t num_threads, discretizer const * bins = nullptr );
+		void index_names();
+		template <typename Iterator> void store_attribute( std::size_t attribute_num, Iterator values );
+		template <typename C, typename Iterator> void store_codes( std::size_t attribute_num, Iterator values, attribute_information<T> const & info );
+		void store_sparse_attribute( std::size_t attribute_num, std::uint32_t const * rows, double const * values, std::size_t num_entries,
+				discretization_method dm );
+		std::uint32_t checked_code( std::size_t attribute, std::size_t row ) const;
+		template <typename C> void check_codes( std::size_t attribute, C const * codes, std::size_t rows ) const;
+		void codes_error( std::size_t attribute ) const;
+		template <typename C> C const * unpacked_codes( std::size_t attribute, std::size_t first_row, std::size_t rows, unpacked_tile<C> & tile ) const;
+		template <typename C1> void unpacked_joint_counts( std::size_t attribute1, std::size_t attribute2, std::size_t first_row, std::size_t rows,
+				unpacked_tile<C1> & tile1, unpacked_tiles & tiles2, std::uint32_t * counts ) const;
+		void tile_joint_counts( std::size_t attribute1, std::size_t attribute2, std::size_t first_row, std::size_t rows,
+				unpacked_tiles & tiles1, unpacked_tiles & tiles2, std::uint32_t * counts ) const;
+		void complete_joint_counts( std::size_t attribute1, std::size_t attribute2, std::uint32_t * counts ) const;
+		void sparse_joint_counts( std::size_t attribute1, std::size_t attribute2, std::uint32_t * counts ) const;
+		double hashed_mutual_information( std::size_t attribute1, std::size_t attribute2 ) const;
+		static void binary_error( std::string const & path, char const * message );
+
+		std::size_t _histogram_budget;
 		std::vector<std::string> _names;
+		std::unordered_map<std::string, std::size_t> _name_index;
 		std::vector<attribute_information<T> > _attr_info;
-		matrix<T> _data;
+		column_store _columns;
 };
 
 template <typename T>
-dataset<T>::dataset() : _data( 0, 0 ) {
+dataset<T>::dataset() : _histogram_budget( default_histogram_budget ) {
 }
 
 template <typename T>
-dataset<T>::dataset( std::istream & is, discretization_method dm ) {
-	// read header line with attribute names
-	std::string name;
-	while( is.peek() != '\n' ) {
-		is >> name;
-		_names.push_back( name );
+dataset<T>::dataset( std::istream & is, discretization_method dm, std::size_t num_threads, binning_options const & binning ) :
+		_histogram_budget( default_histogram_budget ) {
+	std::vector<char> text = read_stream( is );
+	read_text( text.data(), text.data() + text.size(), dm, num_threads, binning );
+}
+
+/* Reads a dataset from text in memory, such as a mapped file. */
+template <typename T>
+dataset<T>::dataset( char const * first, char const * last, discretization_method dm, std::size_t num_threads, binning_options const & binning ) :
+		_histogram_budget( default_histogram_budget ) {
+	read_text( first, last, dm, num_threads, binning );
+}
+
+/*
+ * Reads the header at first and only the rows of the text that start at a byte offset in
+ * [shard_first, shard_last), so the rows of one file can be split between processes by
+ * byte ranges alone: consecutive ranges covering the file read every row exactly once.
+ */
+template <typename T>
+dataset<T>::dataset( char const * first, char const * last, std::size_t shard_first, std::size_t shard_last, discretization_method dm,
+		std::size_t num_threads ) : _histogram_budget( default_histogram_budget ) {
+	char const * rows = parse_header( first, last, _names );
+	if( rows == nullptr ) {
+		std::cerr << "error: missing required newline after header\n";
+		exit( 2 );
 	}
-	if( is.peek() != '\n' ) {
+	index_names();
+
+	auto row_start = [first, last, rows]( std::size_t offset ) {
+		char const * p = first + std::min( offset, static_cast<std::size_t>( last - first ) );
+		if( p <= rows ) {
+			return rows;
+		}
+		if( p[ -1 ] == '\n' ) {
+			return p;
+		}
+		char const * newline = std::find( p, last, '\n' );
+		return newline == last ? last : newline + 1;
+	};
+	char const * rows_first = row_start( shard_first );
+	char const * rows_last = row_start( shard_last );
+	read_rows( rows_first, std::max( rows_first, rows_last ), dm, num_threads );
+}
+
+template <typename T>
+void dataset<T>::read_text( char const * first, char const * last, discretization_method dm, std::size_t num_threads, binning_options const & binning ) {
+	// read header line with attribute names
+	first = parse_header( first, last, _names );
+	if( first == nullptr ) {
 		std::cerr << "error: missing required newline after header\n";
 		exit( 2 );
 	}
+	index_names();
+	if( binning.method == binning_method::NONE ) {
+		read_rows( first, last, dm, num_threads );
+		return;
+	}
 
-	// read data matrix
-	matrix<double> temp;
-	is >> temp;
+	// binned attributes are fitted in passes of their own, holding only a summary of each
+	discretizer bins;
+	{
+		statistics_phase phase( "binning" );
+		discretizer_fitter fitter( binning, num_attributes(), num_threads, [dm]( double value ) { return discretize( value, dm ); } );
+		for( std::size_t pass = 0; pass < fitter.num_passes(); ++pass ) {
+			fitter.add_text( first, last );
+			fitter.end_pass();
+		}
+		bins = fitter.finish();
+	}
+	read_rows( first, last, dm, num_threads, &bins );
+}
 
-	// prepare matrix for computation by transposing and performing requested discretization procedure
-	_data = matrix<T>( num_attributes(), temp.num_rows() );
+template <typename T>
+void dataset<T>::read_rows( char const * first, char const * last, discretization_method dm, std::size_t num_threads, discretizer const * bins ) {
+	// parse rows straight into one buffer of discretized values per attribute, then parse
+	// again only the attributes whose values turned out too wide for their buffers
+	std::vector<typename column_sink::width> widths( num_attributes(), column_sink::width_for( 0.0 ) );
+	column_sink sink( *this, dm, bins, widths );
+	std::unique_ptr<column_sink> wide_sink;
+	{
+		statistics_phase phase( "parse" );
+		parse_table( first, last, num_threads, sink );
+		bool widened = false;
+		for( std::size_t attribute_num = 0; attribute_num < num_attributes(); ++attribute_num ) {
+			typename column_sink::width needed = sink.needed_width( attribute_num );
+			widths[ attribute_num ] = needed != widths[ attribute_num ] ? needed : column_sink::SKIPPED;
+			widened |= widths[ attribute_num ] != column_sink::SKIPPED;
+		}
+		if( widened ) {
+			wide_sink.reset( new column_sink( *this, dm, bins, widths ) );
+			parse_table( first, last, num_threads, *wide_sink );
+		}
+	}
+
+	// compute attribute information and pack the codes of each attribute, releasing its
+	// buffer as soon as it is packed
+	_attr_info.resize( num_attributes() );
+	_columns = column_store( sink.num_rows(), num_attributes() );
+	statistics_phase phase( "attribute_information" );
+	thread_pool pool( num_threads );
+	pool.parallel_for( 0, num_attributes(), [this, &sink, &wide_sink, &widths]( std::size_t attribute_num ) {
+		column_sink & values = widths[ attribute_num ] == column_sink::SKIPPED ? sink : *wide_sink;
+		values.release( attribute_num, [this, attribute_num]( auto const * data ) {
+			store_attribute( attribute_num, data );
+		} );
+	} );
+}
+
+template <typename T>
+dataset<T>::column_sink::column_sink( dataset<T> const & data, discretization_method dm, discretizer const * bins, std::vector<width> widths ) :
+		_data( data ), _dm( dm ), _bins( bins ), _num_rows( 0 ), _widths( std::move( widths ) ), _needed( new std::atomic<unsigned char>[ _widths.size() ] ),
+		_bytes( _widths.size() ), _shorts( _widths.size() ), _values( _widths.size() ) {
+	for( std::size_t attribute_num = 0; attribute_num < _widths.size(); ++attribute_num ) {
+		_needed[ attribute_num ].store( _widths[ attribute_num ], std::memory_order_relaxed );
+	}
+}
+
+template <typename T>
+void dataset<T>::column_sink::begin( std::size_t num_rows, std::size_t num_columns ) {
+	if( num_rows > 0 && num_columns != _data.num_attributes() ) {
+		std::cerr << "error: header names " << _data.num_attributes() << " attributes but rows have " << num_columns << " columns\n";
+		exit( 2 );
+	}
+	_num_rows = num_rows;
+	for( std::size_t attribute_num = 0; attribute_num < _widths.size(); ++attribute_num ) {
+		switch( _widths[ attribute_num ] ) {
+			case BYTE_VALUES:
+				_bytes[ attribute_num ].resize( num_rows );
+				break;
+			case SHORT_VALUES:
+				_shorts[ attribute_num ].resize( num_rows );
+				break;
+			case FULL_VALUES:
+				_values[ attribute_num ].resize( num_rows );
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+template <typename T>
+std::size_t dataset<T>::column_sink::store_row( std::size_t row, double const * values ) {
+	std::size_t const num_columns = _widths.size();
+	for( std::size_t attribute_num = 0; attribute_num < num_columns; ++attribute_num ) {
+		double value = _bins != nullptr && _bins->binned( attribute_num ) ? _bins->bin( attribute_num, values[ attribute_num ] )
+				: discretize( values[ attribute_num ], _dm );
+		switch( _widths[ attribute_num ] ) {
+			case BYTE_VALUES:
+				if( value >= 0.0 && value <= 255.0 ) {
+					_bytes[ attribute_num ][ row ] = static_cast<std::uint8_t>( value );
+				} else {
+					widen( attribute_num, value );
+				}
+				break;
+			case SHORT_VALUES:
+				if( value >= 0.0 && value <= 65535.0 ) {
+					_shorts[ attribute_num ][ row ] = static_cast<std::uint16_t>( value );
+				} else {
+					widen( attribute_num, value );
+				}
+				break;
+			case FULL_VALUES:
+				if( ! holds( value ) ) {
+					return attribute_num;
+				}
+				_values[ attribute_num ][ row ] = static_cast<T>( value );
+				break;
+			default:
+				break;
+		}
+	}
+	return num_columns;
+}
+
+template <typename T>
+double dataset<T>::discretize( double value, discretization_method dm ) {
 	switch( dm ) {
 		case ROUND:
-			for( std::size_t instance_num = 0; instance_num < num_instances(); ++instance_num ) {
-				for( std::size_t attribute_num = 0; attribute_num < num_attributes(); ++attribute_num ) {
-					_data( attribute_num, instance_num ) = std::round( temp( instance_num, attribute_num ) );
-				}
-			}
-			break;
+			return std::round( value );
 		case FLOOR:
-			for( std::size_t instance_num = 0; instance_num < num_instances(); ++instance_num ) {
-				for( std::size_t attribute_num = 0; attribute_num < num_attributes(); ++attribute_num ) {
-					_data( attribute_num, instance_num ) = std::floor( temp( instance_num, attribute_num ) );
-				}
-			}
-			break;
+			return std::floor( value );
 		case CEILING:
-			for( std::size_t instance_num = 0; instance_num < num_instances(); ++instance_num ) {
-				for( std::size_t attribute_num = 0; attribute_num < num_attributes(); ++attribute_num ) {
-					_data( attribute_num, instance_num ) = std::ceil( temp( instance_num, attribute_num ) );
-				}
-			}
-			break;	
+			return std::ceil( value );
 		default: // truncate (equivalent to FLOOR method above)
-			for( std::size_t instance_num = 0; instance_num < num_instances(); ++instance_num ) {
-				for( std::size_t attribute_num = 0; attribute_num < num_attributes(); ++attribute_num ) {
-					_data( attribute_num, instance_num ) = temp( instance_num, attribute_num );
-				}
-			}
+			return std::trunc( value );
+	}
+}
+
+template <typename T>
+bool dataset<T>::holds( double value ) {
+	if( ! std::numeric_limits<T>::is_integer ) {
+		return true;
+	}
+	// the bounds are powers of two, so exact as doubles where the largest value may not be
+	return value >= static_cast<double>( std::numeric_limits<T>::min() )
+		&& value < static_cast<double>( std::numeric_limits<T>::max() / 2 + 1 ) * 2.0;
+}
+
+/* Raises the width an attribute needs to one that holds value, never lowering it. */
+template <typename T>
+void dataset<T>::column_sink::widen( std::size_t attribute_num, double value ) {
+	unsigned char needed = width_for( value );
+	unsigned char current = _needed[ attribute_num ].load( std::memory_order_relaxed );
+	while( current < needed && ! _needed[ attribute_num ].compare_exchange_weak( current, needed, std::memory_order_relaxed ) ) {
+	}
+}
+
+/*
+ * The narrowest buffer holding a value. Narrower buffers than T are only used when T is
+ * wider still and holds every value they do.
+ */
+template <typename T>
+typename dataset<T>::column_sink::width dataset<T>::column_sink::width_for( double value ) {
+	bool const holds_bytes = sizeof( T ) > 1 && std::numeric_limits<T>::min() <= 0 && std::numeric_limits<T>::max() >= 255;
+	bool const holds_shorts = sizeof( T ) > 2 && std::numeric_limits<T>::min() <= 0 && std::numeric_limits<T>::max() >= 65535;
+	if( holds_bytes && value >= 0.0 && value <= 255.0 ) {
+		return BYTE_VALUES;
+	}
+	if( holds_shorts && value >= 0.0 && value <= 65535.0 ) {
+		return SHORT_VALUES;
+	}
+	return FULL_VALUES;
+}
+
+template <typename T>
+std::size_t dataset<T>::column_sink::num_rows() const {
+	return _num_rows;
+}
+
+template <typename T>
+typename dataset<T>::column_sink::width dataset<T>::column_sink::needed_width( std::size_t attribute_num ) const {
+	return static_cast<width>( _needed[ attribute_num ].load( std::memory_order_relaxed ) );
+}
+
+/* Calls f with the values of an attribute at the width they were stored, then frees them. */
+template <typename T>
+template <typename Function>
+void dataset<T>::column_sink::release( std::size_t attribute_num, Function f ) {
+	switch( _widths[ attribute_num ] ) {
+		case BYTE_VALUES: {
+			std::vector<std::uint8_t> values = std::move( _bytes[ attribute_num ] );
+			f( values.data() );
+			break;
+		}
+		case SHORT_VALUES: {
+			std::vector<std::uint16_t> values = std::move( _shorts[ attribute_num ] );
+			f( values.data() );
+			break;
+		}
+		case FULL_VALUES: {
+			std::vector<T> values = std::move( _values[ attribute_num ] );
+			f( values.data() );
+			break;
+		}
+		default:
 			break;
 	}
+}
 
-	// perform basic attribute computations and cache results
-	_attr_info.reserve( num_attributes() );
-	for( std::size_t attribute_num = 0; attribute_num < num_attributes(); ++attribute_num ) {
-		auto attribute_begin = &_data( attribute_num, 0 );
-		auto attribute_end = attribute_begin + num_instances();
-		_attr_info.emplace_back( attribute_begin, attribute_end );
+/* Indexes attribute names for lookup; a repeated name refers to its first attribute. */
+template <typename T>
+void dataset<T>::index_names() {
+	_name_index.clear();
+	_name_index.reserve( _names.size() );
+	for( std::size_t attribute_num = 0; attribute_num < _names.size(); ++attribute_num ) {
+		_name_index.emplace( _names[ attribute_num ], attribute_num );
+	}
+}
+
+/* Summarizes, encodes and packs the values of one attribute, which may be of any type narrower than T. */
+template <typename T>
+template <typename Iterator>
+void dataset<T>::store_attribute( std::size_t attribute_num, Iterator values ) {
+	attribute_information<T> info( values, values + num_instances() );
+	// codes are encoded at the narrowest width numbering the attribute's values
+	if( info.num_values() <= 256 ) {
+		store_codes<std::uint8_t>( attribute_num, values, info );
+	} else if( info.num_values() <= 65536 ) {
+		store_codes<std::uint16_t>( attribute_num, values, info );
+	} else {
+		store_codes<std::uint32_t>( attribute_num, values, info );
+	}
+	_attr_info[ attribute_num ] = std::move( info );
+}
+
+template <typename T>
+template <typename C, typename Iterator>
+void dataset<T>::store_codes( std::size_t attribute_num, Iterator values, attribute_information<T> const & info ) {
+	std::vector<C> codes( num_instances() );
+	info.encode( values, values + num_instances(), codes.begin() );
+	_columns.set_column( attribute_num, codes.data(), info.num_values() );
+}
+
+/*
+ * Summarizes, encodes and stores an attribute given by the rows of its values that are
+ * not 0, in increasing order. An attribute whose values other than 0 are few enough is
+ * stored sparse without ever being laid out over all the rows.
+ */
+template <typename T>
+void dataset<T>::store_sparse_attribute( std::size_t attribute_num, std::uint32_t const * rows, double const * values, std::size_t num_entries,
+		discretization_method dm ) {
+	// values discretized to 0 join the values not given
+	std::vector<std::uint32_t> entry_rows;
+	std::vector<T> entry_values;
+	for( std::size_t entry = 0; entry < num_entries; ++entry ) {
+		double value = discretize( values[ entry ], dm );
+		if( ! holds( value ) ) {
+			std::cerr << "error: value out of range at row " << rows[ entry ] + 1 << ", attribute " << attribute_name( attribute_num ) << "\n";
+			exit( 2 );
+		}
+		if( value != 0.0 ) {
+			entry_rows.push_back( rows[ entry ] );
+			entry_values.push_back( static_cast<T>( value ) );
+		}
+	}
+
+	// one 0 stands for all the rows not among the entries
+	std::vector<T> distinct( entry_values );
+	std::size_t const num_zeros = num_instances() - entry_values.size();
+	if( num_zeros > 0 ) {
+		distinct.push_back( 0 );
 	}
+	std::sort( distinct.begin(), distinct.end() );
+	std::vector<T> sorted_values;
+	std::vector<std::size_t> counts;
+	for( T value : distinct ) {
+		if( sorted_values.empty() || value != sorted_values.back() ) {
+			sorted_values.push_back( value );
+			counts.push_back( value == 0 ? num_zeros - 1 : 0 );
+		}
+		++counts.back();
+	}
+	attribute_information<T> info( std::move( sorted_values ), std::move( counts ) );
+
+	if( info.num_values() > 0 && column_store::keeps_sparse( num_instances(), entry_rows.size(), info.num_values() ) ) {
+		std::vector<std::uint32_t> codes( entry_values.size() );
+		info.encode( entry_values.begin(), entry_values.end(), codes.begin() );
+		std::uint32_t zero_code = static_cast<std::uint32_t>( std::lower_bound( info.values().begin(), info.values().end(), T( 0 ) ) - info.values().begin() );
+		_columns.set_sparse_column( attribute_num, zero_code, std::move( entry_rows ), std::move( codes ), info.num_values() );
+		_attr_info[ attribute_num ] = std::move( info );
+		return;
+	}
+	std::vector<T> dense( num_instances(), 0 );
+	for( std::size_t entry = 0; entry < entry_rows.size(); ++entry ) {
+		dense[ entry_rows[ entry ] ] = entry_values[ entry ];
+	}
+	store_attribute( attribute_num, dense.begin() );
 }
 
 template <typename T>
 std::size_t dataset<T>::num_instances() const {
-	return _data.num_columns();
+	return _columns.num_rows();
 }
 
 template <typename T>
@@ -135,7 +577,7 @@ std::size_t dataset<T>::num_attributes() const {
 
 template <typename T>
 std::size_t dataset<T>::num_rows() const {
-	return _data.num_rows();
+	return _columns.num_columns();
 }
 
 template <typename T>
@@ -144,41 +586,117 @@ std::string dataset<T>::attribute_name( std::size_t attribute_num ) const {
 }
 
 template <typename T>
-int dataset<T>::attribute_value( std::string& name ) const {
-	for ( std::size_t i = 0; i < _names.size(); i++ )
-		if ( _names[i] == name )
-			return i;
+int dataset<T>::attribute_value( std::string const & name ) const {
+	auto it = _name_index.find( name );
+	return it == _name_index.end() ? -1 : static_cast<int>( it->second );
+}
 
-	return -1;
+/*
+ * Prepares an empty dataset for attributes added one at a time, fixing the number of
+ * instances and allocating room for the attributes up front so adding them never moves
+ * the ones already added.
+ */
+template <typename T>
+void dataset<T>::reserve( std::size_t num_attributes, std::size_t num_instances ) {
+	assert( this->num_attributes() == 0 );
+	_columns = column_store( num_instances, 0 );
+	_columns.reserve( num_attributes );
+	_names.reserve( num_attributes );
+	_attr_info.reserve( num_attributes );
+	_name_index.reserve( num_attributes );
 }
 
-template <typename T> 
-int dataset<T>::set_attribute( std::string& name, T* data, std::size_t length ) {
-	if ( num_attributes() > 0 && length != num_instances() ) {
+template <typename T>
+template <typename U>
+int dataset<T>::set_attribute( std::string const & name, U const * data, std::size_t length ) {
+	static_assert( std::is_integral<U>::value
+			&& static_cast<std::intmax_t>( std::numeric_limits<U>::min() ) >= static_cast<std::intmax_t>( std::numeric_limits<T>::min() )
+			&& static_cast<std::uintmax_t>( std::numeric_limits<U>::max() ) <= static_cast<std::uintmax_t>( std::numeric_limits<T>::max() ),
+			"attribute values must be representable in the dataset value type" );
+
+	// the number of instances is fixed by a reservation or by the first attribute
+	if ( ( num_attributes() > 0 || num_instances() > 0 ) && length != num_instances() ) {
 		return -1;
 	}
 
 	int attribute_num = attribute_value( name );
-	std::valarray<T> attribute_data( data, length );
 
 	if ( attribute_num < 0 ) {
 		// new attribute
+		if ( num_attributes() == 0 && num_instances() == 0 ) {
+			_columns = column_store( length, 0 );
+		}
 		_names.push_back(name);
-		_data.add_column( attribute_data );
-		attribute_num = _names.size() - 1;
-	}
-	else {
-		// existing attribute
-		_data.set_column( attribute_num, attribute_data );
-	} 
-	
-	auto attribute_begin = &_data( attribute_num, 0 );
-	auto attribute_end = attribute_begin + num_instances();
-
-	if ( attribute_num == static_cast<int>( num_attributes() - 1 ) )
-		_attr_info.emplace_back( attribute_begin, attribute_end );
-	else
-		_attr_info.emplace( _attr_info.begin() + attribute_num, attribute_begin, attribute_end );
+		_name_index.emplace( name, _names.size() - 1 );
+		_attr_info.emplace_back();
+		_columns.add_column();
+		attribute_num = static_cast<int>( num_attributes() - 1 );
+	}
+
+	// existing attribute, or the placeholder column just added
+	store_attribute( attribute_num, data );
+
+	return 0;
+}
+
+/*
+ * Sets several attributes from one buffer holding length instances of each, such as a
+ * two dimensional array in either order. The value of instance i of attribute a is read
+ * at data[ i * instance_stride + a * attribute_stride ], so every attribute is encoded in
+ * place without gathering it first. Attributes are added or replaced as set_attribute
+ * would in the order of names, and are encoded on num_threads threads.
+ */
+template <typename T>
+template <typename U>
+int dataset<T>::set_attributes( std::vector<std::string> const & names, U const * data, std::size_t length,
+		std::ptrdiff_t instance_stride, std::ptrdiff_t attribute_stride, std::size_t num_threads ) {
+	static_assert( std::is_integral<U>::value
+			&& static_cast<std::intmax_t>( std::numeric_limits<U>::min() ) >= static_cast<std::intmax_t>( std::numeric_limits<T>::min() )
+			&& static_cast<std::uintmax_t>( std::numeric_limits<U>::max() ) <= static_cast<std::uintmax_t>( std::numeric_limits<T>::max() ),
+			"attribute values must be representable in the dataset value type" );
+
+	if ( names.empty() ) {
+		return 0;
+	}
+	if ( ( ( num_attributes() > 0 || num_instances() > 0 ) && length != num_instances() ) || ( length > 1 && instance_stride == 0 ) ) {
+		return -1;
+	}
+	if ( num_attributes() == 0 && num_instances() == 0 ) {
+		_columns = column_store( length, 0 );
+	}
+
+	_names.reserve( num_attributes() + names.size() );
+	_attr_info.reserve( num_attributes() + names.size() );
+	_columns.reserve( num_attributes() + names.size() );
+
+	// assign every name its slot first, so a name given twice keeps its last values
+	std::vector<std::size_t> slots( names.size() );
+	std::vector<std::size_t> sources( num_attributes() + names.size(), names.size() );
+	for ( std::size_t i = 0; i < names.size(); ++i ) {
+		int attribute_num = attribute_value( names[ i ] );
+		if ( attribute_num < 0 ) {
+			_names.push_back( names[ i ] );
+			_name_index.emplace( names[ i ], _names.size() - 1 );
+			_attr_info.emplace_back();
+			_columns.add_column();
+			attribute_num = static_cast<int>( num_attributes() - 1 );
+		}
+		slots[ i ] = static_cast<std::size_t>( attribute_num );
+		sources[ slots[ i ] ] = i;
+	}
+
+	thread_pool pool( num_threads );
+	pool.parallel_for( 0, names.size(), [&]( std::size_t i ) {
+		if ( sources[ slots[ i ] ] != i ) {
+			return;
+		}
+		U const * first = data + static_cast<std::ptrdiff_t>( i ) * attribute_stride;
+		if ( instance_stride == 1 || length <= 1 ) {
+			store_attribute( slots[ i ], first );
+		} else {
+			store_attribute( slots[ i ], strided_values<U>( first, instance_stride ) );
+		}
+	} );
 
 	return 0;
 }
@@ -189,47 +707,676 @@ double dataset<T>::attribute_entropy( std::size_t attribute_num ) const {
 }
 
 template <typename T>
-double dataset<T>::mutual_information( std::size_t attribute1, std::size_t attribute2 ) const {
-	std::vector<T> a1_values = _attr_info.at( attribute1 ).values();
-	std::vector<T> a2_values = _attr_info.at( attribute2 ).values();
+attribute_information<T> const & dataset<T>::attribute_info( std::size_t attribute_num ) const {
+	return _attr_info[ attribute_num ];
+}
+
+template <typename T>
+column_store const & dataset<T>::columns() const {
+	return _columns;
+}
+
+template <typename T>
+std::size_t dataset<T>::histogram_budget() const {
+	return _histogram_budget;
+}
+
+template <typename T>
+void dataset<T>::set_histogram_budget( std::size_t bytes ) {
+	_histogram_budget = bytes;
+}
 
-	std::size_t a2_out_of_range = *std::max_element( a2_values.begin(), a2_values.end() ) + 1;
+/*
+ * A dataset of num_rows rows drawn at random without replacement, kept in their order
+ * here, with the same attributes. All the rows are taken when there are no more than
+ * num_rows. The same seed always draws the same rows.
+ */
+template <typename T>
+dataset<T> dataset<T>::sample_rows( std::size_t num_rows, std::uint64_t seed, std::size_t num_threads ) const {
+	std::vector<std::size_t> rows = sample_row_indices( num_instances(), num_rows, seed );
+	std::vector<T> values( rows.size() * num_attributes() );
+	thread_pool pool( num_threads );
+	pool.parallel_for( 0, num_attributes(), [&]( std::size_t attribute_num ) {
+		std::vector<T> const & attribute_values = _attr_info[ attribute_num ].values();
+		T * out = &values[ attribute_num * rows.size() ];
+		for( std::size_t i = 0; i < rows.size(); ++i ) {
+			out[ i ] = attribute_values[ checked_code( attribute_num, rows[ i ] ) ];
+		}
+	} );
+
+	dataset sample;
+	if( ! rows.empty() ) {
+		sample.set_attributes( _names, values.data(), rows.size(), 1, static_cast<std::ptrdiff_t>( rows.size() ), num_threads );
+	}
+	return sample;
+}
+
+/*
+ * Sorted indices of num_rows distinct rows out of num_instances, drawn with Floyd's
+ * algorithm so the work is in the rows drawn rather than in all the rows.
+ */
+template <typename T>
+std::vector<std::size_t> dataset<T>::sample_row_indices( std::size_t num_instances, std::size_t num_rows, std::uint64_t seed ) {
+	std::vector<std::size_t> rows;
+	if( num_rows >= num_instances ) {
+		rows.resize( num_instances );
+		for( std::size_t i = 0; i < num_instances; ++i ) {
+			rows[ i ] = i;
+		}
+		return rows;
+	}
+	std::mt19937_64 generator( seed );
+	std::unordered_set<std::size_t> drawn( num_rows * 2 );
+	for( std::size_t j = num_instances - num_rows; j < num_instances; ++j ) {
+		std::size_t row = std::uniform_int_distribution<std::size_t>( 0, j )( generator );
+		if( ! drawn.insert( row ).second ) {
+			drawn.insert( j );
+			row = j;
+		}
+		rows.push_back( row );
+	}
+	std::sort( rows.begin(), rows.end() );
+	return rows;
+}
+
+template <typename T>
+double dataset<T>::mutual_information( std::size_t attribute1, std::size_t attribute2 ) const {
+	std::size_t a1_num_values = _attr_info.at( attribute1 ).num_values();
+	std::size_t a2_num_values = _attr_info.at( attribute2 ).num_values();
 
-	if( a1_values.size() == 1 || a2_values.size() == 1 ) {
+	if( a1_num_values <= 1 || a2_num_values <= 1 ) {
+		statistics::get()->count_mutual_information( 1 );
 		return 0.0;
 	}
 
-	std::unordered_map<std::size_t, double> joint_probabilities;
-	for( std::size_t i = 0; i < num_instances(); ++i ) {
-		std::size_t value  = _data( attribute1, i ) * a2_out_of_range + _data( attribute2, i );
+	if( is_dense( attribute1, attribute2 ) ) {
+		double mutual_information;
+		mutual_information_many( attribute1, &attribute2, 1, &mutual_information );
+		return mutual_information;
+	}
 
-		if ( joint_probabilities.count( value ) == 0)
-		 	joint_probabilities[ value ] = 1;
-		else 
-			joint_probabilities[ value ]++;
+	return hashed_mutual_information( attribute1, attribute2 );
+}
+
+template <typename T>
+bool dataset<T>::is_dense( std::size_t attribute1, std::size_t attribute2 ) const {
+	// use a flat joint count table when the code ranges are small enough to stay in cache
+	return num_instances() <= std::numeric_limits<std::uint32_t>::max()
+		&& _attr_info[ attribute1 ].num_values() <= _histogram_budget / sizeof( std::uint32_t ) / _attr_info[ attribute2 ].num_values();
+}
+
+/*
+ * Computes the mutual information between anchor and each candidate. Candidates are
+ * grouped into blocks whose joint tables together fit the histogram budget, and each
+ * block is swept in row tiles so a tile of the anchor column is read from memory once
+ * and then reused from cache for every candidate in the block.
+ */
+template <typename T>
+void dataset<T>::mutual_information_many( std::size_t anchor, std::size_t const * candidates, std::size_t num_candidates, double * out ) const {
+	mutual_information_table( &anchor, 1, candidates, num_candidates, out );
+}
+
+/*
+ * Mutual information between every anchor and every candidate, written to
+ * out[ a * num_candidates + c ]. Each block of candidates is paired with all anchors in
+ * one pass over the rows, so a tile of every column involved is unpacked once per block
+ * however many anchors there are.
+ */
+template <typename T>
+void dataset<T>::mutual_information_table( std::size_t const * anchors, std::size_t num_anchors, std::size_t const * candidates, std::size_t num_candidates,
+		double * out ) const {
+	std::uint64_t num_counted = 0;
+	joint_count_tables( anchors, num_anchors, candidates, num_candidates, [&]( std::size_t a, std::size_t c, std::uint32_t const * counts ) {
+		if( counts == nullptr ) {
+			out[ a * num_candidates + c ] = mutual_information( anchors[ a ], candidates[ c ] );
+			return;
+		}
+		++num_counted;
+		std::vector<probability> const & anchor_probabilities = _attr_info[ anchors[ a ] ].probabilities();
+		std::vector<probability> const & candidate_probabilities = _attr_info[ candidates[ c ] ].probabilities();
+		out[ a * num_candidates + c ] = active_kernels().mutual_information( counts, anchor_probabilities.data(), anchor_probabilities.size(),
+				candidate_probabilities.data(), candidate_probabilities.size(), static_cast<double>( num_instances() ) );
+	} );
+	statistics::get()->count_mutual_information( num_counted );
+}
+
+/*
+ * Counts the joint table of every anchor and every candidate in the blocked passes of
+ * mutual_information_table, calling visit( a, c, counts ) once for each pair of
+ * anchors[ a ] and candidates[ c ]. counts holds the complete table, row-major by the
+ * anchor's code, and is only valid during the call. Pairs with a single value on either
+ * side or too many cells for a flat table are visited first in their block with counts
+ * null, leaving them to the caller. Pairs with a sparse column are counted from its
+ * entries alone and visited as soon as they are, without a pass over the rows.
+ */
+template <typename T>
+template <typename Visitor>
+void dataset<T>::joint_count_tables( std::size_t const * anchors, std::size_t num_anchors, std::size_t const * candidates, std::size_t num_candidates,
+		Visitor visit ) const {
+	struct block_pair {
+		std::size_t anchor;
+		std::size_t candidate;
+	};
+
+	// tiles start on a multiple of 64 rows so they start on a word in every packed column
+	std::size_t const tile_rows = std::max<std::size_t>( tile_bytes / ( max_block_candidates + num_anchors ) / 64, 1 ) * 64;
+
+	thread_local std::vector<std::uint32_t> counts;
+	thread_local std::vector<std::uint32_t> sparse_counts;
+	thread_local std::vector<unpacked_tiles> anchor_tiles;
+	thread_local unpacked_tiles candidate_tiles;
+	anchor_tiles.resize( std::max( anchor_tiles.size(), num_anchors ) );
+	for( auto & tiles : anchor_tiles ) {
+		tiles.clear();
 	}
+	candidate_tiles.clear();
+	std::vector<block_pair> block;
+	std::vector<std::size_t> offsets;
 
-	for ( auto& it : joint_probabilities )
-		it.second = it.second / static_cast<double>( num_instances() );
+	std::size_t next = 0;
+	while( next < num_candidates ) {
+		// gather the next block of candidates, pairing each with the anchors it has dense tables with
+		block.clear();
+		offsets.assign( 1, 0 );
+		std::size_t block_candidates = 0;
+		while( next < num_candidates && block_candidates < max_block_candidates ) {
+			std::size_t candidate = candidates[ next ];
+			std::size_t candidate_num_values = _attr_info.at( candidate ).num_values();
+			std::size_t num_cells = 0;
+			for( std::size_t a = 0; a < num_anchors; ++a ) {
+				std::size_t anchor_num_values = _attr_info.at( anchors[ a ] ).num_values();
+				if( anchor_num_values > 1 && candidate_num_values > 1 && is_dense( anchors[ a ], candidate )
+						&& ! _columns.is_sparse( anchors[ a ] ) && ! _columns.is_sparse( candidate ) ) {
+					num_cells += anchor_num_values * candidate_num_values;
+				}
+			}
+			if( block_candidates > 0 && num_cells > 0 && ( offsets.back() + num_cells ) * sizeof( std::uint32_t ) > _histogram_budget ) {
+				break;
+			}
+			for( std::size_t a = 0; a < num_anchors; ++a ) {
+				std::size_t anchor_num_values = _attr_info[ anchors[ a ] ].num_values();
+				if( anchor_num_values <= 1 || candidate_num_values <= 1 || ! is_dense( anchors[ a ], candidate ) ) {
+					visit( a, next, static_cast<std::uint32_t const *>( nullptr ) );
+					continue;
+				}
+				if( _columns.is_sparse( anchors[ a ] ) || _columns.is_sparse( candidate ) ) {
+					sparse_counts.assign( anchor_num_values * candidate_num_values, 0 );
+					sparse_joint_counts( anchors[ a ], candidate, sparse_counts.data() );
+					visit( a, next, static_cast<std::uint32_t const *>( sparse_counts.data() ) );
+					continue;
+				}
+				block.push_back( block_pair{ a, next } );
+				offsets.push_back( offsets.back() + anchor_num_values * candidate_num_values );
+			}
+			if( num_cells > 0 ) {
+				++block_candidates;
+			}
+			++next;
+		}
+		if( block.empty() ) {
+			continue;
+		}
 
-	double mutual_information = 0.0;
+		counts.assign( offsets.back(), 0 );
+		for( std::size_t row = 0; row < num_instances(); row += tile_rows ) {
+			std::size_t rows = std::min( tile_rows, num_instances() - row );
+			for( std::size_t b = 0; b < block.size(); ++b ) {
+				tile_joint_counts( anchors[ block[ b ].anchor ], candidates[ block[ b ].candidate ], row, rows,
+						anchor_tiles[ block[ b ].anchor ], candidate_tiles, counts.data() + offsets[ b ] );
+			}
+		}
+		statistics::get()->count_scan( block.size() * num_instances(), offsets.back() );
+
+		for( std::size_t b = 0; b < block.size(); ++b ) {
+			complete_joint_counts( anchors[ block[ b ].anchor ], candidates[ block[ b ].candidate ], counts.data() + offsets[ b ] );
+			visit( block[ b ].anchor, block[ b ].candidate, static_cast<std::uint32_t const *>( counts.data() + offsets[ b ] ) );
+		}
+	}
+}
+
+/*
+ * Codes index tables sized by the number of values. Columns packed here never hold a code
+ * beyond their values, but a column mapped from a binary file may be wider than its values
+ * need and is only trusted as far as it is read, so the codes of a corrupt file fail as the
+ * file would rather than counting outside the tables.
+ */
+template <typename T>
+std::uint32_t dataset<T>::checked_code( std::size_t attribute, std::size_t row ) const {
+	std::uint32_t code = _columns.get( attribute, row );
+	if( code >= _attr_info[ attribute ].num_values() ) {
+		codes_error( attribute );
+	}
+	return code;
+}
+
+template <typename T>
+template <typename C>
+void dataset<T>::check_codes( std::size_t attribute, C const * codes, std::size_t rows ) const {
+	std::size_t const num_values = _attr_info[ attribute ].num_values();
+	if( ! _columns.is_borrowed( attribute ) || ( std::uint64_t( 1 ) << _columns.bits( attribute ) ) <= num_values ) {
+		return;
+	}
+	using code_type = typename std::make_unsigned<C>::type;
+	code_type largest = 0;
+	for( std::size_t i = 0; i < rows; ++i ) {
+		largest = std::max( largest, static_cast<code_type>( codes[ i ] ) );
+	}
+	if( largest >= num_values ) {
+		codes_error( attribute );
+	}
+}
 
-	for( auto& a1_value : a1_values ) {
-		for( auto& a2_value : a2_values ) {
-			std::size_t value = a1_value * a2_out_of_range + a2_value;
+template <typename T>
+void dataset<T>::codes_error( std::size_t attribute ) const {
+	std::cerr << "error: attribute " << _names[ attribute ] << ": binary dataset is truncated or corrupt\n";
+	exit( 2 );
+}
 
-			probability joint_probability = joint_probabilities[ value ];
-			if ( joint_probability != 0 ) {
-				probability marginal_probability_i = _attr_info.at( attribute1 ).marginal_probability( a1_value );
-				probability marginal_probability_j = _attr_info.at( attribute2 ).marginal_probability( a2_value );
+template <typename T>
+void dataset<T>::unpacked_tiles::clear() {
+	uint8.attribute = uint16.attribute = int32.attribute = std::numeric_limits<std::size_t>::max();
+}
 
-				mutual_information += joint_probability * std::log2( joint_probability / ( marginal_probability_i * marginal_probability_j ) );
+template <typename T>
+template <typename C>
+C const * dataset<T>::unpacked_codes( std::size_t attribute, std::size_t first_row, std::size_t rows, unpacked_tile<C> & tile ) const {
+	// byte codes are already laid out as an array of bytes
+	if( sizeof( C ) == 1 && _columns.bits( attribute ) == 8 && ! _columns.is_sparse( attribute ) ) {
+		C const * codes = reinterpret_cast<C const *>( _columns.words( attribute ) ) + first_row;
+		check_codes( attribute, codes, rows );
+		return codes;
+	}
+	if( tile.attribute != attribute || tile.first_row != first_row || tile.codes.size() != rows ) {
+		tile.codes.resize( rows );
+		_columns.unpack( attribute, first_row, rows, tile.codes.data() );
+		check_codes( attribute, tile.codes.data(), rows );
+		tile.attribute = attribute;
+		tile.first_row = first_row;
+	}
+	return tile.codes.data();
+}
+
+template <typename T>
+template <typename C1>
+void dataset<T>::unpacked_joint_counts( std::size_t attribute1, std::size_t attribute2, std::size_t first_row, std::size_t rows,
+		unpacked_tile<C1> & tile1, unpacked_tiles & tiles2, std::uint32_t * counts ) const {
+	C1 const * codes1 = unpacked_codes( attribute1, first_row, rows, tile1 );
+	std::size_t const a1_num_values = _attr_info[ attribute1 ].num_values();
+	std::size_t const a2_num_values = _attr_info[ attribute2 ].num_values();
+	unsigned bits2 = _columns.bits( attribute2 );
+	if( bits2 <= 8 ) {
+		joint_counts( codes1, unpacked_codes( attribute2, first_row, rows, tiles2.uint8 ), rows, a1_num_values, a2_num_values, counts );
+	} else if( bits2 <= 16 ) {
+		joint_counts( codes1, unpacked_codes( attribute2, first_row, rows, tiles2.uint16 ), rows, a1_num_values, a2_num_values, counts );
+	} else {
+		joint_counts( codes1, unpacked_codes( attribute2, first_row, rows, tiles2.int32 ), rows, a1_num_values, a2_num_values, counts );
+	}
+}
+
+/*
+ * Adds the joint counts of two packed attributes over a row tile. Pairs of binary columns only
+ * count the rows where both are set, straight from the packed words, and pairs of 4-bit
+ * columns are counted by combining their nibbles; complete_joint_counts then finishes the
+ * tables. Any other pair unpacks each column to the narrowest width holding its own
+ * codes, so a byte column stays a byte column next to a wide one, and is counted with
+ * the kernel for that pair of widths.
+ */
+template <typename T>
+void dataset<T>::tile_joint_counts( std::size_t attribute1, std::size_t attribute2, std::size_t first_row, std::size_t rows,
+		unpacked_tiles & tiles1, unpacked_tiles & tiles2, std::uint32_t * counts ) const {
+	unsigned bits1 = _columns.bits( attribute1 );
+	unsigned bits2 = _columns.bits( attribute2 );
+
+	if( bits1 == 1 && bits2 == 1 ) {
+		std::size_t first_word = first_row / 64;
+		counts[ 3 ] += static_cast<std::uint32_t>( active_kernels().and_popcount( _columns.words( attribute1 ) + first_word,
+				_columns.words( attribute2 ) + first_word, column_store::words_for( rows, 1 ) ) );
+	} else if( bits1 == 4 && bits2 == 4 ) {
+		std::size_t first_word = first_row / 16;
+		std::size_t num_words = column_store::words_for( rows, 4 );
+		std::uint32_t nibble_counts[ 256 ] = {};
+		active_kernels().nibble_joint_counts( _columns.words( attribute1 ) + first_word, _columns.words( attribute2 ) + first_word, num_words, nibble_counts );
+		// padding past the last row is zero in both columns
+		nibble_counts[ 0 ] -= static_cast<std::uint32_t>( num_words * 16 - rows );
+		std::size_t const a1_num_values = _attr_info[ attribute1 ].num_values();
+		std::size_t const a2_num_values = _attr_info[ attribute2 ].num_values();
+		for( std::size_t c1 = 0; c1 < a1_num_values; ++c1 ) {
+			for( std::size_t c2 = 0; c2 < a2_num_values; ++c2 ) {
+				counts[ c1 * a2_num_values + c2 ] += nibble_counts[ ( c1 << 4 ) | c2 ];
 			}
 		}
+		// cells beyond the values only count codes of a corrupt binary file
+		for( std::size_t cell = 0; cell < 256; ++cell ) {
+			if( nibble_counts[ cell ] > 0 && ( cell >> 4 ) >= a1_num_values ) {
+				codes_error( attribute1 );
+			}
+			if( nibble_counts[ cell ] > 0 && ( cell & 15 ) >= a2_num_values ) {
+				codes_error( attribute2 );
+			}
+		}
+	} else if( bits1 <= 8 ) {
+		unpacked_joint_counts( attribute1, attribute2, first_row, rows, tiles1.uint8, tiles2, counts );
+	} else if( bits1 <= 16 ) {
+		unpacked_joint_counts( attribute1, attribute2, first_row, rows, tiles1.uint16, tiles2, counts );
+	} else {
+		unpacked_joint_counts( attribute1, attribute2, first_row, rows, tiles1.int32, tiles2, counts );
 	}
+}
+
+template <typename T>
+void dataset<T>::complete_joint_counts( std::size_t attribute1, std::size_t attribute2, std::uint32_t * counts ) const {
+	if( _columns.bits( attribute1 ) == 1 && _columns.bits( attribute2 ) == 1 ) {
+		// the remaining cells of a binary pair follow from the marginal counts
+		std::uint32_t both = counts[ 3 ];
+		std::uint32_t first = static_cast<std::uint32_t>( _attr_info[ attribute1 ].counts()[ 1 ] );
+		std::uint32_t second = static_cast<std::uint32_t>( _attr_info[ attribute2 ].counts()[ 1 ] );
+		counts[ 2 ] = first - both;
+		counts[ 1 ] = second - both;
+		counts[ 0 ] = static_cast<std::uint32_t>( num_instances() ) - first - second + both;
+	}
+}
+
+/*
+ * Counts the joint table of a pair with a sparse column from the entries alone. The rows
+ * outside a sparse column's entries all have its default code, so once the entries are
+ * counted, the cells of that code are what the other attribute's marginal counts leave.
+ */
+template <typename T>
+void dataset<T>::sparse_joint_counts( std::size_t attribute1, std::size_t attribute2, std::uint32_t * counts ) const {
+	std::size_t const a1_num_values = _attr_info[ attribute1 ].num_values();
+	std::size_t const a2_num_values = _attr_info[ attribute2 ].num_values();
+	std::size_t const entries1 = _columns.is_sparse( attribute1 ) ? _columns.num_entries( attribute1 ) : 0;
+	std::size_t const entries2 = _columns.is_sparse( attribute2 ) ? _columns.num_entries( attribute2 ) : 0;
+	std::uint32_t const * rows1 = _columns.entry_rows( attribute1 );
+	std::uint32_t const * rows2 = _columns.entry_rows( attribute2 );
+	std::uint32_t const * codes1 = _columns.entry_codes( attribute1 );
+	std::uint32_t const * codes2 = _columns.entry_codes( attribute2 );
+	std::size_t const default1 = _columns.default_code( attribute1 );
+	std::size_t const default2 = _columns.default_code( attribute2 );
+
+	if( _columns.is_sparse( attribute1 ) && _columns.is_sparse( attribute2 ) ) {
+		// merge the entries of both; the rows in neither have both default codes
+		std::size_t i = 0;
+		std::size_t j = 0;
+		std::size_t num_rows = 0;
+		for( ; i < entries1 || j < entries2; ++num_rows ) {
+			if( j == entries2 || ( i < entries1 && rows1[ i ] < rows2[ j ] ) ) {
+				++counts[ codes1[ i++ ] * a2_num_values + default2 ];
+			} else if( i == entries1 || rows2[ j ] < rows1[ i ] ) {
+				++counts[ default1 * a2_num_values + codes2[ j++ ] ];
+			} else {
+				++counts[ codes1[ i++ ] * a2_num_values + codes2[ j++ ] ];
+			}
+		}
+		counts[ default1 * a2_num_values + default2 ] += static_cast<std::uint32_t>( num_instances() - num_rows );
+	} else if( _columns.is_sparse( attribute1 ) ) {
+		for( std::size_t i = 0; i < entries1; ++i ) {
+			++counts[ codes1[ i ] * a2_num_values + _columns.get( attribute2, rows1[ i ] ) ];
+		}
+		std::vector<std::size_t> const & a2_counts = _attr_info[ attribute2 ].counts();
+		for( std::size_t c2 = 0; c2 < a2_num_values; ++c2 ) {
+			std::size_t rest = a2_counts[ c2 ];
+			for( std::size_t c1 = 0; c1 < a1_num_values; ++c1 ) {
+				rest -= c1 == default1 ? 0 : counts[ c1 * a2_num_values + c2 ];
+			}
+			counts[ default1 * a2_num_values + c2 ] = static_cast<std::uint32_t>( rest );
+		}
+	} else {
+		for( std::size_t j = 0; j < entries2; ++j ) {
+			++counts[ _columns.get( attribute1, rows2[ j ] ) * a2_num_values + codes2[ j ] ];
+		}
+		std::vector<std::size_t> const & a1_counts = _attr_info[ attribute1 ].counts();
+		for( std::size_t c1 = 0; c1 < a1_num_values; ++c1 ) {
+			std::size_t rest = a1_counts[ c1 ];
+			for( std::size_t c2 = 0; c2 < a2_num_values; ++c2 ) {
+				rest -= c2 == default2 ? 0 : counts[ c1 * a2_num_values + c2 ];
+			}
+			counts[ c1 * a2_num_values + default2 ] = static_cast<std::uint32_t>( rest );
+		}
+	}
+	statistics::get()->count_scan( entries1 + entries2, a1_num_values * a2_num_values );
+}
+
+/*
+ * Mutual information of a pair whose flat joint table would be too large for the histogram
+ * budget, counting only the cells that occur in a hash table keyed by both codes. This is
+ * the fallback of mutual_information for wide value ranges; pairs with a sparse column are
+ * counted from its entries by sparse_joint_counts instead.
+ */
+template <typename T>
+double dataset<T>::hashed_mutual_information( std::size_t attribute1, std::size_t attribute2 ) const {
+	std::vector<probability> const & a1_probabilities = _attr_info[ attribute1 ].probabilities();
+	std::vector<probability> const & a2_probabilities = _attr_info[ attribute2 ].probabilities();
+	std::size_t const a2_num_values = a2_probabilities.size();
+
+	std::unordered_map<std::size_t, std::size_t> joint_counts;
+	for( std::size_t i = 0; i < num_instances(); ++i ) {
+		++joint_counts[ static_cast<std::size_t>( checked_code( attribute1, i ) ) * a2_num_values + static_cast<std::size_t>( checked_code( attribute2, i ) ) ];
+	}
+
+	double const n = static_cast<double>( num_instances() );
+	double mutual_information = 0.0;
+	for( auto & entry : joint_counts ) {
+		probability joint_probability = entry.second / n;
+		probability marginal_probability_i = a1_probabilities[ entry.first / a2_num_values ];
+		probability marginal_probability_j = a2_probabilities[ entry.first % a2_num_values ];
+		mutual_information += joint_probability * std::log2( joint_probability / ( marginal_probability_i * marginal_probability_j ) );
+	}
+	statistics::get()->count_mutual_information( 1 );
+	statistics::get()->count_scan( num_instances(), joint_counts.size() );
 	return mutual_information;
 }
 
+/*
+ * Writes the dataset in the binary columnar format of binary_format.hpp. Columns are
+ * written exactly as packed in memory, and sparse columns as they would be packed, with
+ * the attribute summaries alongside, so open_binary can map them back without parsing or
+ * recomputing anything.
+ */
+template <typename T>
+void dataset<T>::save_binary( std::ostream & os ) const {
+	std::vector<binary_format::attribute> attributes( num_attributes() );
+	std::uint64_t offset = sizeof( binary_format::header ) + num_attributes() * sizeof( binary_format::attribute );
+
+	binary_format::header header = {};
+	std::memcpy( header.magic, binary_format::magic, sizeof( header.magic ) );
+	header.version = binary_format::version;
+	header.byte_order = binary_format::byte_order;
+	header.value_size = sizeof( T );
+	header.value_signed = std::is_signed<T>::value ? 1 : 0;
+	header.num_attributes = num_attributes();
+	header.num_instances = num_instances();
+	header.names_offset = offset;
+	for( auto const & name : _names ) {
+		header.names_size += name.size() + 1;
+	}
+	offset += header.names_size;
+
+	for( std::size_t attribute_num = 0; attribute_num < num_attributes(); ++attribute_num ) {
+		binary_format::attribute & attribute = attributes[ attribute_num ];
+		attribute.num_values = _attr_info[ attribute_num ].num_values();
+		attribute.bits = _columns.bits( attribute_num );
+		attribute.entropy = _attr_info[ attribute_num ].entropy();
+		attribute.values_offset = binary_format::align( offset, sizeof( std::uint64_t ) );
+		attribute.counts_offset = attribute.values_offset + attribute.num_values * sizeof( std::int64_t );
+		offset = attribute.counts_offset + attribute.num_values * sizeof( std::uint64_t );
+	}
+	for( std::size_t attribute_num = 0; attribute_num < num_attributes(); ++attribute_num ) {
+		attributes[ attribute_num ].column_offset = binary_format::align( offset, binary_format::column_alignment );
+		offset = attributes[ attribute_num ].column_offset + _columns.num_words( attribute_num ) * sizeof( std::uint64_t );
+	}
+	header.file_size = offset;
+
+	std::uint64_t written = 0;
+	auto write = [&os, &written]( void const * data, std::uint64_t size ) {
+		os.write( static_cast<char const *>( data ), static_cast<std::streamsize>( size ) );
+		written += size;
+	};
+	auto pad_to = [&write, &written]( std::uint64_t position ) {
+		static const char zeros[ binary_format::column_alignment ] = {};
+		write( zeros, position - written );
+	};
+
+	write( &header, sizeof( header ) );
+	write( attributes.data(), attributes.size() * sizeof( binary_format::attribute ) );
+	for( auto const & name : _names ) {
+		write( name.c_str(), name.size() + 1 );
+	}
+	for( std::size_t attribute_num = 0; attribute_num < num_attributes(); ++attribute_num ) {
+		attribute_information<T> const & info = _attr_info[ attribute_num ];
+		pad_to( attributes[ attribute_num ].values_offset );
+		for( std::size_t code = 0; code < info.num_values(); ++code ) {
+			std::int64_t value = static_cast<std::int64_t>( info.value( static_cast<T>( code ) ) );
+			write( &value, sizeof( value ) );
+		}
+		for( std::size_t code = 0; code < info.num_values(); ++code ) {
+			std::uint64_t count = info.counts()[ code ];
+			write( &count, sizeof( count ) );
+		}
+	}
+	for( std::size_t attribute_num = 0; attribute_num < num_attributes(); ++attribute_num ) {
+		pad_to( attributes[ attribute_num ].column_offset );
+		if( _columns.is_sparse( attribute_num ) ) {
+			std::vector<std::uint64_t> words = _columns.pack( attribute_num );
+			write( words.data(), words.size() * sizeof( std::uint64_t ) );
+		} else {
+			write( _columns.words( attribute_num ), _columns.num_words( attribute_num ) * sizeof( std::uint64_t ) );
+		}
+	}
+}
+
+template <typename T>
+bool dataset<T>::is_binary( std::string const & path ) {
+	char magic[ sizeof( binary_format::magic ) ];
+	std::ifstream ifs( path, std::ios::binary );
+	return ifs.read( magic, sizeof( magic ) ) && binary_format::has_magic( magic, sizeof( magic ) );
+}
+
+template <typename T>
+void dataset<T>::binary_error( std::string const & path, char const * message ) {
+	std::cerr << "error: " << path << ": " << message << "\n";
+	exit( 2 );
+}
+
+/*
+ * Opens a file written by save_binary. The file is mapped and the packed columns are used
+ * in place; only the names and the attribute summaries are copied out.
+ */
+template <typename T>
+dataset<T> dataset<T>::open_binary( std::string const & path ) {
+	std::shared_ptr<mapped_file> file = std::make_shared<mapped_file>();
+	if( ! file->open( path ) ) {
+		binary_error( path, "cannot map binary dataset" );
+	}
+	char const * data = file->data();
+	std::uint64_t const size = file->size();
+	// whether count items of width bytes at offset lie within the file, without overflowing on corrupt sizes
+	auto in_file = [size]( std::uint64_t offset, std::uint64_t count, std::uint64_t width ) {
+		return offset <= size && count <= ( size - offset ) / width;
+	};
+
+	binary_format::header header;
+	if( ! binary_format::has_magic( data, size ) || size < sizeof( header ) ) {
+		binary_error( path, "not a binary dataset" );
+	}
+	std::memcpy( &header, data, sizeof( header ) );
+	if( header.version != binary_format::version ) {
+		binary_error( path, "unsupported binary dataset version" );
+	}
+	if( header.byte_order != binary_format::byte_order ) {
+		binary_error( path, "binary dataset was written with a different byte order" );
+	}
+	if( header.file_size != size || ! in_file( sizeof( header ), header.num_attributes, sizeof( binary_format::attribute ) )
+			|| ( header.num_attributes > 0 && header.num_instances / 8 > size )
+			|| ! in_file( header.names_offset, header.names_size, 1 ) ) {
+		binary_error( path, "binary dataset is truncated or corrupt" );
+	}
+
+	dataset<T> result;
+	char const * names = data + header.names_offset;
+	char const * names_end = names + header.names_size;
+	while( names < names_end ) {
+		char const * end = std::find( names, names_end, '\0' );
+		if( end == names_end ) {
+			binary_error( path, "binary dataset is truncated or corrupt" );
+		}
+		result._names.emplace_back( names, end );
+		names = end + 1;
+	}
+	if( result._names.size() != header.num_attributes ) {
+		binary_error( path, "binary dataset is truncated or corrupt" );
+	}
+	result.index_names();
+
+	result._attr_info.resize( header.num_attributes );
+	result._columns = column_store( static_cast<std::size_t>( header.num_instances ), static_cast<std::size_t>( header.num_attributes ) );
+	for( std::size_t attribute_num = 0; attribute_num < header.num_attributes; ++attribute_num ) {
+		binary_format::attribute attribute;
+		std::memcpy( &attribute, data + sizeof( header ) + attribute_num * sizeof( attribute ), sizeof( attribute ) );
+		unsigned bits = attribute.bits;
+		// only a dataset without rows has attributes without values
+		if( ( attribute.num_values == 0 ) != ( header.num_instances == 0 ) || attribute.num_values > header.num_instances
+				|| ( bits != 1 && bits != 2 && bits != 4 && bits != 8 && bits != 16 && bits != 32 )
+				|| ! in_file( attribute.values_offset, attribute.num_values, sizeof( std::int64_t ) )
+				|| ! in_file( attribute.counts_offset, attribute.num_values, sizeof( std::uint64_t ) )
+				|| attribute.column_offset % binary_format::column_alignment != 0
+				|| ! in_file( attribute.column_offset, column_store::words_for( header.num_instances, bits ), sizeof( std::uint64_t ) ) ) {
+			binary_error( path, "binary dataset is truncated or corrupt" );
+		}
+
+		std::vector<T> values( attribute.num_values );
+		std::vector<std::size_t> counts( attribute.num_values );
+		for( std::size_t code = 0; code < attribute.num_values; ++code ) {
+			std::int64_t value;
+			std::uint64_t count;
+			std::memcpy( &value, data + attribute.values_offset + code * sizeof( value ), sizeof( value ) );
+			std::memcpy( &count, data + attribute.counts_offset + code * sizeof( count ), sizeof( count ) );
+			// values are saved at 64 bits, so any type holding every value of the file reads it
+			values[ code ] = static_cast<T>( value );
+			if( static_cast<std::int64_t>( values[ code ] ) != value ) {
+				binary_error( path, "binary dataset holds values the value type cannot represent" );
+			}
+			counts[ code ] = static_cast<std::size_t>( count );
+		}
+		result._attr_info[ attribute_num ] = attribute_information<T>( std::move( values ), std::move( counts ), attribute.entropy );
+		result._columns.borrow_column( attribute_num, bits, reinterpret_cast<std::uint64_t const *>( data + attribute.column_offset ), file );
+	}
+	return result;
+}
+
+/*
+ * Reads a dataset from sparse text in the libsvm format of parse_sparse_table. The label
+ * is the attribute named class and the value at index i the attribute named i. Only the
+ * values given are ever held, so an attribute that stays sparse takes memory and time in
+ * proportion to its nonzero values rather than to the rows.
+ */
+template <typename T>
+dataset<T> dataset<T>::from_libsvm( char const * first, char const * last, discretization_method dm, std::size_t num_threads ) {
+	sparse_table table;
+	{
+		statistics_phase phase( "parse" );
+		parse_sparse_table( first, last, num_threads, table );
+	}
+
+	dataset<T> result;
+	result._names.push_back( "class" );
+	for( std::size_t column = 1; column < table.num_columns; ++column ) {
+		result._names.push_back( std::to_string( column ) );
+	}
+	result.index_names();
+	result._attr_info.resize( table.num_columns );
+	result._columns = column_store( table.num_rows, table.num_columns );
+
+	statistics_phase phase( "attribute_information" );
+	thread_pool pool( num_threads );
+	pool.parallel_for( 0, table.num_columns, [&result, &table, dm]( std::size_t attribute_num ) {
+		std::size_t const first_entry = table.offsets[ attribute_num ];
+		result.store_sparse_attribute( attribute_num, table.rows.data() + first_entry, table.values.data() + first_entry,
+				table.offsets[ attribute_num + 1 ] - first_entry, dm );
+	} );
+	return result;
+}
+
 template <typename T>
 std::ostream & operator<<( std::ostream & os, dataset<T> const & data ) {
 	if( data.num_attributes() > 0 ) {
@@ -238,7 +1385,17 @@ std::ostream & operator<<( std::ostream & os, dataset<T> const & data ) {
 			os << '\t' << data._names.at( i );
 		}
 		os << '\n';
-		os << data._data.transpose();
+		// widen single byte values so they are written as numbers rather than characters
+		using output_type = typename std::conditional< sizeof( T ) == 1, int, T >::type;
+		for( std::size_t instance_num = 0; instance_num < data.num_instances(); ++instance_num ) {
+			for( std::size_t attribute_num = 0; attribute_num < data.num_attributes(); ++attribute_num ) {
+				if( attribute_num > 0 ) {
+					os << '\t';
+				}
+				os << static_cast< output_type >( data._attr_info[ attribute_num ].value( static_cast<T>( data.checked_code( attribute_num, instance_num ) ) ) );
+			}
+			os << '\n';
+		}
 	}
 	return os;
 }
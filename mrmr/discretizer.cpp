@@ -0,0 +1,441 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include "discretizer.hpp"
+#include "text_parser.hpp"
+
+quantile_sketch::quantile_sketch( std::size_t capacity ) : _capacity( capacity + capacity % 2 ), _count( 0 ),
+		_min( std::numeric_limits<double>::infinity() ), _max( -std::numeric_limits<double>::infinity() ), _levels( 1 ), _keep_odd( 1, false ) {
+}
+
+void quantile_sketch::add( double value ) {
+	_min = std::min( _min, value );
+	_max = std::max( _max, value );
+	++_count;
+	if( _capacity == 0 ) {
+		return;
+	}
+	_levels[ 0 ].push_back( value );
+	if( _levels[ 0 ].size() >= _capacity ) {
+		compact( 0 );
+	}
+}
+
+void quantile_sketch::compact( std::size_t level ) {
+	if( level + 1 == _levels.size() ) {
+		_levels.emplace_back();
+		_keep_odd.push_back( false );
+	}
+	std::vector<double> & items = _levels[ level ];
+	std::vector<double> & next = _levels[ level + 1 ];
+	std::sort( items.begin(), items.end() );
+	for( std::size_t i = _keep_odd[ level ] ? 1 : 0; i < items.size(); i += 2 ) {
+		next.push_back( items[ i ] );
+	}
+	_keep_odd[ level ] = ! _keep_odd[ level ];
+	items.clear();
+	if( next.size() >= _capacity ) {
+		compact( level + 1 );
+	}
+}
+
+std::uint64_t quantile_sketch::count() const {
+	return _count;
+}
+
+double quantile_sketch::min() const {
+	return _min;
+}
+
+double quantile_sketch::max() const {
+	return _max;
+}
+
+std::vector<quantile_sketch::item> quantile_sketch::items() const {
+	std::vector<item> result;
+	for( std::size_t level = 0; level < _levels.size(); ++level ) {
+		for( double value : _levels[ level ] ) {
+			result.push_back( item{ value, std::uint64_t( 1 ) << level } );
+		}
+	}
+	std::sort( result.begin(), result.end(), []( item const & a, item const & b ) {
+		return a.value < b.value;
+	} );
+	return result;
+}
+
+binning_strategy::~binning_strategy() {
+}
+
+bool binning_strategy::needs_class_counts() const {
+	return false;
+}
+
+namespace {
+
+/* Bins of equal width between the smallest and largest value. */
+class equal_width_binning : public binning_strategy {
+	public:
+		explicit equal_width_binning( std::size_t num_bins ) : _num_bins( num_bins ) {}
+
+		bool needs_sketch() const override {
+			return false;
+		}
+
+		std::vector<double> cuts( attribute_summary const & summary ) const override {
+			quantile_sketch const & values = summary.values;
+			std::vector<double> result;
+			if( values.count() == 0 || ! ( values.max() > values.min() ) ) {
+				return result;
+			}
+			double width = ( values.max() - values.min() ) / static_cast<double>( _num_bins );
+			for( std::size_t i = 1; i < _num_bins; ++i ) {
+				result.push_back( values.min() + width * static_cast<double>( i ) );
+			}
+			return result;
+		}
+
+	private:
+		std::size_t _num_bins;
+};
+
+/* Bins holding about equal numbers of values, cut at estimated quantiles; bins a repeated value would leave empty are merged. */
+class equal_frequency_binning : public binning_strategy {
+	public:
+		explicit equal_frequency_binning( std::size_t num_bins ) : _num_bins( num_bins ) {}
+
+		bool needs_sketch() const override {
+			return true;
+		}
+
+		std::vector<double> cuts( attribute_summary const & summary ) const override {
+			quantile_sketch const & values = summary.values;
+			std::vector<double> result;
+			double const count = static_cast<double>( values.count() );
+			double below = 0.0;
+			std::size_t bin = 1;
+			for( auto const & item : values.items() ) {
+				for( ; bin < _num_bins && below >= count * static_cast<double>( bin ) / static_cast<double>( _num_bins ); ++bin ) {
+					if( item.value > values.min() && ( result.empty() || item.value > result.back() ) ) {
+						result.push_back( item.value );
+					}
+				}
+				below += static_cast<double>( item.weight );
+			}
+			return result;
+		}
+
+	private:
+		std::size_t _num_bins;
+};
+
+/*
+ * Supervised binning by Fayyad and Irani's minimum description length criterion: the
+ * values are split recursively at the cut that most reduces the entropy of the labels,
+ * for as long as the information gained pays for describing the cut. The cuts considered
+ * are the candidates between equal-frequency intervals of the sketch, whose class counts
+ * are exact; with no more rows than sketch_capacity, that is every distinct value.
+ */
+class mdl_binning : public binning_strategy {
+	public:
+		bool needs_sketch() const override {
+			return true;
+		}
+
+		bool needs_class_counts() const override {
+			return true;
+		}
+
+		std::vector<double> cuts( attribute_summary const & summary ) const override {
+			// class counts of the intervals holding rows, as running sums from the lowest; the
+			// cut below each but the first is the candidate bounding it
+			std::size_t const num_labels = summary.num_labels;
+			std::vector<double> result;
+			if( num_labels == 0 ) {
+				return result;
+			}
+			std::vector<double> bounds;
+			std::vector<double> prefix( num_labels, 0.0 );
+			for( std::size_t interval = 0; interval <= summary.candidates.size(); ++interval ) {
+				auto counts = summary.class_counts.begin() + static_cast<std::ptrdiff_t>( interval * num_labels );
+				if( std::all_of( counts, counts + static_cast<std::ptrdiff_t>( num_labels ), []( std::uint64_t count ) { return count == 0; } ) ) {
+					continue;
+				}
+				if( prefix.size() > num_labels ) {
+					bounds.push_back( summary.candidates[ interval - 1 ] );
+				}
+				std::size_t const row = prefix.size();
+				prefix.resize( row + num_labels );
+				for( std::size_t label = 0; label < num_labels; ++label ) {
+					prefix[ row + label ] = prefix[ row - num_labels + label ] + static_cast<double>( counts[ label ] );
+				}
+			}
+
+			split( bounds, prefix, num_labels, 0, prefix.size() / num_labels - 1, result );
+			std::sort( result.begin(), result.end() );
+			return result;
+		}
+
+	private:
+		/* Entropy in bits of counts, their total and the number of labels present. */
+		static double entropy( std::vector<double> const & counts, double & total, std::size_t & present ) {
+			total = 0.0;
+			present = 0;
+			for( double count : counts ) {
+				total += count;
+				present += count > 0.0;
+			}
+			double h = 0.0;
+			for( double count : counts ) {
+				if( count > 0.0 ) {
+					h -= count / total * std::log2( count / total );
+				}
+			}
+			return h;
+		}
+
+		/* Splits the intervals [first, last), whose class counts are the rows first to last of prefix apart. */
+		static void split( std::vector<double> const & bounds, std::vector<double> const & prefix, std::size_t num_labels,
+				std::size_t first, std::size_t last, std::vector<double> & result ) {
+			if( last - first < 2 ) {
+				return;
+			}
+			auto counts_between = [&prefix, num_labels]( std::size_t from, std::size_t to, std::vector<double> & counts ) {
+				counts.resize( num_labels );
+				for( std::size_t label = 0; label < num_labels; ++label ) {
+					counts[ label ] = prefix[ to * num_labels + label ] - prefix[ from * num_labels + label ];
+				}
+			};
+			std::vector<double> counts;
+			counts_between( first, last, counts );
+			double total;
+			std::size_t present;
+			double const h = entropy( counts, total, present );
+			if( h <= 0.0 ) {
+				return;
+			}
+
+			std::size_t best = 0;
+			double best_h = std::numeric_limits<double>::infinity();
+			double best_left_h = 0.0;
+			double best_right_h = 0.0;
+			std::size_t best_left_present = 0;
+			std::size_t best_right_present = 0;
+			std::vector<double> left;
+			std::vector<double> right;
+			for( std::size_t cut = first + 1; cut < last; ++cut ) {
+				counts_between( first, cut, left );
+				counts_between( cut, last, right );
+				double left_total, right_total;
+				std::size_t left_present, right_present;
+				double left_h = entropy( left, left_total, left_present );
+				double right_h = entropy( right, right_total, right_present );
+				double split_h = ( left_total * left_h + right_total * right_h ) / total;
+				if( split_h < best_h ) {
+					best = cut;
+					best_h = split_h;
+					best_left_h = left_h;
+					best_right_h = right_h;
+					best_left_present = left_present;
+					best_right_present = right_present;
+				}
+			}
+
+			// 3^k - 2 overflows for many labels, where it is 3^k to within rounding
+			double const k = static_cast<double>( present );
+			double const log_choices = present > 30 ? k * std::log2( 3.0 ) : std::log2( std::pow( 3.0, k ) - 2.0 );
+			double const delta = log_choices - ( k * h - static_cast<double>( best_left_present ) * best_left_h
+					- static_cast<double>( best_right_present ) * best_right_h );
+			if( total <= 1.0 || h - best_h <= ( std::log2( total - 1.0 ) + delta ) / total ) {
+				return;
+			}
+			result.push_back( bounds[ best - 1 ] );
+			split( bounds, prefix, num_labels, first, best, result );
+			split( bounds, prefix, num_labels, best, last, result );
+		}
+};
+
+/* Receives the rows of a block of text as raw values, column-major so each attribute's task reads its values in order. */
+class row_block_sink : public table_sink {
+	public:
+		explicit row_block_sink( std::size_t num_attributes ) : _num_attributes( num_attributes ), _num_rows( 0 ) {}
+
+		void begin( std::size_t num_rows, std::size_t num_columns ) override {
+			if( num_rows > 0 && num_columns != _num_attributes ) {
+				std::cerr << "error: header names " << _num_attributes << " attributes but rows have " << num_columns << " columns\n";
+				exit( 2 );
+			}
+			_num_rows = num_rows;
+			_values.resize( num_rows * _num_attributes );
+		}
+
+		std::size_t store_row( std::size_t row, double const * values ) override {
+			for( std::size_t attribute_num = 0; attribute_num < _num_attributes; ++attribute_num ) {
+				_values[ attribute_num * _num_rows + row ] = values[ attribute_num ];
+			}
+			return _num_attributes;
+		}
+
+		std::size_t num_rows() const {
+			return _num_rows;
+		}
+
+		double const * values() const {
+			return _values.data();
+		}
+
+	private:
+		std::size_t _num_attributes;
+		std::size_t _num_rows;
+		std::vector<double> _values;
+};
+
+}
+
+std::unique_ptr<binning_strategy> make_binning_strategy( binning_options const & options ) {
+	switch( options.method ) {
+		case binning_method::EQUAL_WIDTH:
+			return std::unique_ptr<binning_strategy>( new equal_width_binning( std::max<std::size_t>( options.num_bins, 1 ) ) );
+		case binning_method::EQUAL_FREQUENCY:
+			return std::unique_ptr<binning_strategy>( new equal_frequency_binning( std::max<std::size_t>( options.num_bins, 1 ) ) );
+		case binning_method::MDL:
+			return std::unique_ptr<binning_strategy>( new mdl_binning() );
+		default:
+			return nullptr;
+	}
+}
+
+discretizer::discretizer() {
+}
+
+discretizer::discretizer( std::vector<std::vector<double> > cuts, std::vector<bool> binned ) : _cuts( std::move( cuts ) ), _binned( std::move( binned ) ) {
+}
+
+bool discretizer::binned( std::size_t attribute_num ) const {
+	return attribute_num < _binned.size() && _binned[ attribute_num ];
+}
+
+std::vector<double> const & discretizer::cuts( std::size_t attribute_num ) const {
+	return _cuts[ attribute_num ];
+}
+
+discretizer_fitter::discretizer_fitter( binning_options const & options, std::size_t num_attributes, std::size_t num_threads,
+		std::function<double( double )> label_of ) : _options( options ), _strategy( make_binning_strategy( options ) ),
+		_num_attributes( num_attributes ), _label_of( std::move( label_of ) ), _binned( num_attributes, _strategy != nullptr ),
+		_pass( 0 ), _pool( num_threads ) {
+	for( auto class_attribute : options.class_attributes ) {
+		if( class_attribute < num_attributes ) {
+			_binned[ class_attribute ] = false;
+		}
+	}
+	_summaries.assign( num_attributes, attribute_summary( _strategy && _strategy->needs_sketch() ? options.sketch_capacity : 0 ) );
+}
+
+std::size_t discretizer_fitter::num_passes() const {
+	return _strategy && _strategy->needs_class_counts() ? 2 : 1;
+}
+
+std::size_t discretizer_fitter::add_text( char const * first, char const * last, std::size_t row_offset ) {
+	row_block_sink sink( _num_attributes );
+	std::size_t num_rows = 0;
+	while( first != last ) {
+		char const * block_last = last;
+		if( static_cast<std::size_t>( last - first ) > block_bytes ) {
+			block_last = std::find( first + block_bytes, last, '\n' );
+			block_last += block_last != last;
+		}
+		parse_table( first, block_last, _pool.num_threads(), sink, row_offset + num_rows );
+		add_rows( sink.values(), sink.num_rows() );
+		num_rows += sink.num_rows();
+		first = block_last;
+	}
+	return num_rows;
+}
+
+void discretizer_fitter::add_rows( double const * values, std::size_t num_rows ) {
+	bool const counting = _pass > 0;
+	if( counting || ( _strategy && _strategy->needs_class_counts() ) ) {
+		// labels are taken once per row rather than by the task of every attribute; the first
+		// pass collects them and the second numbers each row's
+		std::size_t const label_attribute = _options.class_attributes.empty() ? 0 : _options.class_attributes.front();
+		_row_labels.resize( num_rows );
+		for( std::size_t row = 0; row < num_rows; ++row ) {
+			double const label = label_attribute < _num_attributes ? _label_of( values[ label_attribute * num_rows + row ] ) : 0.0;
+			auto position = std::lower_bound( _labels.begin(), _labels.end(), label );
+			if( ! counting && ( position == _labels.end() || *position != label ) ) {
+				position = _labels.insert( position, label );
+			}
+			_row_labels[ row ] = static_cast<std::size_t>( position - _labels.begin() );
+		}
+	}
+	_pool.parallel_for( 0, _num_attributes, [this, values, num_rows, counting]( std::size_t attribute_num ) {
+		if( ! _binned[ attribute_num ] ) {
+			return;
+		}
+		attribute_summary & summary = _summaries[ attribute_num ];
+		double const * column = values + attribute_num * num_rows;
+		if( counting ) {
+			for( std::size_t row = 0; row < num_rows; ++row ) {
+				double const value = column[ row ];
+				std::size_t const interval = static_cast<std::size_t>( std::upper_bound( summary.candidates.begin(), summary.candidates.end(), value )
+						- summary.candidates.begin() );
+				++summary.class_counts[ interval * summary.num_labels + _row_labels[ row ] ];
+			}
+		} else {
+			for( std::size_t row = 0; row < num_rows; ++row ) {
+				summary.values.add( column[ row ] );
+			}
+		}
+	} );
+}
+
+void discretizer_fitter::end_pass() {
+	if( _pass++ > 0 || num_passes() == 1 ) {
+		return;
+	}
+	if( _labels.size() > max_labels ) {
+		std::cerr << "error: class attribute has " << _labels.size() << " distinct values, more than supervised binning can count (" << max_labels << ")\n";
+		exit( 2 );
+	}
+	// the finest equal-frequency intervals the sketch resolves
+	equal_frequency_binning intervals( std::max<std::size_t>( _options.sketch_capacity, 1 ) );
+	_pool.parallel_for( 0, _num_attributes, [this, &intervals]( std::size_t attribute_num ) {
+		if( _binned[ attribute_num ] ) {
+			attribute_summary & summary = _summaries[ attribute_num ];
+			summary.candidates = intervals.cuts( summary );
+			summary.num_labels = _labels.size();
+			summary.class_counts.assign( ( summary.candidates.size() + 1 ) * summary.num_labels, 0 );
+		}
+	} );
+}
+
+discretizer discretizer_fitter::finish() {
+	std::vector<std::vector<double> > cuts( _num_attributes );
+	_pool.parallel_for( 0, _num_attributes, [this, &cuts]( std::size_t attribute_num ) {
+		if( _binned[ attribute_num ] ) {
+			cuts[ attribute_num ] = _strategy->cuts( _summaries[ attribute_num ] );
+		}
+	} );
+	return discretizer( std::move( cuts ), _binned );
+}
@@ -0,0 +1,196 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MRMR_DISCRETIZER_HPP
+#define MRMR_DISCRETIZER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "thread_pool.hpp"
+
+/*
+ * Binning of continuous attributes into a few intervals as they are read, for data whose
+ * raw values are too fine to count. Fitting takes one pass over the rows, or two for MDL,
+ * a block at a time, keeping only a summary of each attribute, so it works the same on
+ * text in memory and on files rescanned from disk; the rows are then read again and each
+ * value replaced by the number of its bin.
+ */
+
+enum class binning_method : char {
+	NONE = 0,
+	EQUAL_WIDTH = 1,
+	EQUAL_FREQUENCY = 2,
+	MDL = 3
+};
+
+struct binning_options {
+	binning_method method = binning_method::NONE;
+
+	// bins of equal width or frequency; MDL chooses the number of each attribute's bins
+	std::size_t num_bins = 10;
+
+	// attributes left unbinned, of which the first is the class MDL splits by
+	std::vector<std::size_t> class_attributes;
+
+	// items a level of each quantile sketch holds before it is compacted
+	std::size_t sketch_capacity = 512;
+};
+
+/*
+ * Summary of a stream of values from which quantiles are estimated in bounded memory.
+ * Items are buffered in levels, an item of level l standing for 2^l values; a full level
+ * is sorted and every other item promoted to the next, alternating which half is kept so
+ * the error does not drift one way. With at most capacity items a level, ranks are within
+ * about num_levels / capacity of the count, and a stream no longer than capacity is kept
+ * exactly. A sketch of capacity 0 only keeps the count and range of the values.
+ */
+class quantile_sketch {
+	public:
+		struct item {
+			double value;
+			std::uint64_t weight;
+		};
+
+		explicit quantile_sketch( std::size_t capacity = 512 );
+		void add( double value );
+		std::uint64_t count() const;
+		double min() const;
+		double max() const;
+
+		/* Items sorted by value, with weights summing to count. */
+		std::vector<item> items() const;
+
+	private:
+		void compact( std::size_t level );
+
+		std::size_t _capacity;
+		std::uint64_t _count;
+		double _min;
+		double _max;
+		std::vector<std::vector<double> > _levels;
+		std::vector<bool> _keep_odd;
+};
+
+/*
+ * What fitting gathers about one attribute: a sketch of its values and, for strategies
+ * that ask, the number of rows of each class between candidate cuts chosen from the
+ * sketch, counted exactly in a second pass over the rows.
+ */
+struct attribute_summary {
+	explicit attribute_summary( std::size_t capacity ) : values( capacity ) {}
+
+	quantile_sketch values;
+
+	// cut points in increasing order, and the rows of each label in each interval they
+	// bound as num_labels counts per interval, the interval below the first cut first
+	std::vector<double> candidates;
+	std::vector<std::uint64_t> class_counts;
+	std::size_t num_labels = 0;
+};
+
+/*
+ * Chooses the cut points of one attribute from a summary of its values. Methods plug in
+ * by deriving from this and adding a case to make_binning_strategy.
+ */
+class binning_strategy {
+	public:
+		virtual ~binning_strategy();
+
+		/* Whether the sketch keeps items, rather than only the count and range of the values. */
+		virtual bool needs_sketch() const = 0;
+
+		/* Whether fitting makes a second pass to count the rows of each class between candidate cuts. */
+		virtual bool needs_class_counts() const;
+
+		/* Cut points in increasing order. */
+		virtual std::vector<double> cuts( attribute_summary const & summary ) const = 0;
+};
+
+std::unique_ptr<binning_strategy> make_binning_strategy( binning_options const & options );
+
+/* Cut points fitted for each attribute, mapping its values to the numbers of their bins. */
+class discretizer {
+	public:
+		discretizer();
+		discretizer( std::vector<std::vector<double> > cuts, std::vector<bool> binned );
+
+		bool binned( std::size_t attribute_num ) const;
+		std::vector<double> const & cuts( std::size_t attribute_num ) const;
+
+		/* Number of the bin of value: the count of cut points not above it. */
+		double bin( std::size_t attribute_num, double value ) const;
+
+	private:
+		std::vector<std::vector<double> > _cuts;
+		std::vector<bool> _binned;
+};
+
+inline double discretizer::bin( std::size_t attribute_num, double value ) const {
+	std::vector<double> const & cuts = _cuts[ attribute_num ];
+	return static_cast<double>( std::upper_bound( cuts.begin(), cuts.end(), value ) - cuts.begin() );
+}
+
+/*
+ * Fits a discretizer to rows given a block at a time, in num_passes passes over all the
+ * rows each followed by end_pass. Each block is summarized on all threads, one attribute
+ * per task. label_of gives the class of a row from its raw class value, as the class
+ * attribute itself is discretized.
+ */
+class discretizer_fitter {
+	public:
+		discretizer_fitter( binning_options const & options, std::size_t num_attributes, std::size_t num_threads,
+				std::function<double( double )> label_of );
+
+		std::size_t num_passes() const;
+
+		/* Adds the rows of text in [first, last), returning their number; row_offset places them in the whole input for errors. */
+		std::size_t add_text( char const * first, char const * last, std::size_t row_offset = 0 );
+
+		/* Adds num_rows rows given column-major, as num_attributes runs of num_rows values. */
+		void add_rows( double const * values, std::size_t num_rows );
+
+		void end_pass();
+		discretizer finish();
+
+		/* Bytes of text parsed into values at a time by add_text. */
+		static const std::size_t block_bytes = 1 << 21;
+
+		/* Most distinct classes counted between candidate cuts. */
+		static const std::size_t max_labels = 1 << 12;
+
+	private:
+		binning_options _options;
+		std::unique_ptr<binning_strategy> _strategy;
+		std::size_t _num_attributes;
+		std::function<double( double )> _label_of;
+		std::vector<bool> _binned;
+		std::vector<attribute_summary> _summaries;
+		std::vector<double> _labels;
+		std::vector<std::size_t> _row_labels;
+		std::size_t _pass;
+		thread_pool _pool;
+};
+
+#endif
@@ -0,0 +1,760 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "kernels.hpp"
+
+#if defined( __GNUC__ ) && defined( __x86_64__ )
+#define MRMR_X86_KERNELS
+// GCC's AVX-512 headers self-initialise their undefined vectors, which trips -Wuninitialized
+// wherever the intrinsics are inlined
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/* Joint histograms are split over this many interleaved sub-histograms so consecutive
+ * increments of the same cell do not serialise on store-to-load forwarding. */
+const std::size_t num_sub_histograms = 4;
+
+/* Tables larger than this many cells are accumulated into a single histogram. */
+const std::size_t sub_histogram_cells = 1 << 14;
+
+template <typename C1, typename C2 = C1>
+void scalar_joint_counts( C1 const * codes1, C2 const * codes2, std::size_t length,
+		std::size_t, std::size_t num_values2, std::uint32_t * counts ) {
+	for( std::size_t i = 0; i < length; ++i ) {
+		++counts[ static_cast<std::size_t>( codes1[ i ] ) * num_values2 + static_cast<std::size_t>( codes2[ i ] ) ];
+	}
+}
+
+/* Scalar joint counts spread over interleaved sub-histograms, merged once at the end. */
+template <typename C1, typename C2>
+void sub_histogram_joint_counts( C1 const * codes1, C2 const * codes2, std::size_t length,
+		std::size_t num_values1, std::size_t num_values2, std::uint32_t * counts ) {
+	// clearing and merging the extra tables must be cheap next to the rows counted
+	std::size_t num_cells = num_values1 * num_values2;
+	if( num_cells > sub_histogram_cells || length < num_sub_histograms * num_cells ) {
+		scalar_joint_counts( codes1, codes2, length, num_values1, num_values2, counts );
+		return;
+	}
+
+	thread_local std::vector<std::uint32_t> storage;
+	storage.assign( ( num_sub_histograms - 1 ) * num_cells, 0 );
+	std::uint32_t * histogram1 = storage.data();
+	std::uint32_t * histogram2 = histogram1 + num_cells;
+	std::uint32_t * histogram3 = histogram2 + num_cells;
+
+	std::size_t i = 0;
+	for( ; i + num_sub_histograms <= length; i += num_sub_histograms ) {
+		++counts[ static_cast<std::size_t>( codes1[ i ] ) * num_values2 + static_cast<std::size_t>( codes2[ i ] ) ];
+		++histogram1[ static_cast<std::size_t>( codes1[ i + 1 ] ) * num_values2 + static_cast<std::size_t>( codes2[ i + 1 ] ) ];
+		++histogram2[ static_cast<std::size_t>( codes1[ i + 2 ] ) * num_values2 + static_cast<std::size_t>( codes2[ i + 2 ] ) ];
+		++histogram3[ static_cast<std::size_t>( codes1[ i + 3 ] ) * num_values2 + static_cast<std::size_t>( codes2[ i + 3 ] ) ];
+	}
+	scalar_joint_counts( codes1 + i, codes2 + i, length - i, num_values1, num_values2, counts );
+
+	for( std::size_t cell = 0; cell < num_cells; ++cell ) {
+		counts[ cell ] += histogram1[ cell ] + histogram2[ cell ] + histogram3[ cell ];
+	}
+}
+
+double scalar_mutual_information( std::uint32_t const * counts, probability const * probabilities1, std::size_t num_values1,
+		probability const * probabilities2, std::size_t num_values2, double num_instances ) {
+	double mutual_information = 0.0;
+	for( std::size_t c1 = 0; c1 < num_values1; ++c1 ) {
+		probability marginal_probability_i = probabilities1[ c1 ];
+		for( std::size_t c2 = 0; c2 < num_values2; ++c2 ) {
+			std::uint32_t joint_count = counts[ c1 * num_values2 + c2 ];
+			if( joint_count != 0 ) {
+				probability joint_probability = joint_count / num_instances;
+				probability marginal_probability_j = probabilities2[ c2 ];
+				mutual_information += joint_probability * std::log2( joint_probability / ( marginal_probability_i * marginal_probability_j ) );
+			}
+		}
+	}
+	return mutual_information;
+}
+
+double scalar_entropy( probability const * probabilities, std::size_t num_values ) {
+	double sum = 0.0;
+	for( std::size_t i = 0; i < num_values; ++i ) {
+		sum += probabilities[ i ] * std::log( probabilities[ i ] );
+	}
+	return -1 * sum / std::log( 2 );
+}
+
+std::uint64_t scalar_and_popcount( std::uint64_t const * words1, std::uint64_t const * words2, std::size_t num_words ) {
+	std::uint64_t count = 0;
+	for( std::size_t i = 0; i < num_words; ++i ) {
+		count += static_cast<std::uint64_t>( __builtin_popcountll( words1[ i ] & words2[ i ] ) );
+	}
+	return count;
+}
+
+/*
+ * Merges the codes of two 4-bit columns into one byte per row, ( code1 << 4 ) | code2,
+ * without unpacking either column: the low and high nibbles of each byte are combined
+ * separately, giving sixteen joint cells per pair of words.
+ */
+void scalar_nibble_joint_counts( std::uint64_t const * words1, std::uint64_t const * words2, std::size_t num_words, std::uint32_t * counts ) {
+	const std::uint64_t low_nibbles = 0x0F0F0F0F0F0F0F0FULL;
+	std::uint32_t histograms[ num_sub_histograms ][ 256 ] = {};
+	for( std::size_t i = 0; i < num_words; ++i ) {
+		std::uint64_t low = ( ( words1[ i ] & low_nibbles ) << 4 ) | ( words2[ i ] & low_nibbles );
+		std::uint64_t high = ( words1[ i ] & ~low_nibbles ) | ( ( words2[ i ] >> 4 ) & low_nibbles );
+		for( std::size_t byte = 0; byte < 8; byte += 2 ) {
+			++histograms[ 0 ][ ( low >> ( 8 * byte ) ) & 0xFF ];
+			++histograms[ 1 ][ ( high >> ( 8 * byte ) ) & 0xFF ];
+			++histograms[ 2 ][ ( low >> ( 8 * byte + 8 ) ) & 0xFF ];
+			++histograms[ 3 ][ ( high >> ( 8 * byte + 8 ) ) & 0xFF ];
+		}
+	}
+	for( std::size_t cell = 0; cell < 256; ++cell ) {
+		counts[ cell ] += histograms[ 0 ][ cell ] + histograms[ 1 ][ cell ] + histograms[ 2 ][ cell ] + histograms[ 3 ][ cell ];
+	}
+}
+
+/* Best mRMR score seen so far and where, ties going to the candidate of greatest index. */
+struct best_score_candidate {
+	double score;
+	std::size_t position;
+	std::size_t index;
+	bool found;
+
+	best_score_candidate(): score( -std::numeric_limits<double>::infinity() ), position( 0 ), index( 0 ), found( false ) { }
+
+	void update( double candidate_score, std::size_t candidate_position, std::size_t candidate_index ) {
+		if( candidate_score > score || ( candidate_score == score && ( ! found || candidate_index > index ) ) ) {
+			score = candidate_score;
+			position = candidate_position;
+			index = candidate_index;
+			found = true;
+		}
+	}
+
+	std::size_t result( std::size_t length, double * best_score ) const {
+		*best_score = score;
+		return found ? position : length;
+	}
+};
+
+template <bool Quotient>
+void scalar_mrmr_scores( double const * relevance, double * redundance, double const * mutual_information,
+		std::size_t const * indices, std::size_t first, std::size_t last, double num_selected, best_score_candidate & best ) {
+	for( std::size_t i = first; i < last; ++i ) {
+		redundance[ i ] += mutual_information[ i ];
+		double redundance_value = redundance[ i ] / num_selected;
+		best.update( Quotient ? relevance[ i ] / ( redundance_value + 0.0001 ) : relevance[ i ] - redundance_value, i, indices[ i ] );
+	}
+}
+
+std::size_t scalar_best_mrmr_score( double const * relevance, double * redundance, double const * mutual_information,
+		std::size_t const * indices, std::size_t length, double num_selected, bool quotient, double * best_score ) {
+	best_score_candidate best;
+	if( quotient ) {
+		scalar_mrmr_scores<true>( relevance, redundance, mutual_information, indices, 0, length, num_selected, best );
+	} else {
+		scalar_mrmr_scores<false>( relevance, redundance, mutual_information, indices, 0, length, num_selected, best );
+	}
+	return best.result( length, best_score );
+}
+
+const mi_kernels scalar_kernels = {
+	SCALAR_KERNEL, "scalar",
+	scalar_joint_counts<std::uint8_t>,
+	scalar_joint_counts<std::uint16_t>,
+	scalar_joint_counts<std::int32_t>,
+	scalar_mutual_information,
+	scalar_entropy,
+	scalar_and_popcount,
+	scalar_nibble_joint_counts,
+	scalar_best_mrmr_score
+};
+
+#ifdef MRMR_X86_KERNELS
+
+/*
+ * Natural logarithm via log(x) = e * ln(2) + 2 * atanh( (m - 1) / (m + 1) ) with the
+ * mantissa m reduced to [sqrt(1/2), sqrt(2)). Eleven terms of the atanh series keep the
+ * result within a few ulp of std::log over all positive normal inputs.
+ */
+const double sqrt2 = 1.41421356237309504880;
+const double ln2 = 0.69314718055994530942;
+
+const double log_series[] = {
+	1.0 / 23, 1.0 / 21, 1.0 / 19, 1.0 / 17, 1.0 / 15, 1.0 / 13,
+	1.0 / 11, 1.0 / 9, 1.0 / 7, 1.0 / 5, 1.0 / 3, 1.0
+};
+
+__attribute__(( target( "avx2,fma" ) ))
+inline __m256d avx2_log( __m256d x ) {
+	__m256i bits = _mm256_castpd_si256( x );
+	__m256i exponent64 = _mm256_sub_epi64( _mm256_srli_epi64( bits, 52 ), _mm256_set1_epi64x( 1023 ) );
+	__m256d mantissa = _mm256_castsi256_pd( _mm256_or_si256(
+			_mm256_and_si256( bits, _mm256_set1_epi64x( 0x000FFFFFFFFFFFFFLL ) ),
+			_mm256_set1_epi64x( 0x3FF0000000000000LL ) ) );
+	__m128i exponent32 = _mm256_castsi256_si128( _mm256_permutevar8x32_epi32( exponent64, _mm256_setr_epi32( 0, 2, 4, 6, 0, 0, 0, 0 ) ) );
+	__m256d exponent = _mm256_cvtepi32_pd( exponent32 );
+
+	__m256d large = _mm256_cmp_pd( mantissa, _mm256_set1_pd( sqrt2 ), _CMP_GT_OQ );
+	mantissa = _mm256_blendv_pd( mantissa, _mm256_mul_pd( mantissa, _mm256_set1_pd( 0.5 ) ), large );
+	exponent = _mm256_add_pd( exponent, _mm256_and_pd( large, _mm256_set1_pd( 1.0 ) ) );
+
+	__m256d f = _mm256_sub_pd( mantissa, _mm256_set1_pd( 1.0 ) );
+	__m256d s = _mm256_div_pd( f, _mm256_add_pd( f, _mm256_set1_pd( 2.0 ) ) );
+	__m256d z = _mm256_mul_pd( s, s );
+	__m256d poly = _mm256_set1_pd( log_series[ 0 ] );
+	for( std::size_t i = 1; i < sizeof( log_series ) / sizeof( log_series[ 0 ] ); ++i ) {
+		poly = _mm256_fmadd_pd( poly, z, _mm256_set1_pd( log_series[ i ] ) );
+	}
+	__m256d log_mantissa = _mm256_mul_pd( _mm256_add_pd( s, s ), poly );
+	return _mm256_fmadd_pd( exponent, _mm256_set1_pd( ln2 ), log_mantissa );
+}
+
+__attribute__(( target( "avx2,fma" ) ))
+inline double avx2_horizontal_sum( __m256d v ) {
+	__m128d sum = _mm_add_pd( _mm256_castpd256_pd128( v ), _mm256_extractf128_pd( v, 1 ) );
+	return _mm_cvtsd_f64( _mm_add_sd( sum, _mm_unpackhi_pd( sum, sum ) ) );
+}
+
+/*
+ * Tiny joint tables, such as those of binary and ternary attributes, are counted by
+ * comparing a block of codes against every value at once and counting the matching
+ * lanes of each pair of masks, which avoids scattered increments altogether.
+ */
+template <typename C> struct avx2_block;
+
+template <> struct avx2_block<std::uint8_t> {
+	static const std::size_t width = 32;
+	__m256i codes;
+
+	__attribute__(( target( "avx2,fma" ) ))
+	explicit avx2_block( std::uint8_t const * data ) : codes( _mm256_loadu_si256( reinterpret_cast<__m256i const *>( data ) ) ) { }
+
+	__attribute__(( target( "avx2,fma" ) ))
+	std::uint64_t equal( std::size_t value ) const {
+		return static_cast<std::uint32_t>( _mm256_movemask_epi8( _mm256_cmpeq_epi8( codes, _mm256_set1_epi8( static_cast<char>( value ) ) ) ) );
+	}
+};
+
+template <> struct avx2_block<std::uint16_t> {
+	static const std::size_t width = 32;
+	__m256i low;
+	__m256i high;
+
+	__attribute__(( target( "avx2,fma" ) ))
+	explicit avx2_block( std::uint16_t const * data ) :
+			low( _mm256_loadu_si256( reinterpret_cast<__m256i const *>( data ) ) ),
+			high( _mm256_loadu_si256( reinterpret_cast<__m256i const *>( data + 16 ) ) ) { }
+
+	// packing shuffles lanes, but identically for every mask so pairwise matches still line up
+	__attribute__(( target( "avx2,fma" ) ))
+	std::uint64_t equal( std::size_t value ) const {
+		__m256i v = _mm256_set1_epi16( static_cast<short>( value ) );
+		return static_cast<std::uint32_t>( _mm256_movemask_epi8( _mm256_packs_epi16( _mm256_cmpeq_epi16( low, v ), _mm256_cmpeq_epi16( high, v ) ) ) );
+	}
+};
+
+template <> struct avx2_block<std::int32_t> {
+	static const std::size_t width = 32;
+	__m256i codes[ 4 ];
+
+	__attribute__(( target( "avx2,fma" ) ))
+	explicit avx2_block( std::int32_t const * data ) {
+		for( std::size_t i = 0; i < 4; ++i ) {
+			codes[ i ] = _mm256_loadu_si256( reinterpret_cast<__m256i const *>( data + 8 * i ) );
+		}
+	}
+
+	__attribute__(( target( "avx2,fma" ) ))
+	std::uint64_t equal( std::size_t value ) const {
+		__m256i v = _mm256_set1_epi32( static_cast<int>( value ) );
+		__m256i low = _mm256_packs_epi32( _mm256_cmpeq_epi32( codes[ 0 ], v ), _mm256_cmpeq_epi32( codes[ 1 ], v ) );
+		__m256i high = _mm256_packs_epi32( _mm256_cmpeq_epi32( codes[ 2 ], v ), _mm256_cmpeq_epi32( codes[ 3 ], v ) );
+		return static_cast<std::uint32_t>( _mm256_movemask_epi8( _mm256_packs_epi16( low, high ) ) );
+	}
+};
+
+template <typename C> struct avx512_block;
+
+template <> struct avx512_block<std::uint8_t> {
+	static const std::size_t width = 64;
+	__m512i codes;
+
+	__attribute__(( target( "avx512f,avx512bw" ) ))
+	explicit avx512_block( std::uint8_t const * data ) : codes( _mm512_loadu_si512( data ) ) { }
+
+	__attribute__(( target( "avx512f,avx512bw" ) ))
+	std::uint64_t equal( std::size_t value ) const {
+		return _mm512_cmpeq_epi8_mask( codes, _mm512_set1_epi8( static_cast<char>( value ) ) );
+	}
+};
+
+template <> struct avx512_block<std::uint16_t> {
+	static const std::size_t width = 32;
+	__m512i codes;
+
+	__attribute__(( target( "avx512f,avx512bw" ) ))
+	explicit avx512_block( std::uint16_t const * data ) : codes( _mm512_loadu_si512( data ) ) { }
+
+	__attribute__(( target( "avx512f,avx512bw" ) ))
+	std::uint64_t equal( std::size_t value ) const {
+		return _mm512_cmpeq_epi16_mask( codes, _mm512_set1_epi16( static_cast<short>( value ) ) );
+	}
+};
+
+template <> struct avx512_block<std::int32_t> {
+	static const std::size_t width = 16;
+	__m512i codes;
+
+	__attribute__(( target( "avx512f,avx512bw" ) ))
+	explicit avx512_block( std::int32_t const * data ) : codes( _mm512_loadu_si512( data ) ) { }
+
+	__attribute__(( target( "avx512f,avx512bw" ) ))
+	std::uint64_t equal( std::size_t value ) const {
+		return _mm512_cmpeq_epi32_mask( codes, _mm512_set1_epi32( static_cast<int>( value ) ) );
+	}
+};
+
+/* Largest number of values per attribute, and of cells per table for each vector width,
+ * for which counting with masks beats the sub-histograms. */
+const std::size_t mask_table_values = 8;
+const std::size_t avx2_mask_table_cells = 16;
+const std::size_t avx512_mask_table_cells = 36;
+
+template <typename Block, typename C>
+__attribute__(( target( "avx2,fma,popcnt" ) ))
+inline std::size_t mask_joint_counts( C const * codes1, C const * codes2, std::size_t length,
+		std::size_t num_values1, std::size_t num_values2, std::uint32_t * counts ) {
+	std::uint64_t masks2[ mask_table_values ];
+	std::size_t i = 0;
+	for( ; i + Block::width <= length; i += Block::width ) {
+		Block block1( codes1 + i );
+		Block block2( codes2 + i );
+		for( std::size_t c2 = 0; c2 < num_values2; ++c2 ) {
+			masks2[ c2 ] = block2.equal( c2 );
+		}
+		for( std::size_t c1 = 0; c1 < num_values1; ++c1 ) {
+			std::uint64_t mask1 = block1.equal( c1 );
+			for( std::size_t c2 = 0; c2 < num_values2; ++c2 ) {
+				counts[ c1 * num_values2 + c2 ] += __builtin_popcountll( mask1 & masks2[ c2 ] );
+			}
+		}
+	}
+	return i;
+}
+
+template <typename Block, typename C>
+__attribute__(( target( "avx512f,avx512bw,popcnt" ) ))
+inline std::size_t mask512_joint_counts( C const * codes1, C const * codes2, std::size_t length,
+		std::size_t num_values1, std::size_t num_values2, std::uint32_t * counts ) {
+	std::uint64_t masks2[ mask_table_values ];
+	std::size_t i = 0;
+	for( ; i + Block::width <= length; i += Block::width ) {
+		Block block1( codes1 + i );
+		Block block2( codes2 + i );
+		for( std::size_t c2 = 0; c2 < num_values2; ++c2 ) {
+			masks2[ c2 ] = block2.equal( c2 );
+		}
+		for( std::size_t c1 = 0; c1 < num_values1; ++c1 ) {
+			std::uint64_t mask1 = block1.equal( c1 );
+			for( std::size_t c2 = 0; c2 < num_values2; ++c2 ) {
+				counts[ c1 * num_values2 + c2 ] += __builtin_popcountll( mask1 & masks2[ c2 ] );
+			}
+		}
+	}
+	return i;
+}
+
+inline bool is_mask_table( std::size_t num_values1, std::size_t num_values2, std::size_t max_cells ) {
+	return num_values1 <= mask_table_values && num_values2 <= mask_table_values && num_values1 * num_values2 <= max_cells;
+}
+
+template <typename C>
+__attribute__(( target( "avx2,fma,popcnt" ) ))
+void avx2_joint_counts( C const * codes1, C const * codes2, std::size_t length,
+		std::size_t num_values1, std::size_t num_values2, std::uint32_t * counts ) {
+	std::size_t i = 0;
+	if( is_mask_table( num_values1, num_values2, avx2_mask_table_cells ) ) {
+		i = mask_joint_counts< avx2_block<C> >( codes1, codes2, length, num_values1, num_values2, counts );
+	}
+	sub_histogram_joint_counts( codes1 + i, codes2 + i, length - i, num_values1, num_values2, counts );
+}
+
+template <typename C>
+__attribute__(( target( "avx512f,avx512bw,popcnt" ) ))
+void avx512_joint_counts( C const * codes1, C const * codes2, std::size_t length,
+		std::size_t num_values1, std::size_t num_values2, std::uint32_t * counts ) {
+	std::size_t i = 0;
+	if( is_mask_table( num_values1, num_values2, avx512_mask_table_cells ) ) {
+		i = mask512_joint_counts< avx512_block<C> >( codes1, codes2, length, num_values1, num_values2, counts );
+	}
+	sub_histogram_joint_counts( codes1 + i, codes2 + i, length - i, num_values1, num_values2, counts );
+}
+
+__attribute__(( target( "avx2,fma" ) ))
+double avx2_mutual_information( std::uint32_t const * counts, probability const * probabilities1, std::size_t num_values1,
+		probability const * probabilities2, std::size_t num_values2, double num_instances ) {
+	if( num_instances > std::numeric_limits<std::int32_t>::max() ) {
+		return scalar_mutual_information( counts, probabilities1, num_values1, probabilities2, num_values2, num_instances );
+	}
+
+	__m256d sum = _mm256_setzero_pd();
+	__m256d n = _mm256_set1_pd( num_instances );
+	__m256d one = _mm256_set1_pd( 1.0 );
+	double tail = 0.0;
+	for( std::size_t c1 = 0; c1 < num_values1; ++c1 ) {
+		std::uint32_t const * row = counts + c1 * num_values2;
+		__m256d marginal_probability_i = _mm256_set1_pd( probabilities1[ c1 ] );
+		std::size_t c2 = 0;
+		for( ; c2 + 4 <= num_values2; c2 += 4 ) {
+			__m256d joint_count = _mm256_cvtepi32_pd( _mm_loadu_si128( reinterpret_cast<__m128i const *>( row + c2 ) ) );
+			__m256d present = _mm256_cmp_pd( joint_count, _mm256_setzero_pd(), _CMP_NEQ_OQ );
+			__m256d joint_probability = _mm256_div_pd( joint_count, n );
+			__m256d ratio = _mm256_div_pd( joint_probability, _mm256_mul_pd( marginal_probability_i, _mm256_loadu_pd( probabilities2 + c2 ) ) );
+			ratio = _mm256_blendv_pd( one, ratio, present );
+			sum = _mm256_fmadd_pd( joint_probability, avx2_log( ratio ), sum );
+		}
+		for( ; c2 < num_values2; ++c2 ) {
+			if( row[ c2 ] != 0 ) {
+				probability joint_probability = row[ c2 ] / num_instances;
+				tail += joint_probability * std::log( joint_probability / ( probabilities1[ c1 ] * probabilities2[ c2 ] ) );
+			}
+		}
+	}
+	return ( avx2_horizontal_sum( sum ) + tail ) / ln2;
+}
+
+__attribute__(( target( "avx2,fma" ) ))
+double avx2_entropy( probability const * probabilities, std::size_t num_values ) {
+	__m256d sum = _mm256_setzero_pd();
+	std::size_t i = 0;
+	for( ; i + 4 <= num_values; i += 4 ) {
+		__m256d p = _mm256_loadu_pd( probabilities + i );
+		sum = _mm256_fmadd_pd( p, avx2_log( p ), sum );
+	}
+	double tail = 0.0;
+	for( ; i < num_values; ++i ) {
+		tail += probabilities[ i ] * std::log( probabilities[ i ] );
+	}
+	return -1 * ( avx2_horizontal_sum( sum ) + tail ) / std::log( 2 );
+}
+
+/* Population count through a nibble lookup table held in a shuffle register. */
+__attribute__(( target( "avx2,fma" ) ))
+std::uint64_t avx2_and_popcount( std::uint64_t const * words1, std::uint64_t const * words2, std::size_t num_words ) {
+	const __m256i table = _mm256_setr_epi8( 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 );
+	const __m256i low_nibbles = _mm256_set1_epi8( 0x0F );
+	__m256i sum = _mm256_setzero_si256();
+	std::size_t i = 0;
+	for( ; i + 4 <= num_words; i += 4 ) {
+		__m256i v = _mm256_and_si256( _mm256_loadu_si256( reinterpret_cast<__m256i const *>( words1 + i ) ),
+				_mm256_loadu_si256( reinterpret_cast<__m256i const *>( words2 + i ) ) );
+		__m256i bytes = _mm256_add_epi8( _mm256_shuffle_epi8( table, _mm256_and_si256( v, low_nibbles ) ),
+				_mm256_shuffle_epi8( table, _mm256_and_si256( _mm256_srli_epi16( v, 4 ), low_nibbles ) ) );
+		sum = _mm256_add_epi64( sum, _mm256_sad_epu8( bytes, _mm256_setzero_si256() ) );
+	}
+	std::uint64_t lanes[ 4 ];
+	_mm256_storeu_si256( reinterpret_cast<__m256i *>( lanes ), sum );
+	return lanes[ 0 ] + lanes[ 1 ] + lanes[ 2 ] + lanes[ 3 ] + scalar_and_popcount( words1 + i, words2 + i, num_words - i );
+}
+
+/*
+ * Each lane keeps the best score of the candidates it has seen with their index and
+ * position; the lanes' bests are merged and the tail scored as the scalar kernel does.
+ * The scores are the same divisions and subtractions, so they are bit for bit the scalar ones.
+ */
+template <bool Quotient>
+__attribute__(( target( "avx2,fma" ) ))
+std::size_t avx2_mrmr_scores( double const * relevance, double * redundance, double const * mutual_information,
+		std::size_t const * indices, std::size_t length, double num_selected, double * best_score ) {
+	const __m256d divisor = _mm256_set1_pd( num_selected );
+	const __m256d offset = _mm256_set1_pd( 0.0001 );
+	const __m256i step = _mm256_set1_epi64x( 4 );
+	__m256d best = _mm256_set1_pd( -std::numeric_limits<double>::infinity() );
+	__m256i best_index = _mm256_set1_epi64x( -1 );
+	__m256i best_position = _mm256_set1_epi64x( static_cast<long long>( length ) );
+	__m256i position = _mm256_setr_epi64x( 0, 1, 2, 3 );
+	std::size_t i = 0;
+	for( ; i + 4 <= length; i += 4 ) {
+		__m256d total = _mm256_add_pd( _mm256_loadu_pd( redundance + i ), _mm256_loadu_pd( mutual_information + i ) );
+		_mm256_storeu_pd( redundance + i, total );
+		__m256d redundance_value = _mm256_div_pd( total, divisor );
+		__m256d candidate_relevance = _mm256_loadu_pd( relevance + i );
+		__m256d score = Quotient ? _mm256_div_pd( candidate_relevance, _mm256_add_pd( redundance_value, offset ) )
+			: _mm256_sub_pd( candidate_relevance, redundance_value );
+		__m256i index = _mm256_loadu_si256( reinterpret_cast<__m256i const *>( indices + i ) );
+		__m256d tie = _mm256_and_pd( _mm256_cmp_pd( score, best, _CMP_EQ_OQ ), _mm256_castsi256_pd( _mm256_cmpgt_epi64( index, best_index ) ) );
+		__m256d take = _mm256_or_pd( _mm256_cmp_pd( score, best, _CMP_GT_OQ ), tie );
+		best = _mm256_blendv_pd( best, score, take );
+		best_index = _mm256_castpd_si256( _mm256_blendv_pd( _mm256_castsi256_pd( best_index ), _mm256_castsi256_pd( index ), take ) );
+		best_position = _mm256_castpd_si256( _mm256_blendv_pd( _mm256_castsi256_pd( best_position ), _mm256_castsi256_pd( position ), take ) );
+		position = _mm256_add_epi64( position, step );
+	}
+	double scores[ 4 ];
+	std::size_t lane_indices[ 4 ];
+	std::size_t lane_positions[ 4 ];
+	_mm256_storeu_pd( scores, best );
+	_mm256_storeu_si256( reinterpret_cast<__m256i *>( lane_indices ), best_index );
+	_mm256_storeu_si256( reinterpret_cast<__m256i *>( lane_positions ), best_position );
+	best_score_candidate candidate;
+	for( std::size_t lane = 0; lane < 4; ++lane ) {
+		if( lane_positions[ lane ] != length ) {
+			candidate.update( scores[ lane ], lane_positions[ lane ], lane_indices[ lane ] );
+		}
+	}
+	scalar_mrmr_scores<Quotient>( relevance, redundance, mutual_information, indices, i, length, num_selected, candidate );
+	return candidate.result( length, best_score );
+}
+
+std::size_t avx2_best_mrmr_score( double const * relevance, double * redundance, double const * mutual_information,
+		std::size_t const * indices, std::size_t length, double num_selected, bool quotient, double * best_score ) {
+	return quotient ? avx2_mrmr_scores<true>( relevance, redundance, mutual_information, indices, length, num_selected, best_score )
+		: avx2_mrmr_scores<false>( relevance, redundance, mutual_information, indices, length, num_selected, best_score );
+}
+
+const mi_kernels avx2_kernels = {
+	AVX2_KERNEL, "avx2",
+	avx2_joint_counts<std::uint8_t>,
+	avx2_joint_counts<std::uint16_t>,
+	avx2_joint_counts<std::int32_t>,
+	avx2_mutual_information,
+	avx2_entropy,
+	avx2_and_popcount,
+	scalar_nibble_joint_counts,
+	avx2_best_mrmr_score
+};
+
+__attribute__(( target( "avx512f,avx512bw" ) ))
+inline __m512d avx512_log( __m512d x ) {
+	// getexp/getmant split x into floor(log2(x)) and a mantissa in [1, 2)
+	__m512d exponent = _mm512_mask_getexp_pd( x, 0xFF, x );
+	__m512d mantissa = _mm512_mask_getmant_pd( x, 0xFF, x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_zero );
+	__mmask8 large = _mm512_cmp_pd_mask( mantissa, _mm512_set1_pd( sqrt2 ), _CMP_GT_OQ );
+	mantissa = _mm512_mask_mul_pd( mantissa, large, mantissa, _mm512_set1_pd( 0.5 ) );
+	exponent = _mm512_mask_add_pd( exponent, large, exponent, _mm512_set1_pd( 1.0 ) );
+
+	__m512d f = _mm512_sub_pd( mantissa, _mm512_set1_pd( 1.0 ) );
+	__m512d s = _mm512_div_pd( f, _mm512_add_pd( f, _mm512_set1_pd( 2.0 ) ) );
+	__m512d z = _mm512_mul_pd( s, s );
+	__m512d poly = _mm512_set1_pd( log_series[ 0 ] );
+	for( std::size_t i = 1; i < sizeof( log_series ) / sizeof( log_series[ 0 ] ); ++i ) {
+		poly = _mm512_fmadd_pd( poly, z, _mm512_set1_pd( log_series[ i ] ) );
+	}
+	__m512d log_mantissa = _mm512_mul_pd( _mm512_add_pd( s, s ), poly );
+	return _mm512_fmadd_pd( exponent, _mm512_set1_pd( ln2 ), log_mantissa );
+}
+
+__attribute__(( target( "avx512f,avx512bw" ) ))
+double avx512_mutual_information( std::uint32_t const * counts, probability const * probabilities1, std::size_t num_values1,
+		probability const * probabilities2, std::size_t num_values2, double num_instances ) {
+	if( num_instances > std::numeric_limits<std::int32_t>::max() ) {
+		return scalar_mutual_information( counts, probabilities1, num_values1, probabilities2, num_values2, num_instances );
+	}
+
+	__m512d sum = _mm512_setzero_pd();
+	__m512d n = _mm512_set1_pd( num_instances );
+	__m512d one = _mm512_set1_pd( 1.0 );
+	for( std::size_t c1 = 0; c1 < num_values1; ++c1 ) {
+		std::uint32_t const * row = counts + c1 * num_values2;
+		__m512d marginal_probability_i = _mm512_set1_pd( probabilities1[ c1 ] );
+		for( std::size_t c2 = 0; c2 < num_values2; c2 += 8 ) {
+			// the final partial block is handled with masked loads
+			__mmask8 valid = num_values2 - c2 >= 8 ? 0xFF : static_cast<__mmask8>( ( 1u << ( num_values2 - c2 ) ) - 1 );
+			__m512d joint_count = _mm512_cvtepi32_pd( _mm512_castsi512_si256( _mm512_maskz_loadu_epi32( valid, row + c2 ) ) );
+			__mmask8 present = _mm512_cmp_pd_mask( joint_count, _mm512_setzero_pd(), _CMP_NEQ_OQ );
+			__m512d joint_probability = _mm512_div_pd( joint_count, n );
+			__m512d marginal_product = _mm512_mul_pd( marginal_probability_i, _mm512_mask_loadu_pd( one, valid, probabilities2 + c2 ) );
+			__m512d ratio = _mm512_mask_div_pd( one, present, joint_probability, marginal_product );
+			sum = _mm512_mask3_fmadd_pd( joint_probability, avx512_log( ratio ), sum, present );
+		}
+	}
+	return _mm512_reduce_add_pd( sum ) / ln2;
+}
+
+__attribute__(( target( "avx512f,avx512bw" ) ))
+double avx512_entropy( probability const * probabilities, std::size_t num_values ) {
+	__m512d sum = _mm512_setzero_pd();
+	__m512d one = _mm512_set1_pd( 1.0 );
+	for( std::size_t i = 0; i < num_values; i += 8 ) {
+		__mmask8 valid = num_values - i >= 8 ? 0xFF : static_cast<__mmask8>( ( 1u << ( num_values - i ) ) - 1 );
+		__m512d p = _mm512_mask_loadu_pd( one, valid, probabilities + i );
+		sum = _mm512_mask3_fmadd_pd( p, avx512_log( p ), sum, valid );
+	}
+	return -1 * _mm512_reduce_add_pd( sum ) / std::log( 2 );
+}
+
+__attribute__(( target( "avx512f,avx512bw" ) ))
+std::uint64_t avx512_and_popcount( std::uint64_t const * words1, std::uint64_t const * words2, std::size_t num_words ) {
+	const __m512i table = _mm512_set4_epi32( 0x04030302, 0x03020201, 0x03020201, 0x02010100 );
+	const __m512i low_nibbles = _mm512_set1_epi8( 0x0F );
+	__m512i sum = _mm512_setzero_si512();
+	std::size_t i = 0;
+	for( ; i + 8 <= num_words; i += 8 ) {
+		__m512i v = _mm512_and_si512( _mm512_loadu_si512( words1 + i ), _mm512_loadu_si512( words2 + i ) );
+		__m512i bytes = _mm512_add_epi8( _mm512_shuffle_epi8( table, _mm512_and_si512( v, low_nibbles ) ),
+				_mm512_shuffle_epi8( table, _mm512_and_si512( _mm512_srli_epi16( v, 4 ), low_nibbles ) ) );
+		sum = _mm512_add_epi64( sum, _mm512_sad_epu8( bytes, _mm512_setzero_si512() ) );
+	}
+	return static_cast<std::uint64_t>( _mm512_reduce_add_epi64( sum ) ) + scalar_and_popcount( words1 + i, words2 + i, num_words - i );
+}
+
+template <bool Quotient>
+__attribute__(( target( "avx512f,avx512bw" ) ))
+std::size_t avx512_mrmr_scores( double const * relevance, double * redundance, double const * mutual_information,
+		std::size_t const * indices, std::size_t length, double num_selected, double * best_score ) {
+	const __m512d divisor = _mm512_set1_pd( num_selected );
+	const __m512d offset = _mm512_set1_pd( 0.0001 );
+	const __m512i step = _mm512_set1_epi64( 8 );
+	__m512d best = _mm512_set1_pd( -std::numeric_limits<double>::infinity() );
+	__m512i best_index = _mm512_set1_epi64( -1 );
+	__m512i best_position = _mm512_set1_epi64( static_cast<long long>( length ) );
+	__m512i position = _mm512_setr_epi64( 0, 1, 2, 3, 4, 5, 6, 7 );
+	std::size_t i = 0;
+	for( ; i + 8 <= length; i += 8 ) {
+		__m512d total = _mm512_add_pd( _mm512_loadu_pd( redundance + i ), _mm512_loadu_pd( mutual_information + i ) );
+		_mm512_storeu_pd( redundance + i, total );
+		__m512d redundance_value = _mm512_div_pd( total, divisor );
+		__m512d candidate_relevance = _mm512_loadu_pd( relevance + i );
+		__m512d score = Quotient ? _mm512_div_pd( candidate_relevance, _mm512_add_pd( redundance_value, offset ) )
+			: _mm512_sub_pd( candidate_relevance, redundance_value );
+		__m512i index = _mm512_loadu_si512( indices + i );
+		__mmask8 take = _mm512_cmp_pd_mask( score, best, _CMP_GT_OQ )
+			| ( _mm512_cmp_pd_mask( score, best, _CMP_EQ_OQ ) & _mm512_cmpgt_epi64_mask( index, best_index ) );
+		best = _mm512_mask_mov_pd( best, take, score );
+		best_index = _mm512_mask_mov_epi64( best_index, take, index );
+		best_position = _mm512_mask_mov_epi64( best_position, take, position );
+		position = _mm512_add_epi64( position, step );
+	}
+	double scores[ 8 ];
+	std::size_t lane_indices[ 8 ];
+	std::size_t lane_positions[ 8 ];
+	_mm512_storeu_pd( scores, best );
+	_mm512_storeu_si512( lane_indices, best_index );
+	_mm512_storeu_si512( lane_positions, best_position );
+	best_score_candidate candidate;
+	for( std::size_t lane = 0; lane < 8; ++lane ) {
+		if( lane_positions[ lane ] != length ) {
+			candidate.update( scores[ lane ], lane_positions[ lane ], lane_indices[ lane ] );
+		}
+	}
+	scalar_mrmr_scores<Quotient>( relevance, redundance, mutual_information, indices, i, length, num_selected, candidate );
+	return candidate.result( length, best_score );
+}
+
+std::size_t avx512_best_mrmr_score( double const * relevance, double * redundance, double const * mutual_information,
+		std::size_t const * indices, std::size_t length, double num_selected, bool quotient, double * best_score ) {
+	return quotient ? avx512_mrmr_scores<true>( relevance, redundance, mutual_information, indices, length, num_selected, best_score )
+		: avx512_mrmr_scores<false>( relevance, redundance, mutual_information, indices, length, num_selected, best_score );
+}
+
+const mi_kernels avx512_kernels = {
+	AVX512_KERNEL, "avx512",
+	avx512_joint_counts<std::uint8_t>,
+	avx512_joint_counts<std::uint16_t>,
+	avx512_joint_counts<std::int32_t>,
+	avx512_mutual_information,
+	avx512_entropy,
+	avx512_and_popcount,
+	scalar_nibble_joint_counts,
+	avx512_best_mrmr_score
+};
+
+#endif
+
+mi_kernels const * kernels_for( kernel_type type ) {
+	switch( type ) {
+		case SCALAR_KERNEL:
+			return &scalar_kernels;
+#ifdef MRMR_X86_KERNELS
+		case AVX2_KERNEL:
+			return &avx2_kernels;
+		case AVX512_KERNEL:
+			return &avx512_kernels;
+#endif
+		default:
+			return nullptr;
+	}
+}
+
+mi_kernels const * best_kernels() {
+	if( kernels_supported( AVX512_KERNEL ) ) {
+		return kernels_for( AVX512_KERNEL );
+	}
+	if( kernels_supported( AVX2_KERNEL ) ) {
+		return kernels_for( AVX2_KERNEL );
+	}
+	return &scalar_kernels;
+}
+
+mi_kernels const * & active() {
+	static mi_kernels const * kernels = best_kernels();
+	return kernels;
+}
+
+}
+
+bool kernels_supported( kernel_type type ) {
+	switch( type ) {
+		case AUTO_KERNEL:
+		case SCALAR_KERNEL:
+			return true;
+#ifdef MRMR_X86_KERNELS
+		case AVX2_KERNEL:
+			return __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" );
+		case AVX512_KERNEL:
+			return __builtin_cpu_supports( "avx512f" ) && __builtin_cpu_supports( "avx512bw" );
+#endif
+		default:
+			return false;
+	}
+}
+
+mi_kernels const & active_kernels() {
+	return *active();
+}
+
+bool select_kernels( kernel_type type ) {
+	if( ! kernels_supported( type ) ) {
+		return false;
+	}
+	active() = type == AUTO_KERNEL ? best_kernels() : kernels_for( type );
+	return true;
+}
+
+template <typename C1, typename C2>
+void joint_counts( C1 const * codes1, C2 const * codes2, std::size_t length,
+		std::size_t num_values1, std::size_t num_values2, std::uint32_t * counts ) {
+	sub_histogram_joint_counts( codes1, codes2, length, num_values1, num_values2, counts );
+}
+
+template void joint_counts( std::uint8_t const *, std::uint16_t const *, std::size_t, std::size_t, std::size_t, std::uint32_t * );
+template void joint_counts( std::uint8_t const *, std::int32_t const *, std::size_t, std::size_t, std::size_t, std::uint32_t * );
+template void joint_counts( std::uint16_t const *, std::uint8_t const *, std::size_t, std::size_t, std::size_t, std::uint32_t * );
+template void joint_counts( std::uint16_t const *, std::int32_t const *, std::size_t, std::size_t, std::size_t, std::uint32_t * );
+template void joint_counts( std::int32_t const *, std::uint8_t const *, std::size_t, std::size_t, std::size_t, std::uint32_t * );
+template void joint_counts( std::int32_t const *, std::uint16_t const *, std::size_t, std::size_t, std::size_t, std::uint32_t * );
@@ -0,0 +1,102 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MRMR_KERNELS_HPP
+#define MRMR_KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "typedef.hpp"
+
+enum kernel_type : char {
+	AUTO_KERNEL = 0,
+	SCALAR_KERNEL = 1,
+	AVX2_KERNEL = 2,
+	AVX512_KERNEL = 3
+};
+
+/*
+ * Table of the hot loops used to compute entropies and mutual information. One table
+ * exists per instruction set and the active one is chosen at runtime from the features
+ * of the CPU, so a single binary built for generic x86-64 still uses wide vectors.
+ *
+ * joint_counts adds the joint histogram of two code columns to counts, which holds
+ * num_values1 * num_values2 cells laid out row-major by the first column's code.
+ *
+ * The packed kernels work directly on columns bit-packed into 64-bit words.
+ * and_popcount counts the rows set in both of two 1-bit columns. nibble_joint_counts adds
+ * the joint histogram of two 4-bit columns to a 256 cell table indexed by
+ * ( code1 << 4 ) | code2, including any zero padding in the final word.
+ *
+ * best_mrmr_score makes one selection step over length candidates held as parallel arrays:
+ * it adds each candidate's mutual information with the attribute selected last to its
+ * redundancy, scores it as relevance - redundancy / num_selected, or relevance /
+ * ( redundancy / num_selected + 0.0001 ) for the quotient, and returns the position of the
+ * best score with that score in best_score. Ties go to the greatest index, so the choice
+ * does not depend on the order of the candidates; length is returned if no score is a number.
+ */
+struct mi_kernels {
+	kernel_type type;
+	char const * name;
+	void ( *joint_counts_uint8 )( std::uint8_t const * codes1, std::uint8_t const * codes2, std::size_t length,
+			std::size_t num_values1, std::size_t num_values2, std::uint32_t * counts );
+	void ( *joint_counts_uint16 )( std::uint16_t const * codes1, std::uint16_t const * codes2, std::size_t length,
+			std::size_t num_values1, std::size_t num_values2, std::uint32_t * counts );
+	void ( *joint_counts_int32 )( std::int32_t const * codes1, std::int32_t const * codes2, std::size_t length,
+			std::size_t num_values1, std::size_t num_values2, std::uint32_t * counts );
+	double ( *mutual_information )( std::uint32_t const * counts, probability const * probabilities1, std::size_t num_values1,
+			probability const * probabilities2, std::size_t num_values2, double num_instances );
+	double ( *entropy )( probability const * probabilities, std::size_t num_values );
+	std::uint64_t ( *and_popcount )( std::uint64_t const * words1, std::uint64_t const * words2, std::size_t num_words );
+	void ( *nibble_joint_counts )( std::uint64_t const * words1, std::uint64_t const * words2, std::size_t num_words, std::uint32_t * counts );
+	std::size_t ( *best_mrmr_score )( double const * relevance, double * redundance, double const * mutual_information,
+			std::size_t const * indices, std::size_t length, double num_selected, bool quotient, double * best_score );
+};
+
+mi_kernels const & active_kernels();
+bool select_kernels( kernel_type type );
+bool kernels_supported( kernel_type type );
+
+inline void joint_counts( std::uint8_t const * codes1, std::uint8_t const * codes2, std::size_t length,
+		std::size_t num_values1, std::size_t num_values2, std::uint32_t * counts ) {
+	active_kernels().joint_counts_uint8( codes1, codes2, length, num_values1, num_values2, counts );
+}
+
+inline void joint_counts( std::uint16_t const * codes1, std::uint16_t const * codes2, std::size_t length,
+		std::size_t num_values1, std::size_t num_values2, std::uint32_t * counts ) {
+	active_kernels().joint_counts_uint16( codes1, codes2, length, num_values1, num_values2, counts );
+}
+
+inline void joint_counts( std::int32_t const * codes1, std::int32_t const * codes2, std::size_t length,
+		std::size_t num_values1, std::size_t num_values2, std::uint32_t * counts ) {
+	active_kernels().joint_counts_int32( codes1, codes2, length, num_values1, num_values2, counts );
+}
+
+/*
+ * Joint counts of two columns unpacked at different widths, as when a column of at most
+ * 256 values meets one of more. Such pairs have too many cells for the vector kernels'
+ * register histograms, so one sub-histogram loop serves every instruction set and these
+ * are instantiated in kernels.cpp for the six mixed pairs of the widths above.
+ */
+template <typename C1, typename C2>
+void joint_counts( C1 const * codes1, C2 const * codes2, std::size_t length,
+		std::size_t num_values1, std::size_t num_values2, std::uint32_t * counts );
+
+#endif
@@ -19,6 +19,8 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <climits>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 
@@ -26,83 +28,316 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <getopt.h>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <iomanip>
+#include <limits>
+#include <vector>
 
 
+#include "binary_format.hpp"
 #include "dataset.hpp"
+#include "discretizer.hpp"
+#include "kernels.hpp"
+#include "mapped_file.hpp"
 #include "mrmr.hpp"
+#include "shard_channel.hpp"
+#include "sharded_dataset.hpp"
+#include "stats.hpp"
+#include "streaming_dataset.hpp"
 #include "utils.hpp"
 
 void short_usage( char const * program ) {
-	std::cout << "Usage: " << program << " [OPTION]... [FILE]                                     \n";
+	std::cout << "Usage: " << program << " [OPTION]... [FILE]...                                  \n";
 	std::cout << "Try '" << program << " --help' for more information.                            \n";
 }
 
 void usage( char const * program ) {
-	std::cout << "Usage: " << program << " [OPTION]... [FILE]                                     \n";
+	std::cout << "Usage: " << program << " [OPTION]... [FILE]...                                  \n";
 	std::cout << "Compute mRMR values for attributes in data set, either taking input from        \n";
 	std::cout << "standard input or from a file. Input from standard input, named pipes or process\n";
 	std::cout << "substitution requires that the number of instances is specified in advance.     \n";
 	std::cout << "                                                                                \n";
-	std::cout << "  -c, --class=NUM           1-indexed class attribute selection;                \n";
+	std::cout << "  -c, --class=NUM[,NUM]...  1-indexed class attribute selection; several       \n";
+	std::cout << "                            classes are ranked in one run, one table each;      \n";
 	std::cout << "                            defaults to 1 if not provided                       \n";
-	std::cout << "  -d, --discretize=VALUE    one of {round,floor,ceiling};                       \n";
+	std::cout << "  -d, --discretize=VALUE    one of {round,floor,ceiling,equal-width,            \n";
+	std::cout << "                            equal-frequency,mdl}; the last three bin every      \n";
+	std::cout << "                            attribute but the classes, mdl by the first class;  \n";
 	std::cout << "                            defaults to ceiling if not provided                 \n";
+	std::cout << "  -b, --bins=NUM            number of bins of equal width or frequency;         \n";
+	std::cout << "                            defaults to 10                                      \n";
+	std::cout << "  -f, --format=VALUE        one of {table,libsvm}; libsvm reads sparse rows of a\n";
+	std::cout << "                            label and increasing index:value pairs, naming the  \n";
+	std::cout << "                            label class and each index by its number; defaults  \n";
+	std::cout << "                            to table if not provided                            \n";
 	std::cout << "  -n, --number=NUM          max number of attributes to compute                 \n";
 	std::cout << "                            defaults to all attributes                          \n";
 	std::cout << "  -l, --verbosity=VALUE     one of {0,1,2,quiet,info,debug};                    \n";
 	std::cout << "                            defaults to 0=quiet if not provided                 \n";
 	std::cout << "  -m,  --method=VALUE       one of {mid,miq};                                   \n";
 	std::cout << "                            defaults to mid if not provided                     \n";
+	std::cout << "  -e, --evaluation=VALUE    one of {exhaustive,lazy,sampled}; lazy skips        \n";
+	std::cout << "                            candidates whose score bound cannot win, ranking    \n";
+	std::cout << "                            the same; sampled estimates scores on a sample of   \n";
+	std::cout << "                            the rows and computes exactly only those close to   \n";
+	std::cout << "                            the best; defaults to exhaustive if not provided    \n";
+	std::cout << "      --sample-rows=NUM     rows sampled evaluation estimates scores on;        \n";
+	std::cout << "                            defaults to 65536                                   \n";
+	std::cout << "      --tolerance=VALUE     score by which sampled evaluation may miss the best \n";
+	std::cout << "                            candidate rather than compute it; defaults to 0     \n";
+	std::cout << "  -w, --write               write the discretized dataset to standard output    \n";
+	std::cout << "                            and exit                                            \n";
+	std::cout << "  -s, --save-binary=FILE    write the discretized dataset to FILE in binary     \n";
+	std::cout << "                            format and exit; binary files given as input are    \n";
+	std::cout << "                            mapped directly without parsing                     \n";
+	std::cout << "  -k, --kernel=VALUE        one of {auto,scalar,avx2,avx512};                   \n";
+	std::cout << "                            defaults to auto, the fastest the CPU supports      \n";
+	std::cout << "  -t, --threads=NUM         number of threads to use, 0 for all available cores;\n";
+	std::cout << "                            defaults to 1 if not provided                       \n";
+	std::cout << "  -p, --shards=NUM          split each FILE into NUM ranges of rows, each       \n";
+	std::cout << "                            counted by its own worker process; several FILEs    \n";
+	std::cout << "                            with the same header may then be given              \n";
+	std::cout << "  -r, --worker-command=CMD[,CMD]...                                             \n";
+	std::cout << "                            start workers through each CMD in turn, such as     \n";
+	std::cout << "                            'ssh host' to count rows on machines that have      \n";
+	std::cout << "                            this program and each FILE at the same paths        \n";
+	std::cout << "  -o, --out-of-core=BYTES   keep no more than about BYTES of count tables in    \n";
+	std::cout << "                            memory and reread the text of FILE on each pass     \n";
+	std::cout << "                            instead of loading it; K, M and G suffixes allowed  \n";
+	std::cout << "      --serve-shard=FIRST:LAST                                                  \n";
+	std::cout << "                            read the rows of FILE that start at byte offsets    \n";
+	std::cout << "                            in [FIRST, LAST) and serve their counts to a        \n";
+	std::cout << "                            coordinator on standard input and output            \n";
+	std::cout << "      --stats[=FILE]        write timings of each phase, counts of mutual       \n";
+	std::cout << "                            information computed, rows scanned and table cells  \n";
+	std::cout << "                            touched, and peak memory as JSON to FILE, or to     \n";
+	std::cout << "                            standard error if FILE is not given                 \n";
 	std::cout << "  -h, --help     display this help and exit                                     \n";
 	std::cout << "  -v, --version  output version information and exist                           \n";
 }
 
+/*
+ * Ranks the attributes of data against each class attribute and prints one table per
+ * class, separated by blank lines. Returns the exit status of the program.
+ */
+template <typename Data>
+int rank_attributes( Data & data, char const * program, std::vector<std::size_t> class_attributes, int num_attributes,
+		mrmr_method_type method, std::size_t num_threads, mrmr_evaluation_type evaluation, dataset<typename Data::value_type> const * sample = nullptr,
+		double tolerance = 0.0 ) {
+	if( class_attributes.empty() ) {
+		class_attributes.push_back( 0 );
+	}
+	for( auto class_attribute : class_attributes ) {
+		if( class_attribute >= data.num_attributes() ) {
+			std::cerr << program << ":  -c, --class=NUM[,NUM]...  class attribute out of range\n";
+			return 1;
+		}
+	}
+	std::vector<std::vector<mrmr_result>> batch_results;
+	if( class_attributes.size() == 1 ) {
+		batch_results.push_back( mrmr( data, class_attributes[ 0 ], num_attributes, method, num_threads, nullptr, evaluation, sample, tolerance ) );
+	} else {
+		batch_results = mrmr_batch( data, class_attributes, num_attributes, method, num_threads, nullptr, evaluation, sample, tolerance );
+	}
+
+	// print output, one table per class separated by blank lines
+	statistics_phase phase( "output" );
+	std::string cols[] = {
+		"Rank", "Index", "Name", "Entropy", "Mutual Information", "mRMR score"
+	};
+	std::size_t col_widths[] = { 5, 6, 14, 14, 19, 14} ;
+
+	for ( std::size_t i = 0 ; i < data.num_attributes(); i++ ) {
+		if ( data.attribute_name( i ).size()  + 1 > col_widths[2] ) 
+			col_widths[2] = data.attribute_name( i ).size() + 1;
+	}
+
+	for ( std::size_t b = 0; b < batch_results.size(); b++ ) {
+		if ( b > 0 )
+			std::cout << std::endl;
+
+		for ( std::size_t i = 0; i < 6; i++) {
+			std::cout << std::setw(col_widths[i]) << cols[i];
+		}
+		std::cout << std::endl;
+
+		for (auto r : batch_results[b]) {
+			std::cout << std::setw( col_widths[0] ) << r.rank
+					  << std::setw( col_widths[1] ) << r.index 
+					  << std::setw( col_widths[2] ) << r.name 
+					  << std::setw( col_widths[3] ) << r.entropy
+					  << std::setw( col_widths[4] ) << r.mutual_information
+					  << std::setw( col_widths[5] ) << r.score 
+					  << std::endl;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Starts a worker for each of num_shards byte ranges of every file, passing on the options
+ * that change what a worker reads, and returns their channels in file and range order.
+ */
+std::vector<std::unique_ptr<shard_channel> > start_shard_workers( char const * program, std::vector<std::string> const & paths,
+		std::size_t num_shards, std::vector<std::string> const & worker_commands, char const * discretize, std::size_t num_threads ) {
+	// workers run this same program, found by absolute path where one was used to start it
+	std::string program_path = program;
+	char resolved[ PATH_MAX ];
+	if( program_path.find( '/' ) != std::string::npos && realpath( program, resolved ) != nullptr ) {
+		program_path = resolved;
+	}
+
+	std::vector<std::unique_ptr<shard_channel> > shards;
+	for( auto & path : paths ) {
+		std::ifstream file( path, std::ios::binary | std::ios::ate );
+		if( ! file ) {
+			std::cerr << program << ": cannot open " << path << "\n";
+			exit( 1 );
+		}
+		std::size_t size = static_cast<std::size_t>( file.tellg() );
+		std::string file_path = realpath( path.c_str(), resolved ) != nullptr ? std::string( resolved ) : path;
+		for( std::size_t s = 0; s < num_shards; ++s ) {
+			std::vector<std::string> command;
+			if( ! worker_commands.empty() ) {
+				std::istringstream words( worker_commands[ shards.size() % worker_commands.size() ] );
+				std::string word;
+				while( words >> word ) {
+					command.push_back( word );
+				}
+			}
+			command.push_back( program_path );
+			command.push_back( std::string( "--discretize=" ) + discretize );
+			command.push_back( "--threads=" + std::to_string( num_threads ) );
+			command.push_back( "--serve-shard=" + std::to_string( size / num_shards * s + size % num_shards * s / num_shards ) + ":"
+					+ std::to_string( size / num_shards * ( s + 1 ) + size % num_shards * ( s + 1 ) / num_shards ) );
+			command.push_back( file_path );
+			shards.emplace_back( shard_channel::spawn( command ) );
+		}
+	}
+	return shards;
+}
+
+/* Writes the statistics of the run as JSON once main returns, to a file or standard error. */
+class statistics_report {
+	public:
+		statistics_report( bool enabled, std::string const & path ) : _enabled( enabled ), _path( path ) {
+		}
+
+		~statistics_report() {
+			if( ! _enabled ) {
+				return;
+			}
+			if( _path.empty() ) {
+				statistics::get()->write_json( std::cerr );
+				return;
+			}
+			std::ofstream ofs( _path );
+			statistics::get()->write_json( ofs );
+			if( ! ofs ) {
+				std::cerr << "error: cannot write statistics to " << _path << "\n";
+			}
+		}
+
+	private:
+		bool _enabled;
+		std::string _path;
+};
+
 int main( int argc, char* argv[] ) {
+	statistics::get()->reset();
+
 	std::cout << std::scientific;
 	std::cerr << std::scientific;
 
-	logger log = *logger::get();
+	logger & log = *logger::get();
 
-	using storage_type = unsigned char;
+	using storage_type = std::int32_t;
 	using dataset_type = dataset<storage_type>;
 
 	std::ifstream ifs;
-	std::size_t class_attribute = 0;
+	std::vector<std::size_t> class_attributes;
 
 	dataset_type::discretization_method discretize = dataset_type::ROUND;
+	char const * discretize_name = "round";
+	binning_options binning;
+	bool libsvm_input = false;
 	mrmr_method_type method = mrmr_method_type::MID;
+	mrmr_evaluation_type evaluation = mrmr_evaluation_type::EXHAUSTIVE;
 
 	bool just_write = false;
+	std::string binary_path;
+	std::string input_path;
+	std::vector<std::string> input_paths;
+
+	std::size_t num_shards = 0;
+	std::vector<std::string> worker_commands;
+	bool serve_shard_range = false;
+	std::size_t shard_first = 0;
+	std::size_t shard_last = 0;
 
 	int num_attributes = 0;
 
+	std::size_t num_threads = 1;
+
+	std::size_t out_of_core_budget = 0;
+
+	std::size_t sample_rows = 1 << 16;
+	double tolerance = 0.0;
+
+	bool write_statistics = false;
+	std::string statistics_path;
+
 	int c;
 	int option_index = 0;
 	while( true ) {
 		static struct option long_options[] = {
 				{ "class", required_argument, 0, 'c' },
 				{ "discretize", required_argument, 0, 'd' },
+				{ "bins", required_argument, 0, 'b' },
+				{ "format", required_argument, 0, 'f' },
 				{ "verbosity", required_argument, 0, 'l' },
 				{ "write", no_argument, 0, 'w' },
+				{ "save-binary", required_argument, 0, 's' },
 				{ "number", required_argument, 0, 'n'},
 				{ "method", required_argument, 0, 'm'},
+				{ "evaluation", required_argument, 0, 'e'},
+				{ "sample-rows", required_argument, 0, 'R'},
+				{ "tolerance", required_argument, 0, 'T'},
+				{ "threads", required_argument, 0, 't'},
+				{ "kernel", required_argument, 0, 'k'},
+				{ "shards", required_argument, 0, 'p'},
+				{ "worker-command", required_argument, 0, 'r'},
+				{ "out-of-core", required_argument, 0, 'o'},
+				{ "serve-shard", required_argument, 0, 'S'},
+				{ "stats", optional_argument, 0, 'J'},
 				{ "help", no_argument, 0, 'h' },
 				{ "version", no_argument, 0, 'v' }
 				};
-		c = getopt_long( argc, argv, "c:d:l:n:m:whv", long_options, &option_index );
+		c = getopt_long( argc, argv, "c:d:b:f:l:n:m:e:t:k:p:r:o:s:whv", long_options, &option_index );
 		if( c == -1 ) {
 			break;
 		}
 		switch( c ) {
 			case 'c':
-				class_attribute = std::strtoul( optarg, nullptr, 10 );
-				if( class_attribute == 0 || errno == ERANGE ) {
-					std::cerr << argv[0] << ":  -c, --class=NUM  class attribute out of range\n";
-					return 1;
+				{
+					char const * p = optarg;
+					while( true ) {
+						char * end;
+						errno = 0;
+						std::size_t class_attribute = std::strtoul( p, &end, 10 );
+						if( class_attribute == 0 || errno == ERANGE || ( *end != ',' && *end != '\0' ) ) {
+							std::cerr << argv[0] << ":  -c, --class=NUM[,NUM]...  class attribute out of range\n";
+							return 1;
+						}
+						class_attributes.push_back( class_attribute - 1 );
+						if( *end == '\0' ) {
+							break;
+						}
+						p = end + 1;
+					}
 				}
-				--class_attribute;
 				break;
 
 			case 'd':
@@ -112,8 +347,38 @@ int main( int argc, char* argv[] ) {
 					discretize = dataset_type::FLOOR;
 				} else if( strcmp( optarg, "ceiling" ) == 0 ) {
 					discretize = dataset_type::CEILING;
+				} else if( strcmp( optarg, "equal-width" ) == 0 ) {
+					binning.method = binning_method::EQUAL_WIDTH;
+				} else if( strcmp( optarg, "equal-frequency" ) == 0 ) {
+					binning.method = binning_method::EQUAL_FREQUENCY;
+				} else if( strcmp( optarg, "mdl" ) == 0 ) {
+					binning.method = binning_method::MDL;
+				} else {
+					std::cerr << argv[0] << ": -d --discretize=VALUE  must be one of one of {round,floor,ceiling,equal-width,equal-frequency,mdl}\n";
+					return 1;
+				}
+				discretize_name = optarg;
+				break;
+
+			case 'b':
+				{
+					char * end;
+					errno = 0;
+					binning.num_bins = std::strtoul( optarg, &end, 10 );
+					if( *optarg == '\0' || *end != '\0' || errno == ERANGE || binning.num_bins == 0 ) {
+						std::cerr << argv[0] << ": " << "-b, --bins=NUM  number of bins must be a positive integer\n";
+						return 1;
+					}
+				}
+				break;
+
+			case 'f':
+				if( strcmp( optarg, "table" ) == 0 ) {
+					libsvm_input = false;
+				} else if( strcmp( optarg, "libsvm" ) == 0 ) {
+					libsvm_input = true;
 				} else {
-					std::cerr << argv[0] << ": -d --discretize=VALUE  must be one of one of {round,floor,ceiling}\n";
+					std::cerr << argv[0] << ": -f, --format=VALUE  must be one of {table,libsvm}\n";
 					return 1;
 				}
 				break;
@@ -136,10 +401,112 @@ int main( int argc, char* argv[] ) {
 				num_attributes = std::strtol( optarg, nullptr, 10 );
 				break;
 
+			case 't':
+				{
+					char * end;
+					errno = 0;
+					num_threads = std::strtoul( optarg, &end, 10 );
+					if( *optarg == '\0' || *end != '\0' || errno == ERANGE ) {
+						std::cerr << argv[0] << ": " << "-t, --threads=NUM  number of threads must be a non-negative integer\n";
+						return 1;
+					}
+				}
+				break;
+
+			case 'k':
+				{
+					kernel_type kernel;
+					if( strcmp( optarg, "auto" ) == 0 ) {
+						kernel = AUTO_KERNEL;
+					} else if( strcmp( optarg, "scalar" ) == 0 ) {
+						kernel = SCALAR_KERNEL;
+					} else if( strcmp( optarg, "avx2" ) == 0 ) {
+						kernel = AVX2_KERNEL;
+					} else if( strcmp( optarg, "avx512" ) == 0 ) {
+						kernel = AVX512_KERNEL;
+					} else {
+						std::cerr << argv[0] << ": " << "-k, --kernel=VALUE  one of {auto,scalar,avx2,avx512}\n";
+						return 1;
+					}
+					if( ! select_kernels( kernel ) ) {
+						std::cerr << argv[0] << ": " << "-k, --kernel=VALUE  " << optarg << " kernels are not supported by this CPU\n";
+						return 1;
+					}
+				}
+				break;
+
+			case 'p':
+				{
+					char * end;
+					errno = 0;
+					num_shards = std::strtoul( optarg, &end, 10 );
+					if( *optarg == '\0' || *end != '\0' || errno == ERANGE || num_shards == 0 ) {
+						std::cerr << argv[0] << ": " << "-p, --shards=NUM  number of shards must be a positive integer\n";
+						return 1;
+					}
+				}
+				break;
+
+			case 'r':
+				{
+					std::istringstream commands( optarg );
+					std::string command;
+					while( std::getline( commands, command, ',' ) ) {
+						worker_commands.push_back( command );
+					}
+				}
+				break;
+
+			case 'o':
+				{
+					char * end;
+					errno = 0;
+					out_of_core_budget = std::strtoull( optarg, &end, 10 );
+					std::size_t scale = 1;
+					if( *end == 'K' || *end == 'k' ) {
+						scale = std::size_t( 1 ) << 10;
+					} else if( *end == 'M' || *end == 'm' ) {
+						scale = std::size_t( 1 ) << 20;
+					} else if( *end == 'G' || *end == 'g' ) {
+						scale = std::size_t( 1 ) << 30;
+					}
+					if( scale > 1 ) {
+						++end;
+					}
+					if( *optarg == '\0' || *end != '\0' || errno == ERANGE || out_of_core_budget == 0
+							|| out_of_core_budget > std::numeric_limits<std::size_t>::max() / scale ) {
+						std::cerr << argv[0] << ": " << "-o, --out-of-core=BYTES  memory budget must be a positive number of bytes\n";
+						return 1;
+					}
+					out_of_core_budget *= scale;
+				}
+				break;
+
+			case 'S':
+				{
+					char * end;
+					errno = 0;
+					shard_first = std::strtoull( optarg, &end, 10 );
+					if( *end == ':' ) {
+						char const * last = end + 1;
+						shard_last = std::strtoull( last, &end, 10 );
+						serve_shard_range = *last != '\0' && *end == '\0' && errno != ERANGE && shard_first <= shard_last;
+					}
+					if( ! serve_shard_range ) {
+						std::cerr << argv[0] << ": " << "--serve-shard=FIRST:LAST  byte offsets with FIRST no greater than LAST\n";
+						return 1;
+					}
+				}
+				break;
+
 			case 'w':
 				just_write = true;
 				break;
 
+			case 's':
+				binary_path = optarg;
+				break;
+
 			case 'h':
 				usage( argv[0] );
 				return 0;
@@ -155,6 +522,48 @@ int main( int argc, char* argv[] ) {
 				}
 				break;
 
+			case 'e':
+				if( strcmp( optarg, "exhaustive" ) == 0 ) {
+					evaluation = mrmr_evaluation_type::EXHAUSTIVE;
+				} else if( strcmp( optarg, "lazy" ) == 0 ) {
+					evaluation = mrmr_evaluation_type::LAZY;
+				} else if( strcmp( optarg, "sampled" ) == 0 ) {
+					evaluation = mrmr_evaluation_type::SAMPLED;
+				} else {
+					std::cerr << argv[0] << ": " << "-e, --evaluation=VALUE  one of {exhaustive,lazy,sampled}; defaults to exhaustive" << std::endl;
+					return 1;
+				}
+				break;
+
+			case 'R':
+				{
+					char * end;
+					errno = 0;
+					sample_rows = std::strtoull( optarg, &end, 10 );
+					if( *optarg == '\0' || *end != '\0' || errno == ERANGE || sample_rows == 0 ) {
+						std::cerr << argv[0] << ": " << "--sample-rows=NUM  number of rows must be a positive integer\n";
+						return 1;
+					}
+				}
+				break;
+
+			case 'T':
+				{
+					char * end;
+					errno = 0;
+					tolerance = std::strtod( optarg, &end );
+					if( *optarg == '\0' || *end != '\0' || errno == ERANGE || ! ( tolerance >= 0 ) ) {
+						std::cerr << argv[0] << ": " << "--tolerance=VALUE  tolerance must be a number no less than 0\n";
+						return 1;
+					}
+				}
+				break;
+
+			case 'J':
+				write_statistics = true;
+				statistics_path = optarg == nullptr ? "" : optarg;
+				break;
+
 			case 'v':
 				std::cout << "mrmr by Ryan N. Lichtenwalter, Michael Diponio v0.2 (BETA)\n";
 				return 0;
@@ -166,8 +575,9 @@ int main( int argc, char* argv[] ) {
 	}
 
 	if( optind < argc ) {
-		if( optind == argc - 1 ) {
-			ifs = std::ifstream( argv[optind] );
+		if( optind == argc - 1 || num_shards > 0 ) {
+			input_path = argv[optind];
+			input_paths.assign( argv + optind, argv + argc );
 			log.message( (std::string( "FILE = " ) + std::string( argv[optind] )).c_str(), DEBUG, STANDARD );
 		} else {
 			std::cerr << argv[0] << ": " << "too many arguments\n";
@@ -175,53 +585,133 @@ int main( int argc, char* argv[] ) {
 			return 1;
 		}
 	}
+	statistics_report report( write_statistics && ! serve_shard_range, statistics_path );
+
+	// class attributes keep their values, and the first is the class supervised binning splits by
+	binning.class_attributes = class_attributes.empty() ? std::vector<std::size_t>( 1, 0 ) : class_attributes;
+
+	// sparse rows are only read whole, into memory
+	if( libsvm_input && ( binning.method != binning_method::NONE || out_of_core_budget > 0 || num_shards > 0 || serve_shard_range ) ) {
+		std::cerr << argv[0] << ": " << "-f, --format=libsvm  cannot be used with binning, -o or -p\n";
+		return 1;
+	}
+
+	if( serve_shard_range ) {
+		// counts go to the coordinator on standard output, so nothing else may be written there
+		mapped_file shard_file;
+		if( input_path.empty() || ! shard_file.open( input_path ) || binary_format::has_magic( shard_file.data(), shard_file.size() ) ) {
+			std::cerr << argv[0] << ": " << "--serve-shard=FIRST:LAST  FILE must be a text file that can be mapped\n";
+			return 1;
+		}
+		dataset_type data( shard_file.data(), shard_file.data() + shard_file.size(), shard_first, shard_last, discretize, num_threads );
+		shard_channel channel( 0, 1 );
+		serve_shard( data, channel, num_threads );
+		return 0;
+	}
+
+	// binary files are mapped and paged in on demand, so only text is streamed
+	if( out_of_core_budget > 0 && ( input_path.empty() || ! dataset_type::is_binary( input_path ) ) ) {
+		if( input_path.empty() || just_write || ! binary_path.empty() || num_shards > 0 || evaluation != mrmr_evaluation_type::EXHAUSTIVE ) {
+			std::cerr << argv[0] << ": " << "-o, --out-of-core=BYTES  needs a FILE and cannot be used with -w, -s, -p or lazy or sampled evaluation\n";
+			return 1;
+		}
+		log.message( "Computing attribute information in a pass over the file...", INFO, START );
+		statistics::get()->begin_phase( "attribute_information" );
+		streaming_dataset<storage_type> data( input_path, discretize, num_threads, out_of_core_budget, streaming_dataset<storage_type>::default_block_bytes,
+				binning );
+		statistics::get()->end_phase();
+		log.message( "DONE", INFO, FINISH );
+
+		// the dataset counts on every thread, so the selector makes one request per round
+		return rank_attributes( data, argv[0], class_attributes, num_attributes, method, 1, evaluation );
+	}
+
+	if( num_shards > 0 ) {
+		// each worker would fit bins to its own rows alone
+		if( input_paths.empty() || just_write || ! binary_path.empty() || evaluation == mrmr_evaluation_type::SAMPLED
+				|| binning.method != binning_method::NONE ) {
+			std::cerr << argv[0] << ": " << "-p, --shards=NUM  needs at least one FILE and cannot be used with -w, -s, binning or sampled evaluation\n";
+			return 1;
+		}
+		log.message( "Starting shard workers and merging attribute information...", INFO, START );
+		statistics::get()->begin_phase( "attribute_information" );
+		sharded_dataset<storage_type> data( start_shard_workers( argv[0], input_paths, num_shards, worker_commands, discretize_name, num_threads ) );
+		statistics::get()->end_phase();
+		log.message( "DONE", INFO, FINISH );
+		return rank_attributes( data, argv[0], class_attributes, num_attributes, method, num_threads, evaluation );
+	}
 
 	// read data
 	log.message( "Reading and transforming dataset and computing attribute information...", INFO, START ); 
+	statistics::get()->begin_phase( "read" );
 
 	dataset_type data;
-	if( ifs.is_open() ) {
-		log.message( "Reading from file...", DEBUG, STANDARD );
-		data = dataset_type( ifs, discretize );
+	mapped_file input_file;
+	if( ! input_path.empty() && input_file.open( input_path ) ) {
+		if( binary_format::has_magic( input_file.data(), input_file.size() ) ) {
+			log.message( "Mapping binary dataset...", DEBUG, STANDARD );
+			data = dataset_type::open_binary( input_path );
+		} else if( libsvm_input ) {
+			log.message( "Reading sparse rows from mapped file...", DEBUG, STANDARD );
+			data = dataset_type::from_libsvm( input_file.data(), input_file.data() + input_file.size(), discretize, num_threads );
+		} else {
+			log.message( "Reading from mapped file...", DEBUG, STANDARD );
+			data = dataset_type( input_file.data(), input_file.data() + input_file.size(), discretize, num_threads, binning );
+		}
+		input_file.close();
 	} else {
-		log.message( "Reading from standard input...", DEBUG, STANDARD );
-		data = dataset_type( std::cin, discretize );
+		// named pipes and process substitution cannot be mapped and are read as streams
+		if( ! input_path.empty() ) {
+			ifs.open( input_path );
+		}
+		if( libsvm_input ) {
+			log.message( "Reading sparse rows from stream...", DEBUG, STANDARD );
+			std::vector<char> text = read_stream( ifs.is_open() ? ifs : std::cin );
+			data = dataset_type::from_libsvm( text.data(), text.data() + text.size(), discretize, num_threads );
+		} else if( ifs.is_open() ) {
+			log.message( "Reading from file...", DEBUG, STANDARD );
+			data = dataset_type( ifs, discretize, num_threads, binning );
+		} else {
+			log.message( "Reading from standard input...", DEBUG, STANDARD );
+			data = dataset_type( std::cin, discretize, num_threads, binning );
+		}
 	}
+	statistics::get()->end_phase();
 	log.message( "DONE", INFO, FINISH );
+	log.message( ( std::string( "KERNEL = " ) + active_kernels().name ).c_str(), DEBUG, STANDARD );
 
 	if( just_write ) {
 		log.message( "Writing dataset out standard output...", INFO, START );
+		statistics_phase phase( "write" );
 		std::cout << data;
 		log.message( "DONE", INFO, FINISH );
 		return 0;
 	}
 
-	// perform MRMR
-	std::vector<mrmr_result> results = mrmr<unsigned char>( data, class_attribute, num_attributes, method );
-
-	// print output
-	std::string cols[] = {
-		"Rank", "Index", "Name", "Entropy", "Mutual Information", "mRMR score"
-	};
-	std::size_t col_widths[] = { 5, 6, 14, 14, 19, 14} ;
-
-	for ( std::size_t i = 0 ; i < data.num_attributes(); i++ ) {
-		if ( data.attribute_name( i ).size()  + 1 > col_widths[2] ) 
-			col_widths[2] = data.attribute_name( i ).size() + 1;
-	}
-
-	for ( std::size_t i = 0; i < 6; i++) {
-		std::cout << std::setw(col_widths[i]) << cols[i];
+	if( ! binary_path.empty() ) {
+		log.message( "Writing binary dataset...", INFO, START );
+		statistics_phase phase( "write" );
+		std::ofstream ofs( binary_path, std::ios::binary );
+		data.save_binary( ofs );
+		ofs.close();
+		if( ! ofs ) {
+			std::cerr << argv[0] << ": " << "-s, --save-binary=FILE  cannot write " << binary_path << "\n";
+			return 1;
+		}
+		log.message( "DONE", INFO, FINISH );
+		return 0;
 	}
-	std::cout << std::endl;
 
-	for (auto r : results) {
-		std::cout << std::setw( col_widths[0] ) << r.rank
-				  << std::setw( col_widths[1] ) << r.index 
-				  << std::setw( col_widths[2] ) << r.name 
-				  << std::setw( col_widths[3] ) << r.entropy
-				  << std::setw( col_widths[4] ) << r.mutual_information
-				  << std::setw( col_widths[5] ) << r.score 
-				  << std::endl;
+	// perform MRMR, estimating on a sample of the rows when asked
+	dataset_type sample;
+	if( evaluation == mrmr_evaluation_type::SAMPLED && sample_rows >= data.num_instances() ) {
+		evaluation = mrmr_evaluation_type::LAZY;
+	} else if( evaluation == mrmr_evaluation_type::SAMPLED ) {
+		log.message( "Sampling rows...", INFO, START );
+		statistics::get()->begin_phase( "sample" );
+		sample = data.sample_rows( sample_rows, 0, num_threads );
+		statistics::get()->end_phase();
+		log.message( "DONE", INFO, FINISH );
 	}
+	return rank_attributes( data, argv[0], class_attributes, num_attributes, method, num_threads, evaluation, &sample, tolerance );
 }
@@ -0,0 +1,143 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+mapped_file::mapped_file() : _data( nullptr ), _size( 0 ), _open( false ), _file( INVALID_HANDLE_VALUE ), _mapping( nullptr ) {
+}
+#else
+mapped_file::mapped_file() : _data( nullptr ), _size( 0 ), _open( false ) {
+}
+#endif
+
+mapped_file::~mapped_file() {
+	close();
+}
+
+bool mapped_file::is_open() const {
+	return _open;
+}
+
+char const * mapped_file::data() const {
+	return _data;
+}
+
+std::size_t mapped_file::size() const {
+	return _size;
+}
+
+#ifdef _WIN32
+
+bool mapped_file::open( std::string const & path ) {
+	close();
+	_file = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if( _file == INVALID_HANDLE_VALUE || GetFileType( _file ) != FILE_TYPE_DISK ) {
+		close();
+		return false;
+	}
+	LARGE_INTEGER size;
+	if( ! GetFileSizeEx( _file, &size ) ) {
+		close();
+		return false;
+	}
+	_size = static_cast<std::size_t>( size.QuadPart );
+	_open = true;
+	if( _size == 0 ) {
+		return true;
+	}
+	_mapping = CreateFileMappingA( _file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if( _mapping == nullptr ) {
+		close();
+		return false;
+	}
+	_data = static_cast<char const *>( MapViewOfFile( _mapping, FILE_MAP_READ, 0, 0, 0 ) );
+	if( _data == nullptr ) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void mapped_file::close() {
+	if( _data != nullptr ) {
+		UnmapViewOfFile( _data );
+	}
+	if( _mapping != nullptr ) {
+		CloseHandle( _mapping );
+	}
+	if( _file != INVALID_HANDLE_VALUE ) {
+		CloseHandle( _file );
+	}
+	_data = nullptr;
+	_size = 0;
+	_open = false;
+	_file = INVALID_HANDLE_VALUE;
+	_mapping = nullptr;
+}
+
+#else
+
+bool mapped_file::open( std::string const & path ) {
+	close();
+	int fd = ::open( path.c_str(), O_RDONLY );
+	if( fd < 0 ) {
+		return false;
+	}
+	struct stat status;
+	if( fstat( fd, &status ) != 0 || ! S_ISREG( status.st_mode ) ) {
+		::close( fd );
+		return false;
+	}
+	_size = static_cast<std::size_t>( status.st_size );
+	if( _size > 0 ) {
+		void * address = mmap( nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0 );
+		if( address == MAP_FAILED ) {
+			::close( fd );
+			_size = 0;
+			return false;
+		}
+		_data = static_cast<char const *>( address );
+	}
+	// the mapping stays valid once the descriptor is closed
+	::close( fd );
+	_open = true;
+	return true;
+}
+
+void mapped_file::close() {
+	if( _data != nullptr ) {
+		munmap( const_cast<char *>( _data ), _size );
+	}
+	_data = nullptr;
+	_size = 0;
+	_open = false;
+}
+
+#endif
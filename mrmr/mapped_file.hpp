@@ -0,0 +1,54 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MRMR_MAPPED_FILE_HPP
+#define MRMR_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+/*
+ * Read-only memory mapping of a whole regular file. Opening fails for anything that
+ * cannot be mapped, such as pipes and terminals, so callers can fall back to streams.
+ */
+class mapped_file {
+	public:
+		mapped_file();
+		mapped_file( mapped_file const & ) = delete;
+		mapped_file & operator=( mapped_file const & ) = delete;
+		~mapped_file();
+
+		bool open( std::string const & path );
+		void close();
+		bool is_open() const;
+		char const * data() const;
+		std::size_t size() const;
+
+	private:
+		char const * _data;
+		std::size_t _size;
+		bool _open;
+#ifdef _WIN32
+		void * _file;
+		void * _mapping;
+#endif
+};
+
+#endif
@@ -26,6 +26,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include <iterator>
 #include <valarray>
+#include <vector>
+#include "text_parser.hpp"
 
 template <typename T>
 class matrix {
@@ -37,6 +39,7 @@ class matrix {
 		matrix();
 		matrix( std::size_t num_rows, std::size_t num_columns );
 		matrix( std::size_t num_rows, std::size_t num_columns, T const & value );
+		matrix( std::size_t num_rows, std::size_t num_columns, std::valarray<T> && data );
 		std::size_t num_rows() const;
 		std::size_t num_columns() const;
 		
@@ -66,6 +69,10 @@ template <typename T>
 matrix<T>::matrix( std::size_t num_rows, std::size_t num_columns, T const & value ) : _num_rows(num_rows), _num_columns(num_columns), _data( std::valarray<T>( num_rows * num_columns ) ) {
 }
 
+template <typename T>
+matrix<T>::matrix( std::size_t num_rows, std::size_t num_columns, std::valarray<T> && data ) : _num_rows(num_rows), _num_columns(num_columns), _data( std::move( data ) ) {
+}
+
 template <typename T>
 std::size_t matrix<T>::num_rows() const {
 	return _num_rows;
@@ -96,7 +103,7 @@ void matrix<T>::add_column( std::valarray<T>& column_data ) {
 
 template <typename T>
 void matrix<T>::set_column( std::size_t column, std::valarray<T>& column_data ) {
-	std::copy( std::cend( column_data ), std::cend( column_data ), std::begin( _data ) + column * _num_columns );
+	std::copy( std::cbegin( column_data ), std::cend( column_data ), std::begin( _data ) + column * _num_columns );
 }
 
 template <typename T>
@@ -153,54 +160,11 @@ std::ostream & operator<<( std::ostream & os, matrix<T> const & m ) {
 
 template <typename T>
 std::istream & operator>>( std::istream & is, matrix<T> & m ) {
-	m._num_rows = 0;
-	m._num_columns = 0;
-	if( m._data.size() == 0 ) {
-		m._data.resize( 256 );
-	}
-	std::size_t column_num = 0;
-	while( !is.eof() ) {
-		T d;
-		is >> d;
-		if( column_num == 0 ) {
-			++m._num_rows;
-		}
-		if( m.num_rows() == 1 ) {
-			m._num_columns = column_num + 1;
-		}
-		if( (m.num_rows() - 1) * m.num_columns() + column_num >= m._data.size() ) {
-			std::valarray<T> temp;
-			if( m.num_rows() == 1 ) {
-				temp.resize( 2 * m._data.size() );
-			} else {
-				temp.resize( 2 * m.num_rows() * m.num_columns() );
-			}
-			std::copy( std::cbegin( m._data ), std::cend( m._data ), std::begin( temp ) );
-			m._data = std::move( temp );
-		}
-		m( m.num_rows() - 1, column_num ) = d;
-		char c = is.get();
-		if( c == '\t' ) {
-			++column_num;
-		} else if( c == '\n' ) {
-			if( column_num + 1 == m.num_columns() ) {
-				column_num = 0;
-			} else {
-				std::cerr << "error: inconsistent number of columns at matrix row " << m.num_rows() << "\n";
-				exit( 2 );
-			}
-		} else {
-			std::cerr << "error: invalid value '" << d << c << "' at line " << m.num_rows() << "\n";
-			exit( 2 );
-		}
-		is.peek();
-	}
-	if( m.num_rows() * m.num_columns() < m._data.size() ) {
-		std::valarray<T> temp;
-		temp.resize( m.num_rows() * m.num_columns() );
-		std::copy( std::cbegin( m._data ), std::cbegin( m._data ) + m.num_rows() * m.num_columns(), std::begin( temp ) );
-		m._data = std::move( temp );
-	}
+	std::vector<char> text = read_stream( is );
+	std::valarray<double> values;
+	parse_table( text.data(), text.data() + text.size(), 1, m._num_rows, m._num_columns, values );
+	m._data.resize( values.size() );
+	std::copy( std::begin( values ), std::end( values ), std::begin( m._data ) );
 	return is;
 }
 
@@ -0,0 +1,109 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mi_cache.hpp"
+
+mi_cache::mi_cache( std::size_t max_bytes ) : _max_bytes( max_bytes ), _hits( 0 ), _misses( 0 ) {
+}
+
+std::uint64_t mi_cache::key( std::size_t anchor, std::size_t candidate ) {
+	return ( static_cast<std::uint64_t>( anchor ) << 32 ) | static_cast<std::uint64_t>( candidate );
+}
+
+void mi_cache::find_many( std::size_t anchor, std::size_t const * candidates, std::size_t num_candidates, double * out,
+		std::vector<std::size_t> & missing ) {
+	std::lock_guard<std::mutex> lock( _mutex );
+	for( std::size_t i = 0; i < num_candidates; ++i ) {
+		auto it = _index.find( key( anchor, candidates[ i ] ) );
+		if( it == _index.end() ) {
+			missing.push_back( i );
+			++_misses;
+		} else {
+			// move to the front of the recency list
+			_entries.splice( _entries.begin(), _entries, it->second );
+			out[ i ] = it->second->value;
+			++_hits;
+		}
+	}
+}
+
+void mi_cache::insert_many( std::size_t anchor, std::size_t const * candidates, std::size_t num_candidates, double const * values ) {
+	std::lock_guard<std::mutex> lock( _mutex );
+	if( _max_bytes < entry_bytes ) {
+		return;
+	}
+	for( std::size_t i = 0; i < num_candidates; ++i ) {
+		std::uint64_t k = key( anchor, candidates[ i ] );
+		auto it = _index.find( k );
+		if( it != _index.end() ) {
+			// another thread computed the same pair
+			it->second->value = values[ i ];
+			_entries.splice( _entries.begin(), _entries, it->second );
+			continue;
+		}
+		_entries.push_front( entry{ k, values[ i ] } );
+		_index.emplace( k, _entries.begin() );
+	}
+	evict();
+}
+
+void mi_cache::evict() {
+	while( _entries.size() * entry_bytes > _max_bytes ) {
+		_index.erase( _entries.back().key );
+		_entries.pop_back();
+	}
+}
+
+void mi_cache::clear() {
+	std::lock_guard<std::mutex> lock( _mutex );
+	_entries.clear();
+	_index.clear();
+}
+
+std::size_t mi_cache::max_bytes() const {
+	std::lock_guard<std::mutex> lock( _mutex );
+	return _max_bytes;
+}
+
+void mi_cache::set_max_bytes( std::size_t bytes ) {
+	std::lock_guard<std::mutex> lock( _mutex );
+	_max_bytes = bytes;
+	evict();
+}
+
+std::size_t mi_cache::size() const {
+	std::lock_guard<std::mutex> lock( _mutex );
+	return _entries.size();
+}
+
+std::size_t mi_cache::memory_usage() const {
+	std::lock_guard<std::mutex> lock( _mutex );
+	return _entries.size() * entry_bytes;
+}
+
+std::uint64_t mi_cache::hits() const {
+	std::lock_guard<std::mutex> lock( _mutex );
+	return _hits;
+}
+
+std::uint64_t mi_cache::misses() const {
+	std::lock_guard<std::mutex> lock( _mutex );
+	return _misses;
+}
@@ -0,0 +1,83 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MRMR_MI_CACHE_HPP
+#define MRMR_MI_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Bounded cache of mutual information between pairs of attributes, shared by successive
+ * mRMR runs over the same dataset. Entries are keyed by the ordered pair ( anchor,
+ * candidate ) as passed to dataset::mutual_information_many, since the sum taken over
+ * the transposed table can differ in the last bit and cached runs must rank exactly as
+ * uncached ones. The least recently used entries are evicted once the estimated memory
+ * use would exceed the limit. All members may be called from several threads at once.
+ */
+class mi_cache {
+	public:
+		explicit mi_cache( std::size_t max_bytes = default_max_bytes );
+		mi_cache( mi_cache const & ) = delete;
+		mi_cache & operator=( mi_cache const & ) = delete;
+
+		/*
+		 * Looks up the candidates paired with anchor, storing cached values in out and
+		 * appending the positions of the others to missing.
+		 */
+		void find_many( std::size_t anchor, std::size_t const * candidates, std::size_t num_candidates, double * out,
+				std::vector<std::size_t> & missing );
+		void insert_many( std::size_t anchor, std::size_t const * candidates, std::size_t num_candidates, double const * values );
+		void clear();
+
+		std::size_t max_bytes() const;
+		void set_max_bytes( std::size_t bytes );
+		std::size_t size() const;
+		std::size_t memory_usage() const;
+		std::uint64_t hits() const;
+		std::uint64_t misses() const;
+
+		static const std::size_t default_max_bytes = std::size_t( 64 ) << 20;
+
+		/* Estimated bytes per entry, covering the value, its list node and its hash node. */
+		static const std::size_t entry_bytes = 96;
+
+	private:
+		struct entry {
+			std::uint64_t key;
+			double value;
+		};
+
+		static std::uint64_t key( std::size_t anchor, std::size_t candidate );
+		void evict();
+
+		mutable std::mutex _mutex;
+		std::size_t _max_bytes;
+		std::list<entry> _entries;
+		std::unordered_map<std::uint64_t, std::list<entry>::iterator> _index;
+		std::uint64_t _hits;
+		std::uint64_t _misses;
+};
+
+#endif
@@ -22,14 +22,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MRMR_HPP
 #define MRMR_HPP
 
+#include <algorithm>
 #include <cmath>
-#include <forward_list>
 #include <vector>
 #include <limits>
 #include <string>
 #include <vector>
 
 #include "dataset.hpp"
+#include "kernels.hpp"
+#include "mi_cache.hpp"
+#include "stats.hpp"
+#include "thread_pool.hpp"
 #include "utils.hpp"
 
 struct mrmr_result {
@@ -53,116 +57,749 @@ enum mrmr_method_type : char {
 	MIQ = 1
 };
 
+/*
+ * How candidates are scored in each selection step. EXHAUSTIVE brings the redundancy of
+ * every candidate up to date in every step. LAZY bounds each score from what is already
+ * known and only brings up to date the candidates whose bound can still beat the best
+ * score found so far; the rankings are the same. SAMPLED estimates every score with a
+ * confidence interval from a subsample of the rows and only computes exactly the scores
+ * of candidates whose interval reaches that of the leader; the rankings are the same
+ * with high probability, and within the tolerance given otherwise.
+ */
+enum mrmr_evaluation_type : char {
+	EXHAUSTIVE = 0,
+	LAZY = 1,
+	SAMPLED = 2
+};
+
+/* What SAMPLED evaluation knows of the score of one candidate short of computing it. */
+struct mrmr_estimate {
+	double relevance_low;
+	double relevance_high;
+	bool relevance_exact;
+	// sums of the bounds on the redundancy with every selected attribute, and their values
+	// when the redundancy was last brought up to date exactly
+	double redundance_low;
+	double redundance_high;
+	double updated_low;
+	double updated_high;
+
+	mrmr_estimate(): relevance_low( 0 ), relevance_high( 0 ), relevance_exact( false ), redundance_low( 0 ), redundance_high( 0 ),
+		updated_low( 0 ), updated_high( 0 ) { }
+};
+
+/*
+ * Parallel argmax bookkeeping for the selection loop. Ties are broken in favour of the
+ * candidate of greatest attribute index, which is what the serial loop over the attributes
+ * in order did, whatever order the candidates are now in.
+ */
+struct mrmr_best_candidate {
+	double score;
+	std::size_t position;
+	std::size_t index;
+
+	mrmr_best_candidate(): score( -std::numeric_limits<double>::infinity() ), position( std::numeric_limits<std::size_t>::max() ), index( 0 ) { }
+
+	void update( double candidate_score, std::size_t candidate_position, std::size_t candidate_index ) {
+		if( candidate_score > score || ( candidate_score == score && ( position == std::numeric_limits<std::size_t>::max() || candidate_index > index ) ) ) {
+			score = candidate_score;
+			position = candidate_position;
+			index = candidate_index;
+		}
+	}
+};
+
+/*
+ * Attributes not yet selected, as parallel arrays that a selection step streams through
+ * without looking anything up by attribute: the attribute, its relevance to the class, its
+ * redundancy summed over the selected attributes and how many of those the sum includes,
+ * which only lazy and sampled evaluation leave behind. A selected attribute is removed by
+ * moving the last candidate into its place, so positions only hold within a step.
+ */
+struct mrmr_candidates {
+	std::vector<std::size_t> indices;
+	std::vector<double> relevance;
+	std::vector<double> redundance;
+	std::vector<std::size_t> num_updated;
+
+	std::size_t size() const {
+		return indices.size();
+	}
+
+	bool empty() const {
+		return indices.empty();
+	}
+
+	void push_back( std::size_t index ) {
+		indices.push_back( index );
+		relevance.push_back( 0.0 );
+		redundance.push_back( 0.0 );
+		num_updated.push_back( 0 );
+	}
+
+	void remove( std::size_t position ) {
+		indices[ position ] = indices.back();
+		relevance[ position ] = relevance.back();
+		redundance[ position ] = redundance.back();
+		num_updated[ position ] = num_updated.back();
+		indices.pop_back();
+		relevance.pop_back();
+		redundance.pop_back();
+		num_updated.pop_back();
+	}
+};
+
+/*
+ * Mutual information between anchor and each candidate, taken from cache where present.
+ * Pairs not yet cached are computed together in one blocked pass and then cached.
+ */
+template<typename Data>
+void mrmr_mutual_information( Data const & data, mi_cache * cache, std::size_t anchor, std::size_t const * candidates,
+		std::size_t num_candidates, double * out ) {
+	if( cache == nullptr ) {
+		data.mutual_information_many( anchor, candidates, num_candidates, out );
+		return;
+	}
+	std::vector<std::size_t> missing;
+	cache->find_many( anchor, candidates, num_candidates, out, missing );
+	if( missing.empty() ) {
+		return;
+	}
+	std::vector<std::size_t> missing_candidates( missing.size() );
+	std::vector<double> missing_mi( missing.size() );
+	for( std::size_t i = 0; i < missing.size(); ++i ) {
+		missing_candidates[ i ] = candidates[ missing[ i ] ];
+	}
+	data.mutual_information_many( anchor, missing_candidates.data(), missing_candidates.size(), missing_mi.data() );
+	for( std::size_t i = 0; i < missing.size(); ++i ) {
+		out[ missing[ i ] ] = missing_mi[ i ];
+	}
+	cache->insert_many( anchor, missing_candidates.data(), missing_candidates.size(), missing_mi.data() );
+}
+
+/*
+ * Mutual information between each anchor and one candidate, taken from cache where
+ * present. The pairs not yet cached are computed together in one pass over the candidate.
+ */
+template<typename Data>
+void mrmr_mutual_information( Data const & data, mi_cache * cache, std::size_t const * anchors, std::size_t num_anchors,
+		std::size_t candidate, double * out ) {
+	if( cache == nullptr ) {
+		data.mutual_information_table( anchors, num_anchors, &candidate, 1, out );
+		return;
+	}
+	std::vector<std::size_t> missing_anchors;
+	std::vector<std::size_t> missing;
+	for( std::size_t i = 0; i < num_anchors; ++i ) {
+		std::size_t before = missing.size();
+		cache->find_many( anchors[ i ], &candidate, 1, &out[ i ], missing );
+		if( missing.size() != before ) {
+			missing.back() = i;
+			missing_anchors.push_back( anchors[ i ] );
+		}
+	}
+	if( missing.empty() ) {
+		return;
+	}
+	std::vector<double> missing_mi( missing.size() );
+	data.mutual_information_table( missing_anchors.data(), missing_anchors.size(), &candidate, 1, missing_mi.data() );
+	for( std::size_t i = 0; i < missing.size(); ++i ) {
+		out[ missing[ i ] ] = missing_mi[ i ];
+		cache->insert_many( missing_anchors[ i ], &candidate, 1, &missing_mi[ i ] );
+	}
+}
+
+/*
+ * Bounds on the mutual information between anchor and each candidate in data, estimated
+ * on sample, a subsample of the rows of data with the same attributes. The estimate from
+ * the sample is widened by sigmas standard errors, from its asymptotic variance with the
+ * finite population correction, and below also by its first order bias over the estimate
+ * from all the rows. Pairs whose table the sample does not keep flat are bounded only by
+ * the entropies of the two attributes.
+ */
+template<typename Data>
+void mrmr_sampled_mutual_information( Data const & data, dataset<typename Data::value_type> const & sample, double sigmas, std::size_t anchor,
+		std::size_t const * candidates, std::size_t num_candidates, double * low, double * high ) {
+	double const n = static_cast<double>( sample.num_instances() );
+	double const population = static_cast<double>( data.num_instances() );
+	double const correction = std::max( 0.0, 1.0 - n / population );
+	double const anchor_num_values = static_cast<double>( data.attribute_info( anchor ).num_values() );
+	sample.joint_count_tables( &anchor, 1, candidates, num_candidates, [&]( std::size_t, std::size_t c, std::uint32_t const * counts ) {
+		std::size_t const candidate = candidates[ c ];
+		double const ceiling = std::min( data.attribute_entropy( anchor ), data.attribute_entropy( candidate ) );
+		if( counts == nullptr ) {
+			low[ c ] = 0.0;
+			high[ c ] = ceiling;
+			return;
+		}
+		std::vector<probability> const & a1_probabilities = sample.attribute_info( anchor ).probabilities();
+		std::vector<probability> const & a2_probabilities = sample.attribute_info( candidate ).probabilities();
+		std::size_t const a2_num_values = a2_probabilities.size();
+		double mutual_information = 0.0;
+		double second_moment = 0.0;
+		for( std::size_t c1 = 0; c1 < a1_probabilities.size(); ++c1 ) {
+			for( std::size_t c2 = 0; c2 < a2_num_values; ++c2 ) {
+				if( counts[ c1 * a2_num_values + c2 ] > 0 ) {
+					probability joint_probability = counts[ c1 * a2_num_values + c2 ] / n;
+					double information = std::log2( joint_probability / ( a1_probabilities[ c1 ] * a2_probabilities[ c2 ] ) );
+					mutual_information += joint_probability * information;
+					second_moment += joint_probability * information * information;
+				}
+			}
+		}
+		double const error = sigmas * std::sqrt( std::max( 0.0, second_moment - mutual_information * mutual_information ) / n * correction );
+		double const bias = ( anchor_num_values - 1 ) * ( static_cast<double>( data.attribute_info( candidate ).num_values() ) - 1 )
+			/ ( 2 * std::log( 2.0 ) ) * ( 1 / n - 1 / population );
+		low[ c ] = std::max( 0.0, mutual_information - std::max( 0.0, bias ) - error );
+		high[ c ] = std::min( ceiling, mutual_information + error );
+	} );
+}
+
+/*
+ * Greedy mRMR selection that can be continued. The relevance of every attribute to the
+ * class is computed on construction; each call to extend then selects further attributes,
+ * keeping the accumulated redundancy so no mutual information is computed twice. The
+ * results after any sequence of extends are the leading results a single call to mrmr()
+ * for the same total would give. The dataset must outlive the selector and not change.
+ *
+ * Data is a dataset or any source of attributes with the same summary and mutual
+ * information members, such as a sharded_dataset or streaming_dataset; mrmr_selector<T> selects from a
+ * dataset<T>. SAMPLED evaluation needs a sample of the rows of the data, such as one
+ * from dataset::sample_rows; it is EXHAUSTIVE without one and LAZY with all the rows.
+ */
+template<typename Data>
+class basic_mrmr_selector {
+	public:
+		basic_mrmr_selector( Data const & data, std::size_t class_attribute, mrmr_method_type method = mrmr_method_type::MID,
+				std::size_t num_threads = 1, mi_cache * cache = nullptr, mrmr_evaluation_type evaluation = mrmr_evaluation_type::EXHAUSTIVE,
+				dataset<typename Data::value_type> const * sample = nullptr, double tolerance = 0.0 );
+		basic_mrmr_selector( basic_mrmr_selector const & ) = delete;
+		basic_mrmr_selector & operator=( basic_mrmr_selector const & ) = delete;
+
+		/* Selects up to num_features more attributes and returns how many were selected. */
+		std::size_t extend( std::size_t num_features );
+
+		/* The class attribute followed by the attributes selected so far, in order. */
+		std::vector<mrmr_result> const & results() const;
+		std::size_t num_selected() const;
+		bool finished() const;
+
+		/* Candidate scores SAMPLED evaluation has computed exactly, and those it settled from the sample alone. */
+		std::size_t num_exact_scores() const;
+		std::size_t num_skipped_scores() const;
+
+		/*
+		 * Most a computed mutual information is taken to fall below zero through rounding,
+		 * so that contributions not yet added can be bounded below in lazy evaluation.
+		 */
+		static constexpr double mi_rounding_slack = 1e-8;
+
+		/* Standard errors either side of a sampled estimate that its confidence interval spans. */
+		static constexpr double sample_sigmas = 4.0;
+
+	private:
+		void select_first();
+		void select_next();
+		void select_next_lazy();
+		void select_next_sampled();
+		void estimate_redundance( std::size_t attribute_index );
+		void remove_candidate( std::size_t position );
+		double score_bound( std::size_t position ) const;
+		double update_score( std::size_t position );
+		std::size_t candidate_grain() const;
+
+		Data const & _data;
+		mrmr_method_type _method;
+		mrmr_evaluation_type _evaluation;
+		mi_cache * _cache;
+		thread_pool _pool;
+		mrmr_candidates _candidates;
+		std::vector<std::size_t> _useless;
+		std::size_t _next_useless;
+		std::vector<double> _candidate_mi;
+		std::vector<mrmr_best_candidate> _thread_best;
+		std::size_t _last_attribute_index;
+		std::vector<std::size_t> _selected;
+		dataset<typename Data::value_type> const * _sample;
+		double _tolerance;
+		std::vector<mrmr_estimate> _estimates;
+		std::size_t _num_exact_scores;
+		std::size_t _num_skipped_scores;
+		bool _started;
+		std::vector<mrmr_result> _results;
+};
+
 template<typename T>
-std::vector<mrmr_result> mrmr(dataset<T>& data, std::size_t class_attribute = 0, std::size_t num_features = 0, mrmr_method_type method = mrmr_method_type::MID) {
+using mrmr_selector = basic_mrmr_selector<dataset<T> >;
 
-    if ( num_features == 0 )
-        num_features = data.num_attributes();
-    else
-        num_features++;
+template<typename Data>
+basic_mrmr_selector<Data>::basic_mrmr_selector( Data const & data, std::size_t class_attribute, mrmr_method_type method, std::size_t num_threads,
+		mi_cache * cache, mrmr_evaluation_type evaluation, dataset<typename Data::value_type> const * sample, double tolerance ) : _data( data ),
+		_method( method ), _evaluation( evaluation ), _cache( cache ), _pool( num_threads ),
+		_next_useless( 0 ), _thread_best( _pool.num_threads() ), _last_attribute_index( 0 ), _sample( sample ),
+		_tolerance( tolerance ), _num_exact_scores( 0 ), _num_skipped_scores( 0 ), _started( false ) {
+	if( _evaluation == mrmr_evaluation_type::SAMPLED && ( _sample == nullptr || _sample->num_instances() == 0 ) ) {
+		_evaluation = mrmr_evaluation_type::EXHAUSTIVE;
+	} else if( _evaluation == mrmr_evaluation_type::SAMPLED && _sample->num_instances() >= data.num_instances() ) {
+		// a sample of every row estimates nothing the data cannot give exactly
+		_evaluation = mrmr_evaluation_type::LAZY;
+	}
 
     // compute mRMR prerequisites
-    logger log = *logger::get();
+    logger & log = *logger::get();
 	log.message( "Calculating mutual information between each attribute and class...", INFO, START );
-
-	std::vector<double> mutual_informations( data.num_attributes() );
-	std::vector<double> redundance( data.num_attributes(), 0.0 );
-	std::forward_list<std::size_t> unselected;
-	std::vector<std::size_t> useless;
-
-    std::vector<mrmr_result> result;
+	statistics_phase phase( "relevance" );
 
 	for( std::size_t i = 0; i < data.num_attributes(); ++i ) {
 		if( i != class_attribute ) {
 			if( data.attribute_entropy( i ) > 0 ) {
-				mutual_informations[ i ] = data.mutual_information( class_attribute, i );
-				unselected.push_front( i );
+				_candidates.push_back( i );
 			} else {
-				mutual_informations[ i ] = 0;
-				useless.push_back( i );
+				_useless.push_back( i );
 			}
 		}
 	}
-	unselected.reverse();
-	mutual_informations[ class_attribute ] = -std::numeric_limits<double>::infinity();
-    
+	std::sort( _useless.begin(), _useless.end() );
+
+	// candidate mutual information is computed in blocks that share passes over the anchor column
+	_candidate_mi.resize( _candidates.size() );
+	std::size_t grain = candidate_grain();
+	if( _evaluation == mrmr_evaluation_type::SAMPLED ) {
+		// relevance is only estimated, and computed once a candidate comes close to leading
+		_estimates.resize( data.num_attributes() );
+		std::vector<double> high( _candidates.size() );
+		_pool.parallel_for( 0, _candidates.size(), grain, [&]( std::size_t begin, std::size_t end, std::size_t ) {
+			mrmr_sampled_mutual_information( _data, *_sample, sample_sigmas, class_attribute, &_candidates.indices[ begin ], end - begin,
+					&_candidate_mi[ begin ], &high[ begin ] );
+			for( std::size_t position = begin; position < end; ++position ) {
+				_estimates[ _candidates.indices[ position ] ].relevance_low = _candidate_mi[ position ] - mi_rounding_slack;
+				_estimates[ _candidates.indices[ position ] ].relevance_high = high[ position ] + mi_rounding_slack;
+			}
+		} );
+	} else {
+		_pool.parallel_for( 0, _candidates.size(), grain, [&]( std::size_t begin, std::size_t end, std::size_t ) {
+			mrmr_mutual_information( _data, _cache, class_attribute, &_candidates.indices[ begin ], end - begin,
+					&_candidates.relevance[ begin ] );
+		} );
+	}
 	log.message( "DONE", INFO, FINISH );
-	log.message( "Performing main mRMR computations...", INFO, START );
-	
+
     // class variable
 	double class_entropy = data.attribute_entropy( class_attribute );
-	result.push_back( mrmr_result( 0, class_attribute, data.attribute_name( class_attribute ),
+	_results.push_back( mrmr_result( 0, class_attribute, data.attribute_name( class_attribute ),
             class_entropy, class_entropy, std::numeric_limits<double>::quiet_NaN() ) );
+}
+
+template<typename Data>
+std::size_t basic_mrmr_selector<Data>::extend( std::size_t num_features ) {
+	std::size_t target = num_selected() + std::min( num_features, _data.num_attributes() );
+	std::size_t first = num_selected();
+
+    logger & log = *logger::get();
+	log.message( "Performing main mRMR computations...", INFO, START );
+	statistics_phase phase( "selection" );
 
-	// handle special case of first attribute with highest mutual information
+	if( ! _started && num_selected() < target && _evaluation != mrmr_evaluation_type::SAMPLED ) {
+		statistics_phase iteration( "iteration" );
+		select_first();
+	}
+	while( ! _candidates.empty() && num_selected() < target ) {
+		statistics_phase iteration( "iteration" );
+		if( _evaluation == mrmr_evaluation_type::SAMPLED ) {
+			select_next_sampled();
+		} else if( _evaluation == mrmr_evaluation_type::LAZY ) {
+			select_next_lazy();
+		} else {
+			select_next();
+		}
+	}
+
+	// finish by outputting useless features
+	while( _candidates.empty() && _next_useless < _useless.size() && num_selected() < target ) {
+		std::size_t attribute_index = _useless[ _next_useless++ ];
+        _results.push_back( mrmr_result( _results.size(), attribute_index, _data.attribute_name( attribute_index ), 
+                0, 0, std::numeric_limits<double>::infinity() ) );
+	}
+	log.message( "DONE", INFO, FINISH );
+	if( _evaluation == mrmr_evaluation_type::SAMPLED ) {
+		log.message( ( "Sampled evaluation computed " + std::to_string( _num_exact_scores ) + " candidate scores exactly and skipped "
+				+ std::to_string( _num_skipped_scores ) ).c_str(), INFO, STANDARD );
+	}
+	return num_selected() - first;
+}
+
+template<typename Data>
+void basic_mrmr_selector<Data>::select_first() {
+	// handle special case of first attribute with highest mutual information; the candidates
+	// are still in the order of their attributes, so ties go to the last
 	std::size_t best_attribute_index = 0;
+	std::size_t best_position = _candidates.size();
 	double max = std::numeric_limits<double>::min();
-	for ( auto it = mutual_informations.begin(); it != mutual_informations.end(); it++ ) {
-		if ( *it >= max) {
-			max = *it;
-			best_attribute_index = it - mutual_informations.begin();
-		}
-	}
-
-	std::size_t last_attribute_index = best_attribute_index;
-	unselected.remove( best_attribute_index );
-
-	double mrmr_score = mutual_informations.at( best_attribute_index );
-    result.push_back( mrmr_result( 1, best_attribute_index, data.attribute_name( best_attribute_index ),
-            data.attribute_entropy( best_attribute_index ), data.attribute_entropy( best_attribute_index ), mrmr_score ) );
-	
-	// main mRMR computation loop
-	std::size_t rank = 2;
-	while( !unselected.empty() && rank < num_features ) {
-		double best_mrmr_score = -std::numeric_limits<double>::infinity();
-		auto it = std::cbegin( unselected );
-		auto last_it = unselected.before_begin();
-		auto erase_it = last_it;
-		while( it != std::cend( unselected ) ) {
-			std::size_t attribute_index = *it;
-			redundance.at( attribute_index ) += data.mutual_information( last_attribute_index, attribute_index );
-
-			double redundance_value = redundance.at( attribute_index ) / (rank - 1); 
-			double mutual_information = mutual_informations.at ( attribute_index );
-
-			if( method == mrmr_method_type::MID ) {
-				mrmr_score = mutual_information - redundance_value;	
-			} else if( method == mrmr_method_type::MIQ ) {
-				mrmr_score = mutual_information / (redundance_value + 0.0001);
+	for( std::size_t position = 0; position < _candidates.size(); ++position ) {
+		if( _candidates.relevance[ position ] >= max ) {
+			max = _candidates.relevance[ position ];
+			best_attribute_index = _candidates.indices[ position ];
+			best_position = position;
+		}
+	}
+
+	// with no relevance above zero the first attribute is taken, whichever it is
+	double mrmr_score = best_attribute_index == static_cast<std::size_t>( _results.front().index ) ? -std::numeric_limits<double>::infinity() : 0.0;
+	if( best_position == _candidates.size() ) {
+		best_position = std::find( _candidates.indices.begin(), _candidates.indices.end(), best_attribute_index ) - _candidates.indices.begin();
+	}
+	if( best_position < _candidates.size() ) {
+		mrmr_score = _candidates.relevance[ best_position ];
+		_candidates.remove( best_position );
+	}
+
+	_last_attribute_index = best_attribute_index;
+	_selected.push_back( best_attribute_index );
+
+    _results.push_back( mrmr_result( 1, best_attribute_index, _data.attribute_name( best_attribute_index ),
+            _data.attribute_entropy( best_attribute_index ), _data.attribute_entropy( best_attribute_index ), mrmr_score ) );
+	_started = true;
+}
+
+/*
+ * Candidates taken per call for mutual information. A single thread takes them all at
+ * once, so a dataset that rescans its input does so once for the whole round.
+ */
+template<typename Data>
+std::size_t basic_mrmr_selector<Data>::candidate_grain() const {
+	if( _pool.num_threads() == 1 ) {
+		return std::max<std::size_t>( _candidates.size(), 1 );
+	}
+	return _candidates.size() / ( 8 * _pool.num_threads() ) + 1;
+}
+
+/*
+ * Brings the redundancy of every candidate up to date and takes the best score, a block
+ * of candidates at a time: the mutual information with the attribute selected last is
+ * computed for the block, then one vectorized pass over its arrays adds it and scores.
+ */
+template<typename Data>
+void basic_mrmr_selector<Data>::select_next() {
+	std::size_t rank = _results.size();
+	double const num_selected = static_cast<double>( rank - 1 );
+	bool const quotient = _method != mrmr_method_type::MID;
+	std::fill( _thread_best.begin(), _thread_best.end(), mrmr_best_candidate() );
+	std::size_t grain = candidate_grain();
+	_pool.parallel_for( 0, _candidates.size(), grain, [&]( std::size_t begin, std::size_t end, std::size_t thread_num ) {
+		mrmr_mutual_information( _data, _cache, _last_attribute_index, &_candidates.indices[ begin ], end - begin, &_candidate_mi[ begin ] );
+		double score;
+		std::size_t position = begin + active_kernels().best_mrmr_score( &_candidates.relevance[ begin ], &_candidates.redundance[ begin ],
+				&_candidate_mi[ begin ], &_candidates.indices[ begin ], end - begin, num_selected, quotient, &score );
+		if( position < end ) {
+			_thread_best[ thread_num ].update( score, position, _candidates.indices[ position ] );
+		}
+	} );
+
+	mrmr_best_candidate best;
+	for( auto & candidate : _thread_best ) {
+		if( candidate.position != std::numeric_limits<std::size_t>::max() ) {
+			best.update( candidate.score, candidate.position, candidate.index );
+		}
+	}
+	std::size_t best_position = best.position == std::numeric_limits<std::size_t>::max() ? 0 : best.position;
+	std::size_t best_attribute_index = _candidates.indices[ best_position ];
+
+    _results.push_back( mrmr_result( rank, best_attribute_index, _data.attribute_name( best_attribute_index ),
+        _data.attribute_entropy( best_attribute_index ), _data.attribute_entropy( best_attribute_index ), best.score ) );
+
+	remove_candidate( best_position );
+}
+
+/*
+ * Redundancy only gains terms that are at least zero, so the score a candidate would have
+ * with only the redundancy already added bounds its true score from above. Candidates are
+ * taken in order of that bound and brought up to date until no remaining bound reaches the
+ * best true score; the rest cannot win or tie. Contributions are added in the order the
+ * attributes were selected, so every score is bit for bit the exhaustive one.
+ */
+template<typename Data>
+void basic_mrmr_selector<Data>::select_next_lazy() {
+	std::size_t rank = _results.size();
+	std::vector<std::pair<double, std::size_t> > bounds( _candidates.size() );
+	for( std::size_t position = 0; position < _candidates.size(); ++position ) {
+		bounds[ position ] = std::make_pair( score_bound( position ), position );
+	}
+	std::make_heap( bounds.begin(), bounds.end() );
+
+	mrmr_best_candidate best;
+	std::vector<std::size_t> chunk;
+	std::vector<double> scores;
+	while( ! bounds.empty() && bounds.front().first >= best.score ) {
+		// update as many of the most promising candidates at once as there are threads
+		chunk.clear();
+		while( ! bounds.empty() && bounds.front().first >= best.score && chunk.size() < _pool.num_threads() ) {
+			std::pop_heap( bounds.begin(), bounds.end() );
+			chunk.push_back( bounds.back().second );
+			bounds.pop_back();
+		}
+		scores.resize( chunk.size() );
+		_pool.parallel_for( 0, chunk.size(), [&]( std::size_t i ) {
+			scores[ i ] = update_score( chunk[ i ] );
+		} );
+		for( std::size_t i = 0; i < chunk.size(); ++i ) {
+			best.update( scores[ i ], chunk[ i ], _candidates.indices[ chunk[ i ] ] );
+		}
+	}
+
+	std::size_t best_position = best.position == std::numeric_limits<std::size_t>::max() ? 0 : best.position;
+	std::size_t best_attribute_index = _candidates.indices[ best_position ];
+
+    _results.push_back( mrmr_result( rank, best_attribute_index, _data.attribute_name( best_attribute_index ),
+        _data.attribute_entropy( best_attribute_index ), _data.attribute_entropy( best_attribute_index ), best.score ) );
+
+	remove_candidate( best_position );
+}
+
+/*
+ * Each candidate's score is bounded from its relevance and redundancy, exact where known
+ * and otherwise the intervals estimated on the sample. As in lazy evaluation, candidates
+ * are computed exactly in order of their upper bound, until none left can beat the best
+ * computed score by more than the tolerance; the leader's lower bound already rules out
+ * most without computing any. The first attribute is selected this way on relevance alone.
+ */
+template<typename Data>
+void basic_mrmr_selector<Data>::select_next_sampled() {
+	std::size_t rank = _results.size();
+	double const num_selected = static_cast<double>( _selected.size() );
+	std::vector<std::pair<double, std::size_t> > bounds;
+	mrmr_best_candidate leader;
+	for( std::size_t position = 0; position < _candidates.size(); ++position ) {
+		std::size_t attribute_index = _candidates.indices[ position ];
+		mrmr_estimate const & estimate = _estimates[ attribute_index ];
+		double low = estimate.relevance_low;
+		double high = estimate.relevance_high;
+		if( ! _selected.empty() ) {
+			double pending_slack = static_cast<double>( _selected.size() - _candidates.num_updated[ position ] ) * mi_rounding_slack;
+			double redundance_low = std::max( 0.0, _candidates.redundance[ position ] + ( estimate.redundance_low - estimate.updated_low ) - pending_slack )
+				/ num_selected;
+			double redundance_high = ( _candidates.redundance[ position ] + ( estimate.redundance_high - estimate.updated_high ) + pending_slack ) / num_selected;
+			if( _method == mrmr_method_type::MID ) {
+				low = estimate.relevance_low - redundance_high;
+				high = estimate.relevance_high - redundance_low;
 			} else {
-				log.message( "Invalid MRMR method speicified.", ERROR );
-				return result;
+				low = estimate.relevance_low / ( ( estimate.relevance_low < 0 ? redundance_low : redundance_high ) + 0.0001 );
+				high = estimate.relevance_high / ( ( estimate.relevance_high < 0 ? redundance_high : redundance_low ) + 0.0001 );
 			}
+		}
+		leader.update( low, position, attribute_index );
+		bounds.push_back( std::make_pair( high, position ) );
+	}
+	bounds.erase( std::remove_if( bounds.begin(), bounds.end(), [&]( std::pair<double, std::size_t> const & bound ) {
+		return bound.first < leader.score + _tolerance && bound.second != leader.position;
+	} ), bounds.end() );
+	std::make_heap( bounds.begin(), bounds.end() );
 
-			if( mrmr_score >= best_mrmr_score) {
-				best_mrmr_score = mrmr_score;
-				best_attribute_index = attribute_index;
-				erase_it = last_it;
-			}
+	mrmr_best_candidate best;
+	std::vector<std::size_t> chunk;
+	std::vector<double> scores;
+	std::size_t num_exact = 0;
+	while( ! bounds.empty() && ( best.position == std::numeric_limits<std::size_t>::max() || bounds.front().first >= best.score + _tolerance ) ) {
+		// compute as many of the most promising candidates at once as there are threads
+		chunk.clear();
+		while( ! bounds.empty() && ( chunk.empty() || bounds.front().first >= best.score + _tolerance ) && chunk.size() < _pool.num_threads() ) {
+			std::pop_heap( bounds.begin(), bounds.end() );
+			chunk.push_back( bounds.back().second );
+			bounds.pop_back();
+		}
+		scores.resize( chunk.size() );
+		_pool.parallel_for( 0, chunk.size(), [&]( std::size_t i ) {
+			scores[ i ] = update_score( chunk[ i ] );
+		} );
+		for( std::size_t i = 0; i < chunk.size(); ++i ) {
+			best.update( scores[ i ], chunk[ i ], _candidates.indices[ chunk[ i ] ] );
+		}
+		num_exact += chunk.size();
+	}
+	_num_exact_scores += num_exact;
+	_num_skipped_scores += _candidates.size() - num_exact;
+
+	std::size_t best_position = best.position;
+	std::size_t best_attribute_index = _candidates.indices[ best_position ];
+
+    _results.push_back( mrmr_result( rank, best_attribute_index, _data.attribute_name( best_attribute_index ),
+        _data.attribute_entropy( best_attribute_index ), _data.attribute_entropy( best_attribute_index ), best.score ) );
+
+	remove_candidate( best_position );
+	_started = true;
+	estimate_redundance( best_attribute_index );
+}
 
-			++it;
-			++last_it;
+/* Adds the sampled bounds on the mutual information of each candidate with a newly selected attribute. */
+template<typename Data>
+void basic_mrmr_selector<Data>::estimate_redundance( std::size_t attribute_index ) {
+	std::vector<double> high( _candidates.size() );
+	_pool.parallel_for( 0, _candidates.size(), candidate_grain(), [&]( std::size_t begin, std::size_t end, std::size_t ) {
+		mrmr_sampled_mutual_information( _data, *_sample, sample_sigmas, attribute_index, &_candidates.indices[ begin ], end - begin,
+				&_candidate_mi[ begin ], &high[ begin ] );
+		for( std::size_t position = begin; position < end; ++position ) {
+			_estimates[ _candidates.indices[ position ] ].redundance_low += _candidate_mi[ position ];
+			_estimates[ _candidates.indices[ position ] ].redundance_high += high[ position ];
 		}
+	} );
+}
 
-        result.push_back( mrmr_result( rank++, best_attribute_index, data.attribute_name( best_attribute_index ),
-            data.attribute_entropy( best_attribute_index ), data.attribute_entropy( best_attribute_index ), best_mrmr_score ) );
+/* Selects the candidate at position, removing it from the candidates. */
+template<typename Data>
+void basic_mrmr_selector<Data>::remove_candidate( std::size_t position ) {
+	_last_attribute_index = _candidates.indices[ position ];
+	_selected.push_back( _last_attribute_index );
+	_candidates.remove( position );
+}
 
-		unselected.erase_after( erase_it );
-		last_attribute_index = best_attribute_index;
+template<typename Data>
+double basic_mrmr_selector<Data>::score_bound( std::size_t position ) const {
+	double num_selected = static_cast<double>( _selected.size() );
+	double pending = static_cast<double>( _selected.size() - _candidates.num_updated[ position ] );
+	double redundance_value = ( _candidates.redundance[ position ] - pending * mi_rounding_slack ) / num_selected;
+	double mutual_information = _candidates.relevance[ position ];
+
+	if( _method == mrmr_method_type::MID ) {
+		return mutual_information - redundance_value;
+	}
+	// the quotient only falls as redundancy grows when both parts are positive
+	if( mutual_information < 0 || redundance_value + 0.0001 <= 0 ) {
+		return std::numeric_limits<double>::infinity();
 	}
+	return mutual_information / (redundance_value + 0.0001);
+}
 
-	// finish by outputting useless features
-	std::sort( useless.begin(), useless.end() );
-	for( auto attribute_index : useless ) {
-        if ( rank >= num_features )
-            break;
+template<typename Data>
+double basic_mrmr_selector<Data>::update_score( std::size_t position ) {
+	std::size_t attribute_index = _candidates.indices[ position ];
+	if( _evaluation == mrmr_evaluation_type::SAMPLED ) {
+		mrmr_estimate & estimate = _estimates[ attribute_index ];
+		if( ! estimate.relevance_exact ) {
+			mrmr_mutual_information( _data, _cache, _results.front().index, &attribute_index, 1, &_candidates.relevance[ position ] );
+			estimate.relevance_low = _candidates.relevance[ position ];
+			estimate.relevance_high = _candidates.relevance[ position ];
+			estimate.relevance_exact = true;
+		}
+		estimate.updated_low = estimate.redundance_low;
+		estimate.updated_high = estimate.redundance_high;
+		if( _selected.empty() ) {
+			return _candidates.relevance[ position ];
+		}
+	}
 
-        result.push_back( mrmr_result( rank++, attribute_index, data.attribute_name( attribute_index ), 
-                0, 0, std::numeric_limits<double>::infinity() ) );
+	std::size_t first = _candidates.num_updated[ position ];
+	std::size_t num_pending = _selected.size() - first;
+	if( num_pending > 0 ) {
+		std::vector<double> pending_mi( num_pending );
+		mrmr_mutual_information( _data, _cache, &_selected[ first ], num_pending, attribute_index, pending_mi.data() );
+		for( double mi : pending_mi ) {
+			_candidates.redundance[ position ] += mi;
+		}
+		_candidates.num_updated[ position ] = _selected.size();
 	}
 
-	log.message( "DONE", INFO, FINISH );
-	return result;
+	double redundance_value = _candidates.redundance[ position ] / _selected.size(); 
+	double mutual_information = _candidates.relevance[ position ];
+
+	if( _method == mrmr_method_type::MID ) {
+		return mutual_information - redundance_value;
+	} else {
+		return mutual_information / (redundance_value + 0.0001);
+	}
+}
+
+template<typename Data>
+std::vector<mrmr_result> const & basic_mrmr_selector<Data>::results() const {
+	return _results;
+}
+
+template<typename Data>
+std::size_t basic_mrmr_selector<Data>::num_selected() const {
+	return _results.size() - 1;
+}
+
+template<typename Data>
+bool basic_mrmr_selector<Data>::finished() const {
+	return _started && _candidates.empty() && _next_useless == _useless.size();
+}
+
+template<typename Data>
+std::size_t basic_mrmr_selector<Data>::num_exact_scores() const {
+	return _num_exact_scores;
+}
+
+template<typename Data>
+std::size_t basic_mrmr_selector<Data>::num_skipped_scores() const {
+	return _num_skipped_scores;
+}
+
+template<typename Data>
+std::vector<mrmr_result> mrmr(Data& data, std::size_t class_attribute = 0, std::size_t num_features = 0, mrmr_method_type method = mrmr_method_type::MID, std::size_t num_threads = 1, mi_cache * cache = nullptr,
+		mrmr_evaluation_type evaluation = mrmr_evaluation_type::EXHAUSTIVE, dataset<typename Data::value_type> const * sample = nullptr, double tolerance = 0.0) {
+
+    if ( method != mrmr_method_type::MID && method != mrmr_method_type::MIQ ) {
+        logger::get()->message( "Invalid MRMR method speicified.", ERROR );
+        return std::vector<mrmr_result>();
+    }
+
+    basic_mrmr_selector<Data> selector( data, class_attribute, method, num_threads, cache, evaluation, sample, tolerance );
+    selector.extend( num_features == 0 ? data.num_attributes() - 1 : num_features );
+    return selector.results();
+}
+
+/*
+ * Runs mRMR for each class attribute in turn, ranking exactly as separate calls to mrmr()
+ * would. Relevance to every class is computed in one pass over the data and the runs share
+ * a cache, so redundancy between attributes that several selection paths have in common is
+ * computed once. A cache with room for all relevance values is used when none is given.
+ * SAMPLED evaluation computes relevance only where it needs it, so no pass is made then.
+ */
+template<typename Data>
+std::vector<std::vector<mrmr_result>> mrmr_batch(Data& data, std::vector<std::size_t> const & class_attributes, std::size_t num_features = 0,
+		mrmr_method_type method = mrmr_method_type::MID, std::size_t num_threads = 1, mi_cache * cache = nullptr,
+		mrmr_evaluation_type evaluation = mrmr_evaluation_type::EXHAUSTIVE, dataset<typename Data::value_type> const * sample = nullptr,
+		double tolerance = 0.0) {
+	std::vector<std::vector<mrmr_result>> results;
+	if( class_attributes.empty() ) {
+		return results;
+	}
+
+	mi_cache batch_cache( class_attributes.size() * data.num_attributes() * mi_cache::entry_bytes + mi_cache::default_max_bytes );
+	if( cache == nullptr ) {
+		cache = &batch_cache;
+	}
+
+	if( evaluation == mrmr_evaluation_type::SAMPLED && sample != nullptr && sample->num_instances() > 0 ) {
+		for( auto class_attribute : class_attributes ) {
+			results.push_back( mrmr( data, class_attribute, num_features, method, num_threads, cache, evaluation, sample, tolerance ) );
+		}
+		return results;
+	}
+
+	logger::get()->message( "Calculating mutual information between each attribute and all classes...", INFO, START );
+	{
+		statistics_phase phase( "relevance" );
+		std::vector<std::size_t> candidates;
+		for( std::size_t i = 0; i < data.num_attributes(); ++i ) {
+			if( data.attribute_entropy( i ) > 0 ) {
+				candidates.push_back( i );
+			}
+		}
+		thread_pool pool( num_threads );
+		std::size_t grain = candidates.size() / ( 8 * pool.num_threads() ) + 1;
+		pool.parallel_for( 0, candidates.size(), grain, [&]( std::size_t begin, std::size_t end, std::size_t ) {
+			std::vector<double> table( class_attributes.size() * ( end - begin ) );
+			data.mutual_information_table( class_attributes.data(), class_attributes.size(), &candidates[ begin ], end - begin, table.data() );
+			for( std::size_t c = 0; c < class_attributes.size(); ++c ) {
+				cache->insert_many( class_attributes[ c ], &candidates[ begin ], end - begin, &table[ c * ( end - begin ) ] );
+			}
+		} );
+	}
+	logger::get()->message( "DONE", INFO, FINISH );
+
+	for( auto class_attribute : class_attributes ) {
+		results.push_back( mrmr( data, class_attribute, num_features, method, num_threads, cache, evaluation, sample, tolerance ) );
+	}
+	return results;
 }
 
 #endif 
\ No newline at end of file
@@ -18,139 +18,110 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <cstring>
 #include <iostream>
+#include <memory>
 
 #include "mrmr_py.hpp"
 
+// every dataset stores each column at the narrowest width holding it, so type only remains for callers built against
+// the typed datasets and must still name one of the buffer types
 void * setup_mrmr( data_type type ) {
     if ( type >= uint8_type && type <= int32_type )
-        return new mrmr_env( type );
+        return new mrmr_env();
     else 
         return nullptr;
 }
 
-int add_attribute_uint8( void * env, const char * name, uint8_t * data, std::size_t length ) {
-    mrmr_env * m_env = static_cast< mrmr_env * >( env );
-
+// readies the dataset for new attributes, which invalidate any selection and cached mutual information
+static void prepare_data( mrmr_env * m_env ) {
     if ( ! m_env->has_data() ) {
         m_env->init_data();
     }
 
-    std::string name_s(name);
-
-    int ret = 0;
-    
-    uint16_t * u_tmp;
-    int32_t * i_tmp;
-
-    switch ( m_env->type )
-    {
-        case uint8_type:
-            ret = m_env->data_uint8->set_attribute( name_s, data, length );
-            break;
-
-        case uint16_type:
-            u_tmp = new uint16_t[ length ];
-            for ( std::size_t i = 0; i < length; i++ )
-                u_tmp[i] = data[i];
-
-            ret = m_env->data_uint16->set_attribute( name_s, u_tmp, length );
-            delete [] u_tmp;
-            break;
-
-        case int32_type:
-            i_tmp = new int32_t[ length ];
-            for ( std::size_t i = 0; i < length; i++ )
-                i_tmp[i] = data[i];
+    m_env->clear_selector();
+    m_env->cache.clear();
+}
 
-            ret = m_env->data_int32->set_attribute( name_s, i_tmp, length );
-            delete [] i_tmp;
-            break;
+int reserve_dataset( void * env, std::size_t num_attributes, std::size_t num_instances ) {
+    mrmr_env * m_env = static_cast< mrmr_env * >( env );
 
-        default: 
-			ret = -2;
-			m_env->error = "invalid type";
-			break;
+    prepare_data( m_env );
 
+    if ( m_env->num_attributes() > 0 ) {
+        m_env->error = "dataset already has attributes";
+        return -1;
     }
 
-    return ret;
+    m_env->data->reserve( num_attributes, num_instances );
+    return 0;
 }
 
-int add_attribute_uint16( void *env, const char * name, uint16_t * data, std::size_t length ) {
+// values are encoded straight into the dataset without widening copies
+int add_attribute_uint8( void * env, const char * name, uint8_t * data, std::size_t length ) {
     mrmr_env * m_env = static_cast< mrmr_env * >( env );
 
-    if ( ! m_env->has_data() ) {
-        m_env->init_data();
-    }
-
-    std::string name_s(name);
+    prepare_data( m_env );
+    return m_env->data->set_attribute( std::string( name ), data, length );
+}
 
-    int ret = 0;
+int add_attribute_uint16( void *env, const char * name, uint16_t * data, std::size_t length ) {
+    mrmr_env * m_env = static_cast< mrmr_env * >( env );
 
-    int32_t * tmp;
+    prepare_data( m_env );
+    return m_env->data->set_attribute( std::string( name ), data, length );
+}
 
-    switch ( m_env->type )
-    {
-        case uint8_type:
-            m_env->error = "cannot put uint16 into uint8 type.";
-            return -1;
+int add_attribute_int32( void *env, const char * name, int32_t * data, std::size_t length ) {
+    mrmr_env * m_env = static_cast< mrmr_env * >( env );
 
-        case uint16_type:
-            ret = m_env->data_uint16->set_attribute( name_s, data, length );
-            break;
+    prepare_data( m_env );
+    return m_env->data->set_attribute( std::string( name ), data, length );
+}
 
-        case int32_type:
-            tmp = new int32_t[ length ];
-            for ( std::size_t i = 0; i < length; i++ )
-                tmp[i] = data[i];
-
-            ret = m_env->data_int32->set_attribute( name_s, tmp, length );
-            delete [] tmp;
-            break;
-
-        default: 
-			ret = -2;
-			m_env->error = "invalid type";
-			break;
+template < typename U >
+static int add_buffer( mrmr_env * m_env, const char ** names, const U * values, std::size_t num_instances,
+        std::size_t num_attributes, std::ptrdiff_t instance_stride, std::ptrdiff_t attribute_stride, unsigned int num_threads ) {
+    // strides are given in bytes, as NumPy gives them
+    if ( instance_stride % static_cast< std::ptrdiff_t >( sizeof( U ) ) != 0 || attribute_stride % static_cast< std::ptrdiff_t >( sizeof( U ) ) != 0 ) {
+        m_env->error = "strides must be multiples of the value size";
+        return -3;
     }
 
+    std::vector< std::string > names_s( names, names + num_attributes );
+    int ret = m_env->data->set_attributes( names_s, values, num_instances, instance_stride / static_cast< std::ptrdiff_t >( sizeof( U ) ),
+            attribute_stride / static_cast< std::ptrdiff_t >( sizeof( U ) ), num_threads );
+    if ( ret < 0 )
+        m_env->error = "number of instances does not match the dataset";
+
     return ret;
 }
 
-int add_attribute_int32( void *env, const char * name, int32_t * data, std::size_t length ) {
+int add_attributes( void * env, const char ** names, const void * data, data_type type, std::size_t num_instances,
+        std::size_t num_attributes, std::ptrdiff_t instance_stride, std::ptrdiff_t attribute_stride, unsigned int num_threads ) {
     mrmr_env * m_env = static_cast< mrmr_env * >( env );
 
-     if ( ! m_env->has_data() ) {
-        m_env->init_data();
-    }
+    prepare_data( m_env );
 
-    std::string name_s(name);
-    switch ( m_env->type )
+    switch ( type )
     {
         case uint8_type:
-            m_env->error = "cannot put type int32 in uint8 data set";
-            return -1;
+            return add_buffer( m_env, names, static_cast< const uint8_t * >( data ), num_instances, num_attributes,
+                    instance_stride, attribute_stride, num_threads );
 
         case uint16_type:
-            m_env->error = "cannot put type int32 in uint16 data set";
-            return -1;
+            return add_buffer( m_env, names, static_cast< const uint16_t * >( data ), num_instances, num_attributes,
+                    instance_stride, attribute_stride, num_threads );
 
         case int32_type:
-            return m_env->data_int32->set_attribute( name_s, data, length );
-
-        default: 
-			m_env->error = "invalid type";
-			return -2;
+            return add_buffer( m_env, names, static_cast< const int32_t * >( data ), num_instances, num_attributes,
+                    instance_stride, attribute_stride, num_threads );
     }
-}
-
-int perform_mrmr( void * env, mrmr_method_type mrmr_method, unsigned int label, unsigned int num_features ) {
-    mrmr_env * m_env = static_cast< mrmr_env * >( env );
 
-    m_env->clear_results();
+    m_env->error = "invalid type";
+    return -2;
+}
 
+static int check_mrmr( mrmr_env * m_env, mrmr_method_type mrmr_method, const unsigned int * labels, unsigned int num_labels ) {
     if ( ! ( mrmr_method == mrmr_method_type::MID || mrmr_method == mrmr_method_type::MIQ ) ) {
         m_env->error = "invalid mRMR method";
         return -1;
@@ -161,50 +132,169 @@ int perform_mrmr( void * env, mrmr_method_type mrmr_method, unsigned int label,
         return -2;
     }    
 
-    if ( label >= m_env->num_attributes() ) {
-        m_env->error = "label out of range";
-        return -3;
+    for ( unsigned int i = 0; i < num_labels; i++ ) {
+        if ( labels[i] >= m_env->num_attributes() ) {
+            m_env->error = "label out of range";
+            return -3;
+        }
     }
 
-    std::vector<mrmr_result> results;
-    switch ( m_env->type ) {
-        case uint8_type:
-            results = mrmr( *m_env->data_uint8, label, num_features, mrmr_method );
-            break;
-
-        case uint16_type:
-            results = mrmr( *m_env->data_uint16, label, num_features, mrmr_method );
-            break;
-
-        case int32_type:
-            results = mrmr( *m_env->data_int32, label, num_features, mrmr_method );
-            break;
-    }
+    return 0;
+}
 
-    if ( ( m_env->results_size = results.size() - 1 ) > 0 ) {
-        
-        m_env->ranks = new const char * [ m_env->results_size ];
-        m_env->entropy = new double[ m_env->results_size ];
-        m_env->mutual_information = new double[ m_env->results_size ];
-        m_env->score = new double[ m_env -> results_size ];
+// stores the rankings one after another without their class rows, recording where each starts
+static int store_results( mrmr_env * m_env, std::vector< std::vector<mrmr_result> > const & batch_results ) {
+    m_env->num_offsets = batch_results.size() + 1;
+    m_env->offsets = new int[ m_env->num_offsets ];
+    m_env->offsets[0] = 0;
+    for ( std::size_t b = 0; b < batch_results.size(); b++ )
+        m_env->offsets[b + 1] = m_env->offsets[b] + ( batch_results[b].empty() ? 0 : batch_results[b].size() - 1 );
+
+    if ( ( m_env->results_size = m_env->offsets[ batch_results.size() ] ) > 0 ) {
+        std::size_t size = m_env->results_size;
+
+        // one allocation holding all five columns, which Python views in place
+        m_env->results = new char[ size * ( 2 * sizeof( int64_t ) + 3 * sizeof( double ) ) ];
+        m_env->rank = reinterpret_cast< int64_t * >( m_env->results );
+        m_env->index = m_env->rank + size;
+        m_env->entropy = reinterpret_cast< double * >( m_env->index + size );
+        m_env->mutual_information = m_env->entropy + size;
+        m_env->score = m_env->mutual_information + size;
 
         std::size_t i = 0;
-        for ( auto it = results.begin() + 1; it != results.end(); it++ ) {
-            m_env->ranks[i] = strdup( it->name.c_str() );
-            m_env->entropy[i] = it->entropy;
-            m_env->mutual_information[i] = it->mutual_information;
-            m_env->score[i++] = it->score;
+        for ( auto const & results : batch_results ) {
+            if ( results.empty() )
+                continue;
+
+            for ( auto it = results.begin() + 1; it != results.end(); it++ ) {
+                m_env->rank[i] = it->rank;
+                m_env->index[i] = it->index;
+                m_env->entropy[i] = it->entropy;
+                m_env->mutual_information[i] = it->mutual_information;
+                m_env->score[i++] = it->score;
+            }
         }
     }
-    
+
     return m_env->results_size;
 }
 
+/* Rows sampled evaluation estimates on, or none for any other evaluation. */
+template < typename T >
+static dataset< T > * draw_sample( mrmr_env * m_env, dataset< T > const & data, unsigned int num_threads ) {
+    if ( m_env->evaluation != mrmr_evaluation_type::SAMPLED )
+        return nullptr;
+
+    return new dataset< T >( data.sample_rows( m_env->sample_rows, 0, num_threads ) );
+}
+
+int perform_mrmr( void * env, mrmr_method_type mrmr_method, unsigned int label, unsigned int num_features, unsigned int num_threads ) {
+    mrmr_env * m_env = static_cast< mrmr_env * >( env );
+
+    m_env->clear_results();
+
+    int ret = check_mrmr( m_env, mrmr_method, &label, 1 );
+    if ( ret < 0 )
+        return ret;
+
+    statistics::get()->reset();
+    std::vector< std::vector<mrmr_result> > results( 1 );
+    std::unique_ptr< dataset< int32_t > > sample( draw_sample( m_env, *m_env->data, num_threads ) );
+    results[0] = mrmr( *m_env->data, label, num_features, mrmr_method, num_threads, &m_env->cache, m_env->evaluation,
+            sample.get(), m_env->tolerance );
+
+    m_env->stats = statistics::get()->json();
+    return store_results( m_env, results );
+}
+
+int perform_mrmr_batch( void * env, mrmr_method_type mrmr_method, const unsigned int * labels, unsigned int num_labels,
+        unsigned int num_features, unsigned int num_threads ) {
+    mrmr_env * m_env = static_cast< mrmr_env * >( env );
+
+    m_env->clear_results();
+
+    int ret = check_mrmr( m_env, mrmr_method, labels, num_labels );
+    if ( ret < 0 )
+        return ret;
+
+    statistics::get()->reset();
+    std::vector< std::size_t > class_attributes( labels, labels + num_labels );
+    std::vector< std::vector<mrmr_result> > results;
+    std::unique_ptr< dataset< int32_t > > sample( draw_sample( m_env, *m_env->data, num_threads ) );
+    results = mrmr_batch( *m_env->data, class_attributes, num_features, mrmr_method, num_threads, &m_env->cache,
+            m_env->evaluation, sample.get(), m_env->tolerance );
+
+    m_env->stats = statistics::get()->json();
+    return store_results( m_env, results );
+}
+
+int start_selection( void * env, mrmr_method_type mrmr_method, unsigned int label, unsigned int num_threads ) {
+    mrmr_env * m_env = static_cast< mrmr_env * >( env );
+
+    m_env->clear_results();
+    m_env->clear_selector();
+
+    int ret = check_mrmr( m_env, mrmr_method, &label, 1 );
+    if ( ret < 0 )
+        return ret;
+
+    // extend_selection adds to the statistics of the whole selection
+    statistics::get()->reset();
+    m_env->sample = draw_sample( m_env, *m_env->data, num_threads );
+    m_env->selector = new mrmr_selector< int32_t >( *m_env->data, label, mrmr_method, num_threads, &m_env->cache, m_env->evaluation,
+            m_env->sample, m_env->tolerance );
+
+    m_env->stats = statistics::get()->json();
+    return 0;
+}
+
+int extend_selection( void * env, unsigned int num_features ) {
+    mrmr_env * m_env = static_cast< mrmr_env * >( env );
+
+    m_env->clear_results();
+
+    if ( ! m_env->has_selector() ) {
+        m_env->error = "selection not started";
+        return -4;
+    }
+
+    // results hold the whole ranking so far
+    std::vector< std::vector<mrmr_result> > results( 1 );
+    m_env->selector->extend( num_features );
+    results[0] = m_env->selector->results();
+
+    m_env->stats = statistics::get()->json();
+    return store_results( m_env, results );
+}
+
+const int * get_result_offsets( void * env, int * num ) {
+    mrmr_env * m_env = static_cast< mrmr_env * >( env );
+
+    *num = m_env->num_offsets;
+    return m_env->offsets;
+}
+
+const char * get_results( void * env, int * num ) {
+    mrmr_env * m_env = static_cast< mrmr_env * >( env );
+
+    *num = m_env->results_size;
+    return m_env->results;
+}
+
 const char ** get_feature_ranks( void * env, int * num ) {
     mrmr_env * m_env = static_cast< mrmr_env * >( env );
 
+    if ( m_env->ranks.empty() && m_env->results_size > 0 ) {
+        m_env->names.reserve( m_env->results_size );
+        for ( int i = 0; i < m_env->results_size; i++ )
+            m_env->names.push_back( m_env->data->attribute_name( m_env->index[i] ) );
+
+        for ( auto const & name : m_env->names )
+            m_env->ranks.push_back( name.c_str() );
+    }
+
     *num = m_env->results_size;
-    return m_env->ranks;
+    return m_env->ranks.empty() ? nullptr : m_env->ranks.data();
 }
 
 double * get_entropy( void * env, int * num ) {
@@ -228,6 +318,43 @@ double * get_mrmr_score( void * env, int * num ) {
     return m_env->score;
 }
 
+void set_mi_cache_limit( void * env, std::size_t max_bytes ) {
+    mrmr_env * m_env = static_cast< mrmr_env * >( env );
+    m_env->cache.set_max_bytes( max_bytes );
+}
+
+void set_evaluation( void * env, mrmr_evaluation_type evaluation ) {
+    mrmr_env * m_env = static_cast< mrmr_env * >( env );
+    m_env->evaluation = evaluation;
+}
+
+void set_sampling( void * env, std::size_t sample_rows, double tolerance ) {
+    mrmr_env * m_env = static_cast< mrmr_env * >( env );
+    m_env->sample_rows = sample_rows;
+    m_env->tolerance = tolerance;
+}
+
+void get_mi_cache_stats( void * env, uint64_t * hits, uint64_t * misses, std::size_t * entries, std::size_t * bytes ) {
+    mrmr_env * m_env = static_cast< mrmr_env * >( env );
+
+    if ( hits )
+        *hits = m_env->cache.hits();
+
+    if ( misses )
+        *misses = m_env->cache.misses();
+
+    if ( entries )
+        *entries = m_env->cache.size();
+
+    if ( bytes )
+        *bytes = m_env->cache.memory_usage();
+}
+
+const char * get_stats( void * env ) {
+    mrmr_env * m_env = static_cast< mrmr_env * >( env );
+    return m_env->stats.c_str();
+}
+
 const char * get_last_error( void * env ) {
     mrmr_env * m_env = static_cast< mrmr_env * >( env );
     return m_env->error.c_str();
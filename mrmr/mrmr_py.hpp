@@ -21,13 +21,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MRMR_PY
 #define MRMR_PY
 
+#include <cstddef>
 #include <cstdint>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
 #include "dataset.hpp"
+#include "mi_cache.hpp"
 #include "mrmr.hpp"
+#include "stats.hpp"
 
 #ifdef _WIN32
 #define DLL_EXPORT __declspec(dllexport)
@@ -35,6 +38,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define DLL_EXPORT
 #endif
 
+// types of the value buffers add_attributes accepts
 enum data_type: char {
     uint8_type = 0,
     uint16_type = 1,
@@ -42,132 +46,137 @@ enum data_type: char {
 };
 
 struct mrmr_env {
-    dataset< uint8_t > * data_uint8;
-    dataset< uint16_t > * data_uint16;
-    dataset< int32_t > * data_int32;
-
-    data_type type;
+    // every column is packed at the width its own values need, whichever type it was added as
+    dataset< int32_t > * data;
 
+    // results of the last run in one buffer of five columns of results_size values each: the rank and
+    // attribute index of every feature as int64, then its entropy, mutual information with the label and
+    // mRMR score as doubles; the pointers below are the columns
     int results_size;
-    const char ** ranks;
+    char * results;
+    int64_t * rank;
+    int64_t * index;
     double * entropy;
     double * mutual_information;
     double * score;
 
-    std::string error;
+    // names of the ranked features, only gathered when get_feature_ranks asks
+    std::vector< std::string > names;
+    std::vector< const char * > ranks;
 
-    mrmr_env( data_type type ): data_uint8( nullptr ), data_uint16( nullptr ), data_int32( nullptr ), type( type ),
-            results_size( 0 ), ranks( nullptr ), entropy( nullptr ), 
-            mutual_information( nullptr ), score( nullptr ),  error( "" )
-    { }
+    // start of each ranking in the results above, one more than the number of rankings
+    int num_offsets;
+    int * offsets;
 
-    void init_data() {
-        switch ( type )
-        {
-        case uint8_type:
-            data_uint8 = new dataset< uint8_t >();
-            break;
-
-        case uint16_type:
-            data_uint16 = new dataset< uint16_t >();
-            break;
-
-        case int32_type:
-            data_int32 = new dataset< int32_t >();
-            break;
-
-        default: 
-            throw std::invalid_argument("invalid data type specified");
-        }
-    }
-
-    std::size_t num_attributes() {
-        switch ( type )
-        {
-        case uint8_type:
-            return data_uint8 ? data_uint8->num_attributes() : 0;
+    std::string error;
 
-        case uint16_type:
-            return data_uint16 ? data_uint16->num_attributes() : 0;
+    // statistics of the last perform_mrmr, perform_mrmr_batch or selection so far, as JSON
+    std::string stats;
 
-        case int32_type:
-            return data_int32 ? data_int32->num_attributes() : 0;
+    // pairwise mutual information kept across perform_mrmr calls until the data changes
+    mi_cache cache;
 
-        default: 
-            throw std::invalid_argument("invalid data type specified");
-        }
-    }
+    // whether perform_mrmr and start_selection rescore every candidate, only those whose bound may win, or
+    // only those whose score estimated on a sample of the rows may win
+    mrmr_evaluation_type evaluation;
 
-    bool has_data() {
-        switch ( type )
-        {
-        case uint8_type:
-            return !! data_uint8;
+    // rows sampled evaluation estimates on, and the score by which it may miss the best candidate
+    std::size_t sample_rows;
+    double tolerance;
 
-        case uint16_type:
-            return !! data_uint16;
+    // selection continued by extend_selection
+    mrmr_selector< int32_t > * selector;
 
-        case int32_type:
-            return !! data_int32;
+    // rows sampled for the selection above, which it reads until it is deleted
+    dataset< int32_t > * sample;
 
-        default: 
-            throw std::invalid_argument("invalid data type specified");
-        }
+    mrmr_env(): data( nullptr ), results_size( 0 ), results( nullptr ), rank( nullptr ), index( nullptr ), entropy( nullptr ),
+            mutual_information( nullptr ), score( nullptr ), num_offsets( 0 ), offsets( nullptr ), error( "" ), stats( "" ),
+            evaluation( mrmr_evaluation_type::EXHAUSTIVE ), sample_rows( 1 << 16 ), tolerance( 0.0 ),
+            selector( nullptr ), sample( nullptr )
+    { }
 
+    void init_data() {
+        data = new dataset< int32_t >();
     }
 
-    void clear_results() {
-        if( ranks ) {
-            for ( int i = 0; i < results_size; i++ )
-                delete ranks[i];
-
-            delete [] ranks;
-        }
+    std::size_t num_attributes() {
+        return data ? data->num_attributes() : 0;
+    }
 
-        if( entropy )
-            delete [] entropy;
+    bool has_data() {
+        return !! data;
+    }
 
-        if( mutual_information )
-            delete [] mutual_information;
+    void clear_results() {
+        if( results )
+            delete [] results;
 
-        if( score )
-            delete [] score;
+        if( offsets )
+            delete [] offsets;
 
-        ranks = nullptr;
+        names.clear();
+        ranks.clear();
+        results = nullptr;
+        rank = nullptr;
+        index = nullptr;
         entropy = nullptr;
         mutual_information = nullptr;
         score = nullptr;
+        offsets = nullptr;
+        num_offsets = 0;
         results_size = 0;
     }
 
-    ~mrmr_env() {
-        clear_results();
+    bool has_selector() {
+        return !! selector;
+    }
+
+    void clear_selector() {
+        if( selector )
+            delete selector;
+
+        if( sample )
+            delete sample;
 
-        if( data_uint8 ) 
-            delete data_uint8;
+        selector = nullptr;
+        sample = nullptr;
+    }
 
-        if( data_uint16 )
-            delete data_uint16;
+    ~mrmr_env() {
+        clear_results();
+        clear_selector();
 
-        if( data_int32 )
-            delete data_int32;
+        if( data )
+            delete data;
 
-        data_uint8 = nullptr;
-        data_uint16 = nullptr;
-        data_int32 = nullptr;
+        data = nullptr;
     }
 };
 
 extern "C" {
 	DLL_EXPORT void * setup_mrmr(data_type type);
+	DLL_EXPORT int reserve_dataset(void * env, std::size_t num_attributes, std::size_t num_instances);
 	DLL_EXPORT int add_attribute_uint8(void * env, const char * name, uint8_t * data, std::size_t length);
 	DLL_EXPORT int add_attribute_uint16(void * env, const char * name, uint16_t * data, std::size_t length);
 	DLL_EXPORT int add_attribute_int32(void *env, const char * name, int32_t * data, std::size_t length);
-	DLL_EXPORT int perform_mrmr(void * env, mrmr_method_type method, unsigned int label, unsigned int num_features);
+	DLL_EXPORT int add_attributes(void * env, const char ** names, const void * data, data_type type, std::size_t num_instances,
+			std::size_t num_attributes, std::ptrdiff_t instance_stride, std::ptrdiff_t attribute_stride, unsigned int num_threads);
+	DLL_EXPORT int perform_mrmr(void * env, mrmr_method_type method, unsigned int label, unsigned int num_features, unsigned int num_threads);
+	DLL_EXPORT int perform_mrmr_batch(void * env, mrmr_method_type method, const unsigned int * labels, unsigned int num_labels, unsigned int num_features, unsigned int num_threads);
+	DLL_EXPORT const int * get_result_offsets(void * env, int * num);
+	DLL_EXPORT int start_selection(void * env, mrmr_method_type method, unsigned int label, unsigned int num_threads);
+	DLL_EXPORT int extend_selection(void * env, unsigned int num_features);
+	DLL_EXPORT const char * get_results(void * env, int * num);
 	DLL_EXPORT const char ** get_feature_ranks(void * env, int * num);
 	DLL_EXPORT double * get_entropy(void * env, int * num);
 	DLL_EXPORT double * get_mutual_information(void * env, int * num);
 	DLL_EXPORT double * get_mrmr_score(void * env, int * num);
+	DLL_EXPORT void set_mi_cache_limit(void * env, std::size_t max_bytes);
+	DLL_EXPORT void set_evaluation(void * env, mrmr_evaluation_type evaluation);
+	DLL_EXPORT void set_sampling(void * env, std::size_t sample_rows, double tolerance);
+	DLL_EXPORT void get_mi_cache_stats(void * env, uint64_t * hits, uint64_t * misses, std::size_t * entries, std::size_t * bytes);
+	DLL_EXPORT const char * get_stats(void * env);
 	DLL_EXPORT const char * get_last_error(void * env);
 	DLL_EXPORT void destroy_mrmr(void * env);
 }
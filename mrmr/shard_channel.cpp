@@ -0,0 +1,212 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "shard_channel.hpp"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+void connection_error( char const * message ) {
+	std::cerr << "error: shard connection " << message << "\n";
+	exit( 2 );
+}
+
+#ifdef _WIN32
+long read_some( int fd, void * data, std::size_t size ) {
+	return _read( fd, data, static_cast<unsigned>( size ) );
+}
+
+long write_some( int fd, void const * data, std::size_t size ) {
+	return _write( fd, data, static_cast<unsigned>( size ) );
+}
+#else
+long read_some( int fd, void * data, std::size_t size ) {
+	ssize_t count;
+	do {
+		count = ::read( fd, data, size );
+	} while( count < 0 && errno == EINTR );
+	return static_cast<long>( count );
+}
+
+long write_some( int fd, void const * data, std::size_t size ) {
+	ssize_t count;
+	do {
+		count = ::write( fd, data, size );
+	} while( count < 0 && errno == EINTR );
+	return static_cast<long>( count );
+}
+#endif
+
+void write_all( int fd, char const * data, std::size_t size ) {
+	while( size > 0 ) {
+		long count = write_some( fd, data, size );
+		if( count <= 0 ) {
+			connection_error( "closed while writing" );
+		}
+		data += count;
+		size -= static_cast<std::size_t>( count );
+	}
+}
+
+}
+
+shard_channel::shard_channel( int in_fd, int out_fd ) : _in( in_fd ), _out( out_fd ), _pid( -1 ), _read_buffer( buffer_size ),
+		_read_first( 0 ), _read_last( 0 ) {
+	_write_buffer.reserve( buffer_size );
+}
+
+shard_channel::~shard_channel() {
+	close();
+}
+
+#ifdef _WIN32
+
+shard_channel * shard_channel::spawn( std::vector<std::string> const & ) {
+	std::cerr << "error: shard workers cannot be started on this platform\n";
+	exit( 2 );
+}
+
+#else
+
+shard_channel * shard_channel::spawn( std::vector<std::string> const & command ) {
+	// a worker that dies is reported when writing to it rather than ending the coordinator
+	std::signal( SIGPIPE, SIG_IGN );
+
+	int to_worker[ 2 ];
+	int from_worker[ 2 ];
+	if( command.empty() || pipe( to_worker ) != 0 || pipe( from_worker ) != 0 ) {
+		connection_error( "could not be created" );
+	}
+	// workers started later must not inherit this worker's ends
+	fcntl( to_worker[ 1 ], F_SETFD, FD_CLOEXEC );
+	fcntl( from_worker[ 0 ], F_SETFD, FD_CLOEXEC );
+
+	pid_t pid = fork();
+	if( pid < 0 ) {
+		connection_error( "could not start a worker" );
+	}
+	if( pid == 0 ) {
+		dup2( to_worker[ 0 ], STDIN_FILENO );
+		dup2( from_worker[ 1 ], STDOUT_FILENO );
+		::close( to_worker[ 0 ] );
+		::close( to_worker[ 1 ] );
+		::close( from_worker[ 0 ] );
+		::close( from_worker[ 1 ] );
+		std::vector<char *> argv;
+		for( auto & argument : command ) {
+			argv.push_back( const_cast<char *>( argument.c_str() ) );
+		}
+		argv.push_back( nullptr );
+		execvp( argv[ 0 ], argv.data() );
+		std::cerr << "error: cannot run shard worker " << command[ 0 ] << ": " << std::strerror( errno ) << "\n";
+		_exit( 127 );
+	}
+	::close( to_worker[ 0 ] );
+	::close( from_worker[ 1 ] );
+
+	shard_channel * channel = new shard_channel( from_worker[ 0 ], to_worker[ 1 ] );
+	channel->_pid = static_cast<long>( pid );
+	return channel;
+}
+
+#endif
+
+void shard_channel::write( void const * data, std::size_t size ) {
+	char const * bytes = static_cast<char const *>( data );
+	if( _write_buffer.size() + size > buffer_size ) {
+		flush();
+	}
+	if( size > buffer_size ) {
+		write_all( _out, bytes, size );
+		return;
+	}
+	_write_buffer.insert( _write_buffer.end(), bytes, bytes + size );
+}
+
+void shard_channel::write_string( std::string const & value ) {
+	write_value<std::uint64_t>( value.size() );
+	write( value.data(), value.size() );
+}
+
+void shard_channel::flush() {
+	if( ! _write_buffer.empty() ) {
+		write_all( _out, _write_buffer.data(), _write_buffer.size() );
+		_write_buffer.clear();
+	}
+}
+
+void shard_channel::read( void * data, std::size_t size ) {
+	char * bytes = static_cast<char *>( data );
+	while( size > 0 ) {
+		if( _read_first == _read_last ) {
+			long count = read_some( _in, _read_buffer.data(), _read_buffer.size() );
+			if( count <= 0 ) {
+				connection_error( "closed while reading" );
+			}
+			_read_first = 0;
+			_read_last = static_cast<std::size_t>( count );
+		}
+		std::size_t count = std::min( size, _read_last - _read_first );
+		std::memcpy( bytes, _read_buffer.data() + _read_first, count );
+		_read_first += count;
+		bytes += count;
+		size -= count;
+	}
+}
+
+std::string shard_channel::read_string() {
+	std::string value( read_value<std::uint64_t>(), '\0' );
+	read( &value[ 0 ], value.size() );
+	return value;
+}
+
+void shard_channel::close() {
+	if( _out >= 0 ) {
+		flush();
+	}
+	if( _pid < 0 ) {
+		// descriptors of a worker's own standard streams are left to the process
+		_in = _out = -1;
+		return;
+	}
+#ifndef _WIN32
+	::close( _in );
+	::close( _out );
+	int status;
+	while( waitpid( static_cast<pid_t>( _pid ), &status, 0 ) < 0 && errno == EINTR ) {
+	}
+#endif
+	_in = _out = -1;
+	_pid = -1;
+}
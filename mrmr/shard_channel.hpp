@@ -0,0 +1,99 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MRMR_SHARD_CHANNEL_HPP
+#define MRMR_SHARD_CHANNEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Buffered byte stream between a shard coordinator and one worker process, made of a
+ * descriptor to read from and one to write to. Workers talk over their standard input
+ * and output, so any command that relays those, such as ssh, can run a worker on another
+ * machine. Values are sent in the byte order of the machine, which both ends must share.
+ * A broken or closed connection is reported on standard error and the program exits.
+ */
+class shard_channel {
+	public:
+		shard_channel( int in_fd, int out_fd );
+		shard_channel( shard_channel const & ) = delete;
+		shard_channel & operator=( shard_channel const & ) = delete;
+		~shard_channel();
+
+		/* Starts command with its standard input and output connected to a new channel. */
+		static shard_channel * spawn( std::vector<std::string> const & command );
+
+		void write( void const * data, std::size_t size );
+		void write_string( std::string const & value );
+		void flush();
+		void read( void * data, std::size_t size );
+		std::string read_string();
+		template <typename U> void write_value( U value );
+		template <typename U> U read_value();
+
+		/* Flushes and closes both descriptors, then waits for a spawned worker to exit. */
+		void close();
+
+		static const std::size_t buffer_size = 1 << 16;
+
+	private:
+		int _in;
+		int _out;
+		long _pid;
+		std::vector<char> _write_buffer;
+		std::vector<char> _read_buffer;
+		std::size_t _read_first;
+		std::size_t _read_last;
+};
+
+/* Messages of the shard protocol, each a request code followed by its arguments. */
+namespace shard_protocol {
+	/* Sent by a worker once its shard is read, ahead of the summary of its attributes. */
+	const std::uint32_t hello = 0x4d524d52;
+
+	enum request : std::uint32_t {
+		QUIT = 0,
+		JOINT_COUNTS = 1
+	};
+
+	/* One nonzero cell of a joint count table, by the codes local to the worker. */
+	struct cell {
+		std::uint32_t code1;
+		std::uint32_t code2;
+		std::uint64_t count;
+	};
+}
+
+template <typename U>
+void shard_channel::write_value( U value ) {
+	write( &value, sizeof( value ) );
+}
+
+template <typename U>
+U shard_channel::read_value() {
+	U value;
+	read( &value, sizeof( value ) );
+	return value;
+}
+
+#endif
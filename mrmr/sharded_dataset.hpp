@@ -0,0 +1,423 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MRMR_SHARDED_DATASET_HPP
+#define MRMR_SHARDED_DATASET_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "attribute_information.hpp"
+#include "dataset.hpp"
+#include "kernels.hpp"
+#include "shard_channel.hpp"
+#include "stats.hpp"
+#include "thread_pool.hpp"
+#include "typedef.hpp"
+
+/*
+ * Dataset whose rows are split into shards, each held by a worker process serving it with
+ * serve_shard. The coordinator keeps only the attribute summaries, merged from those of
+ * the shards. Every joint table is counted by the workers over their own rows and the
+ * counts summed here, so the mutual information is that of a dataset holding all the rows,
+ * and bit for bit the same wherever the merged table is a flat one. This is the part of
+ * the dataset interface mrmr() uses.
+ *
+ * A request goes to every worker before any reply is read, so the shards are counted in
+ * parallel. Calls from several threads at once are served one after another.
+ */
+template <typename T>
+class sharded_dataset {
+	public:
+		using value_type = T;
+
+		explicit sharded_dataset( std::vector<std::unique_ptr<shard_channel> > shards );
+		sharded_dataset( sharded_dataset const & ) = delete;
+		sharded_dataset & operator=( sharded_dataset const & ) = delete;
+		~sharded_dataset();
+
+		std::size_t num_shards() const;
+		std::size_t num_instances() const;
+		std::size_t num_attributes() const;
+		std::string attribute_name( std::size_t attribute_num ) const;
+		double attribute_entropy( std::size_t attribute_num ) const;
+		attribute_information<T> const & attribute_info( std::size_t attribute_num ) const;
+		double mutual_information( std::size_t attribute1, std::size_t attribute2 ) const;
+		void mutual_information_many( std::size_t anchor, std::size_t const * candidates, std::size_t num_candidates, double * out ) const;
+		void mutual_information_table( std::size_t const * anchors, std::size_t num_anchors, std::size_t const * candidates, std::size_t num_candidates,
+				double * out ) const;
+		std::size_t histogram_budget() const;
+		void set_histogram_budget( std::size_t bytes );
+
+	private:
+		bool is_dense( std::size_t attribute1, std::size_t attribute2 ) const;
+		double merged_mutual_information( std::size_t attribute1, std::size_t attribute2 ) const;
+		static void shard_error( std::size_t shard_num, char const * message );
+
+		std::vector<std::unique_ptr<shard_channel> > _shards;
+		std::vector<std::string> _names;
+		std::vector<attribute_information<T> > _attr_info;
+		// merged code of each code local to a shard, by shard and attribute
+		std::vector<std::vector<std::vector<std::uint32_t> > > _codes;
+		std::size_t _num_instances;
+		std::size_t _histogram_budget;
+		mutable std::mutex _mutex;
+		mutable std::vector<std::uint32_t> _counts;
+		mutable std::vector<shard_protocol::cell> _cells;
+};
+
+/*
+ * Answers the requests of a sharded_dataset coordinator over channel until told to quit,
+ * starting with the summary of every attribute of data. The joint tables of a request are
+ * counted on num_threads threads and sent as their nonzero cells.
+ */
+template <typename T>
+void serve_shard( dataset<T> const & data, shard_channel & channel, std::size_t num_threads = 1 );
+
+/* Receives the summaries of all shards and merges them into those of the whole dataset. */
+template <typename T>
+sharded_dataset<T>::sharded_dataset( std::vector<std::unique_ptr<shard_channel> > shards ) : _shards( std::move( shards ) ), _num_instances( 0 ),
+		_histogram_budget( dataset<T>::default_histogram_budget ) {
+	std::vector<std::vector<std::vector<std::int64_t> > > shard_values( _shards.size() );
+	std::vector<std::vector<std::vector<std::uint64_t> > > shard_counts( _shards.size() );
+	for( std::size_t s = 0; s < _shards.size(); ++s ) {
+		shard_channel & channel = *_shards[ s ];
+		if( channel.read_value<std::uint32_t>() != shard_protocol::hello ) {
+			shard_error( s, "did not answer as a shard worker" );
+		}
+		std::size_t num_attributes = channel.read_value<std::uint64_t>();
+		_num_instances += channel.read_value<std::uint64_t>();
+		std::vector<std::string> names( num_attributes );
+		for( auto & name : names ) {
+			name = channel.read_string();
+		}
+		if( s == 0 ) {
+			_names = std::move( names );
+		} else if( names != _names ) {
+			shard_error( s, "has different attributes from the first shard" );
+		}
+		shard_values[ s ].resize( num_attributes );
+		shard_counts[ s ].resize( num_attributes );
+		for( std::size_t attribute_num = 0; attribute_num < num_attributes; ++attribute_num ) {
+			std::size_t num_values = channel.read_value<std::uint64_t>();
+			shard_values[ s ][ attribute_num ].resize( num_values );
+			shard_counts[ s ][ attribute_num ].resize( num_values );
+			channel.read( shard_values[ s ][ attribute_num ].data(), num_values * sizeof( std::int64_t ) );
+			channel.read( shard_counts[ s ][ attribute_num ].data(), num_values * sizeof( std::uint64_t ) );
+		}
+	}
+
+	// merge the sorted values of each attribute and map every shard's codes to the merged ones
+	_attr_info.resize( _names.size() );
+	_codes.assign( _shards.size(), std::vector<std::vector<std::uint32_t> >( _names.size() ) );
+	for( std::size_t attribute_num = 0; attribute_num < _names.size(); ++attribute_num ) {
+		std::vector<std::pair<std::int64_t, std::uint64_t> > merged;
+		for( std::size_t s = 0; s < _shards.size(); ++s ) {
+			for( std::size_t code = 0; code < shard_values[ s ][ attribute_num ].size(); ++code ) {
+				merged.emplace_back( shard_values[ s ][ attribute_num ][ code ], shard_counts[ s ][ attribute_num ][ code ] );
+			}
+		}
+		std::sort( merged.begin(), merged.end() );
+		std::vector<std::int64_t> merged_values;
+		std::vector<T> values;
+		std::vector<std::size_t> counts;
+		for( auto & entry : merged ) {
+			if( merged_values.empty() || merged_values.back() != entry.first ) {
+				merged_values.push_back( entry.first );
+				values.push_back( static_cast<T>( entry.first ) );
+				counts.push_back( 0 );
+			}
+			counts.back() += static_cast<std::size_t>( entry.second );
+		}
+		for( std::size_t s = 0; s < _shards.size(); ++s ) {
+			for( auto value : shard_values[ s ][ attribute_num ] ) {
+				_codes[ s ][ attribute_num ].push_back( static_cast<std::uint32_t>(
+						std::lower_bound( merged_values.begin(), merged_values.end(), value ) - merged_values.begin() ) );
+			}
+		}
+		_attr_info[ attribute_num ] = attribute_information<T>( std::move( values ), std::move( counts ) );
+	}
+}
+
+template <typename T>
+sharded_dataset<T>::~sharded_dataset() {
+	for( auto & channel : _shards ) {
+		channel->write_value<std::uint32_t>( shard_protocol::QUIT );
+		channel->close();
+	}
+}
+
+template <typename T>
+std::size_t sharded_dataset<T>::num_shards() const {
+	return _shards.size();
+}
+
+template <typename T>
+std::size_t sharded_dataset<T>::num_instances() const {
+	return _num_instances;
+}
+
+template <typename T>
+std::size_t sharded_dataset<T>::num_attributes() const {
+	return _names.size();
+}
+
+template <typename T>
+std::string sharded_dataset<T>::attribute_name( std::size_t attribute_num ) const {
+	return _names[ attribute_num ];
+}
+
+template <typename T>
+double sharded_dataset<T>::attribute_entropy( std::size_t attribute_num ) const {
+	return _attr_info[ attribute_num ].entropy();
+}
+
+template <typename T>
+attribute_information<T> const & sharded_dataset<T>::attribute_info( std::size_t attribute_num ) const {
+	return _attr_info[ attribute_num ];
+}
+
+template <typename T>
+std::size_t sharded_dataset<T>::histogram_budget() const {
+	return _histogram_budget;
+}
+
+template <typename T>
+void sharded_dataset<T>::set_histogram_budget( std::size_t bytes ) {
+	_histogram_budget = bytes;
+}
+
+template <typename T>
+double sharded_dataset<T>::mutual_information( std::size_t attribute1, std::size_t attribute2 ) const {
+	double mutual_information;
+	mutual_information_table( &attribute1, 1, &attribute2, 1, &mutual_information );
+	return mutual_information;
+}
+
+template <typename T>
+void sharded_dataset<T>::mutual_information_many( std::size_t anchor, std::size_t const * candidates, std::size_t num_candidates, double * out ) const {
+	mutual_information_table( &anchor, 1, candidates, num_candidates, out );
+}
+
+/* Mutual information between every anchor and every candidate, written to out[ a * num_candidates + c ]. */
+template <typename T>
+void sharded_dataset<T>::mutual_information_table( std::size_t const * anchors, std::size_t num_anchors, std::size_t const * candidates,
+		std::size_t num_candidates, double * out ) const {
+	if( num_anchors == 0 || num_candidates == 0 ) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock( _mutex );
+	for( auto & channel : _shards ) {
+		channel->write_value<std::uint32_t>( shard_protocol::JOINT_COUNTS );
+		channel->write_value<std::uint64_t>( num_anchors );
+		for( std::size_t a = 0; a < num_anchors; ++a ) {
+			channel->write_value<std::uint64_t>( anchors[ a ] );
+		}
+		channel->write_value<std::uint64_t>( num_candidates );
+		for( std::size_t c = 0; c < num_candidates; ++c ) {
+			channel->write_value<std::uint64_t>( candidates[ c ] );
+		}
+		channel->flush();
+	}
+	// the tables come back in the order requested, so each is merged as soon as every shard has sent it
+	for( std::size_t a = 0; a < num_anchors; ++a ) {
+		for( std::size_t c = 0; c < num_candidates; ++c ) {
+			out[ a * num_candidates + c ] = merged_mutual_information( anchors[ a ], candidates[ c ] );
+		}
+	}
+}
+
+template <typename T>
+bool sharded_dataset<T>::is_dense( std::size_t attribute1, std::size_t attribute2 ) const {
+	return _num_instances <= std::numeric_limits<std::uint32_t>::max()
+		&& _attr_info[ attribute1 ].num_values() <= _histogram_budget / sizeof( std::uint32_t ) / _attr_info[ attribute2 ].num_values();
+}
+
+/*
+ * Reads the next joint table from every shard and returns the mutual information of the
+ * summed counts, computed as dataset does for a table of the same size.
+ */
+template <typename T>
+double sharded_dataset<T>::merged_mutual_information( std::size_t attribute1, std::size_t attribute2 ) const {
+	std::size_t const a1_num_values = _attr_info.at( attribute1 ).num_values();
+	std::size_t const a2_num_values = _attr_info.at( attribute2 ).num_values();
+	bool const degenerate = a1_num_values <= 1 || a2_num_values <= 1;
+	bool const dense = ! degenerate && is_dense( attribute1, attribute2 );
+
+	std::unordered_map<std::size_t, std::size_t> joint_counts;
+	if( dense ) {
+		_counts.assign( a1_num_values * a2_num_values, 0 );
+	}
+	for( std::size_t s = 0; s < _shards.size(); ++s ) {
+		_cells.resize( _shards[ s ]->read_value<std::uint64_t>() );
+		_shards[ s ]->read( _cells.data(), _cells.size() * sizeof( shard_protocol::cell ) );
+		if( degenerate ) {
+			continue;
+		}
+		std::vector<std::uint32_t> const & codes1 = _codes[ s ][ attribute1 ];
+		std::vector<std::uint32_t> const & codes2 = _codes[ s ][ attribute2 ];
+		for( auto & cell : _cells ) {
+			if( cell.code1 >= codes1.size() || cell.code2 >= codes2.size() ) {
+				shard_error( s, "sent a count for a value it does not have" );
+			}
+			std::size_t merged_cell = static_cast<std::size_t>( codes1[ cell.code1 ] ) * a2_num_values + codes2[ cell.code2 ];
+			if( dense ) {
+				_counts[ merged_cell ] += static_cast<std::uint32_t>( cell.count );
+			} else {
+				joint_counts[ merged_cell ] += static_cast<std::size_t>( cell.count );
+			}
+		}
+	}
+	// the shards scanned every row between them
+	statistics::get()->count_mutual_information( 1 );
+	if( degenerate ) {
+		return 0.0;
+	}
+	statistics::get()->count_scan( _num_instances, dense ? _counts.size() : joint_counts.size() );
+
+	std::vector<probability> const & a1_probabilities = _attr_info[ attribute1 ].probabilities();
+	std::vector<probability> const & a2_probabilities = _attr_info[ attribute2 ].probabilities();
+	double const n = static_cast<double>( _num_instances );
+	if( dense ) {
+		return active_kernels().mutual_information( _counts.data(), a1_probabilities.data(), a1_num_values, a2_probabilities.data(), a2_num_values, n );
+	}
+	double mutual_information = 0.0;
+	for( auto & entry : joint_counts ) {
+		probability joint_probability = entry.second / n;
+		probability marginal_probability_i = a1_probabilities[ entry.first / a2_num_values ];
+		probability marginal_probability_j = a2_probabilities[ entry.first % a2_num_values ];
+		mutual_information += joint_probability * std::log2( joint_probability / ( marginal_probability_i * marginal_probability_j ) );
+	}
+	return mutual_information;
+}
+
+template <typename T>
+void sharded_dataset<T>::shard_error( std::size_t shard_num, char const * message ) {
+	std::cerr << "error: shard " << shard_num + 1 << " " << message << "\n";
+	exit( 2 );
+}
+
+template <typename T>
+void serve_shard( dataset<T> const & data, shard_channel & channel, std::size_t num_threads ) {
+	channel.write_value<std::uint32_t>( shard_protocol::hello );
+	channel.write_value<std::uint64_t>( data.num_attributes() );
+	channel.write_value<std::uint64_t>( data.num_instances() );
+	for( std::size_t attribute_num = 0; attribute_num < data.num_attributes(); ++attribute_num ) {
+		channel.write_string( data.attribute_name( attribute_num ) );
+	}
+	for( std::size_t attribute_num = 0; attribute_num < data.num_attributes(); ++attribute_num ) {
+		attribute_information<T> const & info = data.attribute_info( attribute_num );
+		channel.write_value<std::uint64_t>( info.num_values() );
+		for( auto value : info.values() ) {
+			channel.write_value<std::int64_t>( value );
+		}
+		for( auto count : info.counts() ) {
+			channel.write_value<std::uint64_t>( count );
+		}
+	}
+	channel.flush();
+
+	thread_pool pool( num_threads );
+	std::vector<std::size_t> anchors;
+	std::vector<std::size_t> candidates;
+	std::vector<std::vector<shard_protocol::cell> > tables;
+	while( true ) {
+		std::uint32_t request = channel.read_value<std::uint32_t>();
+		if( request == shard_protocol::QUIT ) {
+			return;
+		}
+		if( request != shard_protocol::JOINT_COUNTS ) {
+			std::cerr << "error: unknown shard request " << request << "\n";
+			exit( 2 );
+		}
+		anchors.resize( channel.read_value<std::uint64_t>() );
+		for( auto & anchor : anchors ) {
+			anchor = channel.read_value<std::uint64_t>();
+		}
+		candidates.resize( channel.read_value<std::uint64_t>() );
+		for( auto & candidate : candidates ) {
+			candidate = channel.read_value<std::uint64_t>();
+		}
+		for( auto attribute_num : anchors ) {
+			if( attribute_num >= data.num_attributes() ) {
+				std::cerr << "error: shard request for attribute " << attribute_num << " out of range\n";
+				exit( 2 );
+			}
+		}
+		for( auto attribute_num : candidates ) {
+			if( attribute_num >= data.num_attributes() ) {
+				std::cerr << "error: shard request for attribute " << attribute_num << " out of range\n";
+				exit( 2 );
+			}
+		}
+
+		std::size_t const num_candidates = candidates.size();
+		tables.assign( anchors.size() * num_candidates, std::vector<shard_protocol::cell>() );
+		std::size_t grain = num_candidates / ( 4 * pool.num_threads() ) + 1;
+		pool.parallel_for( 0, num_candidates, grain, [&]( std::size_t begin, std::size_t end, std::size_t ) {
+			data.joint_count_tables( anchors.data(), anchors.size(), &candidates[ begin ], end - begin,
+					[&]( std::size_t a, std::size_t c, std::uint32_t const * counts ) {
+				std::size_t const anchor = anchors[ a ];
+				std::size_t const candidate = candidates[ begin + c ];
+				std::vector<shard_protocol::cell> & cells = tables[ a * num_candidates + begin + c ];
+				if( counts != nullptr ) {
+					std::size_t const a1_num_values = data.attribute_info( anchor ).num_values();
+					std::size_t const a2_num_values = data.attribute_info( candidate ).num_values();
+					for( std::size_t c1 = 0; c1 < a1_num_values; ++c1 ) {
+						for( std::size_t c2 = 0; c2 < a2_num_values; ++c2 ) {
+							if( counts[ c1 * a2_num_values + c2 ] > 0 ) {
+								cells.push_back( shard_protocol::cell{ static_cast<std::uint32_t>( c1 ), static_cast<std::uint32_t>( c2 ),
+										counts[ c1 * a2_num_values + c2 ] } );
+							}
+						}
+					}
+					return;
+				}
+				// tables the dataset does not keep flat, including those of single valued attributes
+				std::unordered_map<std::uint64_t, std::uint64_t> sparse_counts;
+				for( std::size_t i = 0; i < data.num_instances(); ++i ) {
+					++sparse_counts[ ( static_cast<std::uint64_t>( data.columns().get( anchor, i ) ) << 32 ) | data.columns().get( candidate, i ) ];
+				}
+				for( auto & entry : sparse_counts ) {
+					cells.push_back( shard_protocol::cell{ static_cast<std::uint32_t>( entry.first >> 32 ), static_cast<std::uint32_t>( entry.first ),
+							entry.second } );
+				}
+			} );
+		} );
+
+		for( auto & cells : tables ) {
+			channel.write_value<std::uint64_t>( cells.size() );
+			channel.write( cells.data(), cells.size() * sizeof( shard_protocol::cell ) );
+		}
+		channel.flush();
+	}
+}
+
+#endif
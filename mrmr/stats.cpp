@@ -0,0 +1,224 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include "stats.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#ifdef _MSC_VER
+#pragma comment( lib, "psapi.lib" )
+#endif
+#else
+#include <sys/resource.h>
+#include <sys/time.h>
+#endif
+
+namespace {
+
+std::size_t const no_parent = std::numeric_limits<std::size_t>::max();
+
+// phases open on this thread, innermost last, and the run they belong to
+struct open_phases {
+	std::uint64_t run = 0;
+	std::vector<std::size_t> phases;
+};
+thread_local open_phases thread_open;
+
+double seconds_since( std::chrono::steady_clock::time_point start ) {
+	return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+}
+
+void write_counters( std::ostream & os, std::uint64_t mutual_information_calls, std::uint64_t rows_scanned, std::uint64_t histogram_cells ) {
+	os << "\"mutual_information_calls\": " << mutual_information_calls << ", \"rows_scanned\": " << rows_scanned
+			<< ", \"histogram_cells\": " << histogram_cells;
+}
+
+}
+
+statistics::statistics() : _mutual_information_calls( 0 ), _rows_scanned( 0 ), _histogram_cells( 0 ), _run( 0 ) {
+	reset();
+}
+
+statistics * statistics::get() {
+	// workers count from the first call on, so construction must be thread safe
+	static statistics instance;
+	return &instance;
+}
+
+/* Clears counters and phases and restarts the clocks of the run. */
+void statistics::reset() {
+	std::lock_guard<std::mutex> lock( _mutex );
+	_mutual_information_calls = 0;
+	_rows_scanned = 0;
+	_histogram_cells = 0;
+	_wall_start = std::chrono::steady_clock::now();
+	_cpu_start = cpu_seconds();
+	_phases.clear();
+	// phases still open on any thread belong to the run before
+	++_run;
+}
+
+/* Starts a phase inside the innermost phase still open on this thread. */
+void statistics::begin_phase( char const * name ) {
+	std::lock_guard<std::mutex> lock( _mutex );
+	if( thread_open.run != _run ) {
+		thread_open.run = _run;
+		thread_open.phases.clear();
+	}
+	phase p;
+	p.name = name;
+	p.parent = thread_open.phases.empty() ? no_parent : thread_open.phases.back();
+	p.wall_start = std::chrono::steady_clock::now();
+	p.cpu_start = cpu_seconds();
+	p.wall_seconds = 0.0;
+	p.cpu_seconds = 0.0;
+	p.mutual_information_calls = mutual_information_calls();
+	p.rows_scanned = rows_scanned();
+	p.histogram_cells = histogram_cells();
+	p.open = true;
+	thread_open.phases.push_back( _phases.size() );
+	_phases.push_back( p );
+}
+
+/* Ends the innermost phase open on this thread, keeping its times and what the counters gained in it. */
+void statistics::end_phase() {
+	std::lock_guard<std::mutex> lock( _mutex );
+	if( thread_open.run != _run || thread_open.phases.empty() ) {
+		thread_open.phases.clear();
+		return;
+	}
+	phase & p = _phases[ thread_open.phases.back() ];
+	thread_open.phases.pop_back();
+	p.open = false;
+	p.wall_seconds = seconds_since( p.wall_start );
+	p.cpu_seconds = cpu_seconds() - p.cpu_start;
+	p.mutual_information_calls = mutual_information_calls() - p.mutual_information_calls;
+	p.rows_scanned = rows_scanned() - p.rows_scanned;
+	p.histogram_cells = histogram_cells() - p.histogram_cells;
+}
+
+std::uint64_t statistics::mutual_information_calls() const {
+	return _mutual_information_calls.load( std::memory_order_relaxed );
+}
+
+std::uint64_t statistics::rows_scanned() const {
+	return _rows_scanned.load( std::memory_order_relaxed );
+}
+
+std::uint64_t statistics::histogram_cells() const {
+	return _histogram_cells.load( std::memory_order_relaxed );
+}
+
+/*
+ * Writes the run as one JSON object: totals, counters, peak resident set size and the
+ * tree of phases. Phases still open are written with the times they have so far.
+ */
+void statistics::write_json( std::ostream & os ) const {
+	std::lock_guard<std::mutex> lock( _mutex );
+	std::ios_base::fmtflags flags = os.flags();
+	std::streamsize precision = os.precision();
+	os << std::defaultfloat << std::setprecision( 9 );
+	os << "{\n  \"wall_seconds\": " << seconds_since( _wall_start ) << ", \"cpu_seconds\": " << cpu_seconds() - _cpu_start
+			<< ", \"peak_rss_bytes\": " << peak_rss_bytes() << ",\n  ";
+	write_counters( os, mutual_information_calls(), rows_scanned(), histogram_cells() );
+	os << ",\n  \"phases\": ";
+	write_phases( os, no_parent, 1 );
+	os << "\n}\n";
+	os.flags( flags );
+	os.precision( precision );
+}
+
+std::string statistics::json() const {
+	std::ostringstream os;
+	write_json( os );
+	return os.str();
+}
+
+void statistics::write_phases( std::ostream & os, std::size_t parent, std::size_t depth ) const {
+	std::string indent( 2 * depth, ' ' );
+	bool first = true;
+	os << '[';
+	for( std::size_t i = 0; i < _phases.size(); ++i ) {
+		phase const & p = _phases[ i ];
+		if( p.parent != parent ) {
+			continue;
+		}
+		os << ( first ? "\n" : ",\n" ) << indent << "  { \"name\": \"" << p.name << "\", \"wall_seconds\": "
+				<< ( p.open ? seconds_since( p.wall_start ) : p.wall_seconds ) << ", \"cpu_seconds\": "
+				<< ( p.open ? cpu_seconds() - p.cpu_start : p.cpu_seconds ) << ", ";
+		if( p.open ) {
+			write_counters( os, mutual_information_calls() - p.mutual_information_calls, rows_scanned() - p.rows_scanned,
+					histogram_cells() - p.histogram_cells );
+		} else {
+			write_counters( os, p.mutual_information_calls, p.rows_scanned, p.histogram_cells );
+		}
+		os << ", \"phases\": ";
+		write_phases( os, i, depth + 1 );
+		os << " }";
+		first = false;
+	}
+	os << ( first ? "]" : "\n" + indent + "]" );
+}
+
+/* CPU time used so far by every thread of the process. */
+double statistics::cpu_seconds() {
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if( ! GetProcessTimes( GetCurrentProcess(), &creation, &exit, &kernel, &user ) ) {
+		return 0.0;
+	}
+	auto ticks = []( FILETIME const & t ) {
+		return static_cast<double>( ( static_cast<std::uint64_t>( t.dwHighDateTime ) << 32 ) | t.dwLowDateTime );
+	};
+	return ( ticks( kernel ) + ticks( user ) ) * 1e-7;
+#else
+	struct rusage usage;
+	if( getrusage( RUSAGE_SELF, &usage ) != 0 ) {
+		return 0.0;
+	}
+	return static_cast<double>( usage.ru_utime.tv_sec + usage.ru_stime.tv_sec ) + ( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec ) * 1e-6;
+#endif
+}
+
+/* Largest resident set size of the process so far. */
+std::uint64_t statistics::peak_rss_bytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if( ! GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) ) {
+		return 0;
+	}
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if( getrusage( RUSAGE_SELF, &usage ) != 0 ) {
+		return 0;
+	}
+#ifdef __APPLE__
+	return static_cast<std::uint64_t>( usage.ru_maxrss );
+#else
+	// Linux and the BSDs report kilobytes
+	return static_cast<std::uint64_t>( usage.ru_maxrss ) * 1024;
+#endif
+#endif
+}
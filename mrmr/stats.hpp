@@ -0,0 +1,113 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MRMR_STATS_HPP
+#define MRMR_STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ * Counters of the hot paths and nested timed phases of a run, shared by the whole process.
+ * Counters may be added to from any thread. Phases may be begun and ended on any thread
+ * and nest within the phases open on that thread, so runs driven from several threads at
+ * once keep apart their phases but share the counters. A reset starts a new run for every
+ * thread, and phases left open from before it are ended without being kept.
+ */
+class statistics {
+	public:
+		statistics( statistics const & ) = delete;
+		statistics & operator=( statistics const & ) = delete;
+
+		static statistics * get();
+
+		void reset();
+		void begin_phase( char const * name );
+		void end_phase();
+
+		// mutual information values computed exactly
+		void count_mutual_information( std::uint64_t calls ) {
+			_mutual_information_calls.fetch_add( calls, std::memory_order_relaxed );
+		}
+
+		// rows read to count joint tables and the table cells those counts went to
+		void count_scan( std::uint64_t rows, std::uint64_t cells ) {
+			_rows_scanned.fetch_add( rows, std::memory_order_relaxed );
+			_histogram_cells.fetch_add( cells, std::memory_order_relaxed );
+		}
+
+		std::uint64_t mutual_information_calls() const;
+		std::uint64_t rows_scanned() const;
+		std::uint64_t histogram_cells() const;
+
+		void write_json( std::ostream & os ) const;
+		std::string json() const;
+
+		static double cpu_seconds();
+		static std::uint64_t peak_rss_bytes();
+
+	private:
+		struct phase {
+			std::string name;
+			std::size_t parent;
+			std::chrono::steady_clock::time_point wall_start;
+			double cpu_start;
+			double wall_seconds;
+			double cpu_seconds;
+			std::uint64_t mutual_information_calls;
+			std::uint64_t rows_scanned;
+			std::uint64_t histogram_cells;
+			bool open;
+		};
+
+		statistics();
+		void write_phases( std::ostream & os, std::size_t parent, std::size_t depth ) const;
+
+		std::atomic<std::uint64_t> _mutual_information_calls;
+		std::atomic<std::uint64_t> _rows_scanned;
+		std::atomic<std::uint64_t> _histogram_cells;
+		std::chrono::steady_clock::time_point _wall_start;
+		double _cpu_start;
+		// guards the phases and the start of the run
+		mutable std::mutex _mutex;
+		std::uint64_t _run;
+		std::vector<phase> _phases;
+};
+
+/* Times the enclosing scope as a phase of statistics::get(). */
+class statistics_phase {
+	public:
+		explicit statistics_phase( char const * name ) {
+			statistics::get()->begin_phase( name );
+		}
+		statistics_phase( statistics_phase const & ) = delete;
+		statistics_phase & operator=( statistics_phase const & ) = delete;
+		~statistics_phase() {
+			statistics::get()->end_phase();
+		}
+};
+
+#endif
@@ -0,0 +1,514 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MRMR_STREAMING_DATASET_HPP
+#define MRMR_STREAMING_DATASET_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "attribute_information.hpp"
+#include "dataset.hpp"
+#include "discretizer.hpp"
+#include "kernels.hpp"
+#include "stats.hpp"
+#include "text_parser.hpp"
+#include "thread_pool.hpp"
+#include "typedef.hpp"
+
+/*
+ * Dataset read from a text file that is never held in memory. Only the summary of each
+ * attribute stays resident; every request for mutual information re-reads the file from
+ * the start, a block of text at a time, and counts the joint tables of all the pairs
+ * asked for in that one sequential pass. Requests whose tables would not fit the memory
+ * budget are split over several passes. Each block is parsed and counted on all threads.
+ *
+ * Memory in use is the attribute summaries, the count tables of one pass, at most about
+ * memory_budget, and one block of text with the values of the attributes a pass needs.
+ * The mutual information is bit for bit that of a dataset read from the same file, and
+ * this is the part of the dataset interface mrmr() uses. The file must not change while
+ * the dataset is in use.
+ */
+template <typename T>
+class streaming_dataset {
+	public:
+		using value_type = T;
+		using discretization_method = typename dataset<T>::discretization_method;
+
+		streaming_dataset( std::string const & path, discretization_method dm = dataset<T>::ROUND, std::size_t num_threads = 1,
+				std::size_t memory_budget = default_memory_budget, std::size_t block_bytes = default_block_bytes,
+				binning_options const & binning = binning_options() );
+		streaming_dataset( streaming_dataset const & ) = delete;
+		streaming_dataset & operator=( streaming_dataset const & ) = delete;
+
+		std::size_t num_instances() const;
+		std::size_t num_attributes() const;
+		std::string attribute_name( std::size_t attribute_num ) const;
+		double attribute_entropy( std::size_t attribute_num ) const;
+		attribute_information<T> const & attribute_info( std::size_t attribute_num ) const;
+		double mutual_information( std::size_t attribute1, std::size_t attribute2 ) const;
+		void mutual_information_many( std::size_t anchor, std::size_t const * candidates, std::size_t num_candidates, double * out ) const;
+		void mutual_information_table( std::size_t const * anchors, std::size_t num_anchors, std::size_t const * candidates, std::size_t num_candidates,
+				double * out ) const;
+		std::size_t histogram_budget() const;
+		void set_histogram_budget( std::size_t bytes );
+		std::size_t memory_budget() const;
+
+		/* Passes made over the file so far, including the one that summarized it. */
+		std::size_t num_passes() const;
+
+		static const std::size_t default_memory_budget = std::size_t( 1 ) << 30;
+
+		/* Bytes of text read at a time, a block ending at the last whole row within it. */
+		static const std::size_t default_block_bytes = 1 << 24;
+
+	private:
+		/* Discretizes the chosen attributes of each row of a block into one buffer of values per attribute. */
+		class block_sink : public table_sink {
+			public:
+				block_sink( std::vector<std::size_t> const & attributes, std::size_t num_attributes, discretization_method dm, discretizer const & bins );
+				void begin( std::size_t num_rows, std::size_t num_columns ) override;
+				std::size_t store_row( std::size_t row, double const * values ) override;
+				std::size_t num_rows() const;
+				std::vector<T> const & values( std::size_t i ) const;
+
+			private:
+				std::vector<std::size_t> const & _attributes;
+				std::size_t _num_attributes;
+				discretization_method _dm;
+				discretizer const & _bins;
+				std::size_t _num_rows;
+				std::vector<std::vector<T> > _values;
+		};
+
+		template <typename Function> void read_blocks( Function on_rows ) const;
+		template <typename Function> void scan( std::vector<std::size_t> const & attributes, Function on_block ) const;
+		void count_pass( std::size_t const * anchors, std::size_t num_anchors, std::size_t const * candidates, std::size_t first, std::size_t last,
+				std::size_t num_candidates, double * out ) const;
+		bool is_degenerate( std::size_t attribute1, std::size_t attribute2 ) const;
+		bool is_dense( std::size_t attribute1, std::size_t attribute2 ) const;
+		std::size_t table_bytes( std::size_t attribute1, std::size_t attribute2 ) const;
+		static void file_error( std::string const & path, char const * message );
+
+		std::string _path;
+		discretization_method _dm;
+		discretizer _bins;
+		std::size_t _memory_budget;
+		std::size_t _block_bytes;
+		std::size_t _histogram_budget;
+		std::vector<std::string> _names;
+		std::vector<attribute_information<T> > _attr_info;
+		std::size_t _num_instances;
+		mutable thread_pool _pool;
+		mutable std::mutex _mutex;
+		mutable std::size_t _num_passes;
+};
+
+/*
+ * Reads the header and summarizes every attribute in a first pass over the file, after
+ * a pass fitting the bins of binned attributes if any.
+ */
+template <typename T>
+streaming_dataset<T>::streaming_dataset( std::string const & path, discretization_method dm, std::size_t num_threads, std::size_t memory_budget,
+		std::size_t block_bytes, binning_options const & binning ) : _path( path ), _dm( dm ), _memory_budget( memory_budget ), _block_bytes( std::max<std::size_t>( block_bytes, 1 ) ),
+		_histogram_budget( dataset<T>::default_histogram_budget ), _num_instances( 0 ), _pool( num_threads ), _num_passes( 0 ) {
+	std::ifstream is( path, std::ios::binary );
+	std::string header;
+	if( ! is || ! std::getline( is, header ) || is.eof() ) {
+		file_error( path, "cannot be read or has no newline after the header" );
+	}
+	header += '\n';
+	parse_header( header.data(), header.data() + header.size(), _names );
+
+	if( binning.method != binning_method::NONE ) {
+		statistics_phase phase( "binning" );
+		discretizer_fitter fitter( binning, _names.size(), num_threads, [dm]( double value ) { return dataset<T>::discretize( value, dm ); } );
+		for( std::size_t pass = 0; pass < fitter.num_passes(); ++pass ) {
+			read_blocks( [&fitter]( char const * first, char const * last, std::size_t row_offset ) {
+				return fitter.add_text( first, last, row_offset );
+			} );
+			fitter.end_pass();
+		}
+		_bins = fitter.finish();
+	}
+
+	std::vector<std::size_t> all_attributes( _names.size() );
+	for( std::size_t attribute_num = 0; attribute_num < all_attributes.size(); ++attribute_num ) {
+		all_attributes[ attribute_num ] = attribute_num;
+	}
+	std::vector<std::map<T, std::size_t> > counts( _names.size() );
+	scan( all_attributes, [&]( block_sink const & sink ) {
+		_num_instances += sink.num_rows();
+		_pool.parallel_for( 0, _names.size(), [&]( std::size_t attribute_num ) {
+			std::vector<T> const & values = sink.values( attribute_num );
+			attribute_information<T> block_info( values.begin(), values.end() );
+			for( std::size_t code = 0; code < block_info.num_values(); ++code ) {
+				counts[ attribute_num ][ block_info.values()[ code ] ] += block_info.counts()[ code ];
+			}
+		} );
+	} );
+
+	_attr_info.resize( _names.size() );
+	for( std::size_t attribute_num = 0; attribute_num < _names.size(); ++attribute_num ) {
+		std::vector<T> values;
+		std::vector<std::size_t> value_counts;
+		for( auto & entry : counts[ attribute_num ] ) {
+			values.push_back( entry.first );
+			value_counts.push_back( entry.second );
+		}
+		_attr_info[ attribute_num ] = attribute_information<T>( std::move( values ), std::move( value_counts ) );
+	}
+}
+
+template <typename T>
+streaming_dataset<T>::block_sink::block_sink( std::vector<std::size_t> const & attributes, std::size_t num_attributes, discretization_method dm,
+		discretizer const & bins ) : _attributes( attributes ), _num_attributes( num_attributes ), _dm( dm ), _bins( bins ), _num_rows( 0 ),
+		_values( attributes.size() ) {
+}
+
+template <typename T>
+void streaming_dataset<T>::block_sink::begin( std::size_t num_rows, std::size_t num_columns ) {
+	if( num_rows > 0 && num_columns != _num_attributes ) {
+		std::cerr << "error: header names " << _num_attributes << " attributes but rows have " << num_columns << " columns\n";
+		exit( 2 );
+	}
+	_num_rows = num_rows;
+	for( auto & values : _values ) {
+		values.resize( num_rows );
+	}
+}
+
+template <typename T>
+std::size_t streaming_dataset<T>::block_sink::store_row( std::size_t row, double const * values ) {
+	std::size_t const num_values = _values.size();
+	for( std::size_t i = 0; i < num_values; ++i ) {
+		std::size_t const attribute_num = _attributes[ i ];
+		double value = _bins.binned( attribute_num ) ? _bins.bin( attribute_num, values[ attribute_num ] )
+				: dataset<T>::discretize( values[ attribute_num ], _dm );
+		if( ! dataset<T>::holds( value ) ) {
+			return attribute_num;
+		}
+		_values[ i ][ row ] = static_cast<T>( value );
+	}
+	return _num_attributes;
+}
+
+template <typename T>
+std::size_t streaming_dataset<T>::block_sink::num_rows() const {
+	return _num_rows;
+}
+
+template <typename T>
+std::vector<T> const & streaming_dataset<T>::block_sink::values( std::size_t i ) const {
+	return _values[ i ];
+}
+
+/*
+ * Reads the file a block at a time, calling on_rows( first, last, row_offset ) with the
+ * whole rows of each block, the rows before them numbering row_offset; on_rows returns
+ * the number of rows it read. A row longer than a block is read whole by growing the
+ * block.
+ */
+template <typename T>
+template <typename Function>
+void streaming_dataset<T>::read_blocks( Function on_rows ) const {
+	std::ifstream is( _path, std::ios::binary );
+	if( ! is ) {
+		file_error( _path, "cannot be read" );
+	}
+	++_num_passes;
+
+	std::vector<char> text;
+	std::size_t carry = 0;
+	std::size_t row_offset = 0;
+	bool in_rows = false;
+	while( true ) {
+		text.resize( carry + _block_bytes );
+		is.read( text.data() + carry, static_cast<std::streamsize>( _block_bytes ) );
+		std::size_t size = carry + static_cast<std::size_t>( is.gcount() );
+		bool at_end = ! is;
+		char const * first = text.data();
+		char const * last = first + size;
+		if( ! in_rows ) {
+			char const * header_end = std::find( first, last, '\n' );
+			if( header_end == last ) {
+				if( at_end ) {
+					file_error( _path, "has no newline after the header" );
+				}
+				carry = size;
+				continue;
+			}
+			first = header_end + 1;
+			in_rows = true;
+		}
+
+		// only whole rows are parsed, the rest is carried into the next block
+		char const * rows_last = last;
+		if( ! at_end ) {
+			rows_last = std::find( std::reverse_iterator<char const *>( last ), std::reverse_iterator<char const *>( first ), '\n' ).base();
+		}
+		if( rows_last != first ) {
+			row_offset += on_rows( first, rows_last, row_offset );
+		}
+		if( at_end ) {
+			break;
+		}
+		carry = static_cast<std::size_t>( last - rows_last );
+		std::memmove( text.data(), rows_last, carry );
+	}
+}
+
+/* Reads the file a block at a time, calling on_block with the discretized values of the given attributes for the whole rows of each block. */
+template <typename T>
+template <typename Function>
+void streaming_dataset<T>::scan( std::vector<std::size_t> const & attributes, Function on_block ) const {
+	block_sink sink( attributes, _names.size(), _dm, _bins );
+	read_blocks( [this, &sink, &on_block]( char const * first, char const * last, std::size_t row_offset ) {
+		parse_table( first, last, _pool.num_threads(), sink, row_offset );
+		on_block( static_cast<block_sink const &>( sink ) );
+		return sink.num_rows();
+	} );
+}
+
+template <typename T>
+std::size_t streaming_dataset<T>::num_instances() const {
+	return _num_instances;
+}
+
+template <typename T>
+std::size_t streaming_dataset<T>::num_attributes() const {
+	return _names.size();
+}
+
+template <typename T>
+std::string streaming_dataset<T>::attribute_name( std::size_t attribute_num ) const {
+	return _names[ attribute_num ];
+}
+
+template <typename T>
+double streaming_dataset<T>::attribute_entropy( std::size_t attribute_num ) const {
+	return _attr_info[ attribute_num ].entropy();
+}
+
+template <typename T>
+attribute_information<T> const & streaming_dataset<T>::attribute_info( std::size_t attribute_num ) const {
+	return _attr_info[ attribute_num ];
+}
+
+template <typename T>
+std::size_t streaming_dataset<T>::histogram_budget() const {
+	return _histogram_budget;
+}
+
+template <typename T>
+void streaming_dataset<T>::set_histogram_budget( std::size_t bytes ) {
+	_histogram_budget = bytes;
+}
+
+template <typename T>
+std::size_t streaming_dataset<T>::memory_budget() const {
+	return _memory_budget;
+}
+
+template <typename T>
+std::size_t streaming_dataset<T>::num_passes() const {
+	std::lock_guard<std::mutex> lock( _mutex );
+	return _num_passes;
+}
+
+template <typename T>
+double streaming_dataset<T>::mutual_information( std::size_t attribute1, std::size_t attribute2 ) const {
+	double mutual_information;
+	mutual_information_table( &attribute1, 1, &attribute2, 1, &mutual_information );
+	return mutual_information;
+}
+
+template <typename T>
+void streaming_dataset<T>::mutual_information_many( std::size_t anchor, std::size_t const * candidates, std::size_t num_candidates, double * out ) const {
+	mutual_information_table( &anchor, 1, candidates, num_candidates, out );
+}
+
+/*
+ * Mutual information between every anchor and every candidate, written to
+ * out[ a * num_candidates + c ]. Candidates are taken in order for as long as the tables
+ * of the pass hold fit the memory budget; a pass always takes at least one.
+ */
+template <typename T>
+void streaming_dataset<T>::mutual_information_table( std::size_t const * anchors, std::size_t num_anchors, std::size_t const * candidates,
+		std::size_t num_candidates, double * out ) const {
+	std::lock_guard<std::mutex> lock( _mutex );
+	std::size_t first = 0;
+	while( first < num_candidates ) {
+		std::size_t last = first;
+		std::size_t bytes = 0;
+		while( last < num_candidates ) {
+			std::size_t candidate_bytes = 0;
+			for( std::size_t a = 0; a < num_anchors; ++a ) {
+				candidate_bytes += table_bytes( anchors[ a ], candidates[ last ] );
+			}
+			if( last > first && bytes + candidate_bytes > _memory_budget ) {
+				break;
+			}
+			bytes += candidate_bytes;
+			++last;
+		}
+		count_pass( anchors, num_anchors, candidates, first, last, num_candidates, out );
+		first = last;
+	}
+}
+
+/* Counts the tables of every anchor with candidates [first, last) in one pass over the file. */
+template <typename T>
+void streaming_dataset<T>::count_pass( std::size_t const * anchors, std::size_t num_anchors, std::size_t const * candidates, std::size_t first,
+		std::size_t last, std::size_t num_candidates, double * out ) const {
+	struct pass_pair {
+		std::size_t anchor;
+		std::size_t candidate;
+		std::size_t offset;
+	};
+
+	// pairs with a single value on either side need no counting
+	std::vector<pass_pair> pairs;
+	std::vector<std::size_t> attributes;
+	std::size_t num_cells = 0;
+	for( std::size_t a = 0; a < num_anchors; ++a ) {
+		for( std::size_t c = first; c < last; ++c ) {
+			if( is_degenerate( anchors[ a ], candidates[ c ] ) ) {
+				out[ a * num_candidates + c ] = 0.0;
+				continue;
+			}
+			pairs.push_back( pass_pair{ a, c, num_cells } );
+			if( is_dense( anchors[ a ], candidates[ c ] ) ) {
+				num_cells += _attr_info[ anchors[ a ] ].num_values() * _attr_info[ candidates[ c ] ].num_values();
+			}
+			attributes.push_back( anchors[ a ] );
+			attributes.push_back( candidates[ c ] );
+		}
+	}
+	statistics::get()->count_mutual_information( num_anchors * ( last - first ) );
+	if( pairs.empty() ) {
+		return;
+	}
+	std::sort( attributes.begin(), attributes.end() );
+	attributes.erase( std::unique( attributes.begin(), attributes.end() ), attributes.end() );
+	auto slot = [&attributes]( std::size_t attribute_num ) {
+		return static_cast<std::size_t>( std::lower_bound( attributes.begin(), attributes.end(), attribute_num ) - attributes.begin() );
+	};
+
+	std::vector<std::uint32_t> counts( num_cells, 0 );
+	std::vector<std::unordered_map<std::size_t, std::size_t> > sparse_counts( pairs.size() );
+	std::vector<std::vector<std::int32_t> > codes( attributes.size() );
+	scan( attributes, [&]( block_sink const & sink ) {
+		_pool.parallel_for( 0, attributes.size(), [&]( std::size_t i ) {
+			std::vector<T> const & values = sink.values( i );
+			codes[ i ].resize( values.size() );
+			_attr_info[ attributes[ i ] ].encode( values.begin(), values.end(), codes[ i ].begin() );
+		} );
+		_pool.parallel_for( 0, pairs.size(), [&]( std::size_t p ) {
+			std::size_t const anchor = anchors[ pairs[ p ].anchor ];
+			std::size_t const candidate = candidates[ pairs[ p ].candidate ];
+			std::vector<std::int32_t> const & anchor_codes = codes[ slot( anchor ) ];
+			std::vector<std::int32_t> const & candidate_codes = codes[ slot( candidate ) ];
+			std::size_t const candidate_num_values = _attr_info[ candidate ].num_values();
+			if( is_dense( anchor, candidate ) ) {
+				joint_counts( anchor_codes.data(), candidate_codes.data(), sink.num_rows(), _attr_info[ anchor ].num_values(), candidate_num_values,
+						counts.data() + pairs[ p ].offset );
+			} else {
+				for( std::size_t i = 0; i < sink.num_rows(); ++i ) {
+					++sparse_counts[ p ][ static_cast<std::size_t>( anchor_codes[ i ] ) * candidate_num_values + static_cast<std::size_t>( candidate_codes[ i ] ) ];
+				}
+			}
+		} );
+	} );
+
+	std::size_t num_sparse_cells = 0;
+	for( auto & table : sparse_counts ) {
+		num_sparse_cells += table.size();
+	}
+	statistics::get()->count_scan( pairs.size() * _num_instances, num_cells + num_sparse_cells );
+
+	double const n = static_cast<double>( _num_instances );
+	for( std::size_t p = 0; p < pairs.size(); ++p ) {
+		std::size_t const anchor = anchors[ pairs[ p ].anchor ];
+		std::size_t const candidate = candidates[ pairs[ p ].candidate ];
+		std::vector<probability> const & a1_probabilities = _attr_info[ anchor ].probabilities();
+		std::vector<probability> const & a2_probabilities = _attr_info[ candidate ].probabilities();
+		double & result = out[ pairs[ p ].anchor * num_candidates + pairs[ p ].candidate ];
+		if( is_dense( anchor, candidate ) ) {
+			result = active_kernels().mutual_information( counts.data() + pairs[ p ].offset, a1_probabilities.data(), a1_probabilities.size(),
+					a2_probabilities.data(), a2_probabilities.size(), n );
+			continue;
+		}
+		std::size_t const a2_num_values = a2_probabilities.size();
+		result = 0.0;
+		for( auto & entry : sparse_counts[ p ] ) {
+			probability joint_probability = entry.second / n;
+			probability marginal_probability_i = a1_probabilities[ entry.first / a2_num_values ];
+			probability marginal_probability_j = a2_probabilities[ entry.first % a2_num_values ];
+			result += joint_probability * std::log2( joint_probability / ( marginal_probability_i * marginal_probability_j ) );
+		}
+	}
+}
+
+template <typename T>
+bool streaming_dataset<T>::is_degenerate( std::size_t attribute1, std::size_t attribute2 ) const {
+	return _attr_info.at( attribute1 ).num_values() <= 1 || _attr_info.at( attribute2 ).num_values() <= 1;
+}
+
+template <typename T>
+bool streaming_dataset<T>::is_dense( std::size_t attribute1, std::size_t attribute2 ) const {
+	return _num_instances <= std::numeric_limits<std::uint32_t>::max()
+		&& _attr_info[ attribute1 ].num_values() <= _histogram_budget / sizeof( std::uint32_t ) / _attr_info[ attribute2 ].num_values();
+}
+
+/* Memory the table of a pair takes in a pass, estimating a sparse table by its possible cells. */
+template <typename T>
+std::size_t streaming_dataset<T>::table_bytes( std::size_t attribute1, std::size_t attribute2 ) const {
+	if( is_degenerate( attribute1, attribute2 ) ) {
+		return 0;
+	}
+	if( is_dense( attribute1, attribute2 ) ) {
+		return _attr_info[ attribute1 ].num_values() * _attr_info[ attribute2 ].num_values() * sizeof( std::uint32_t );
+	}
+	// a hashed cell costs about as much as a cached pair of mutual information
+	std::size_t const max_cells = _attr_info[ attribute1 ].num_values() > _num_instances / _attr_info[ attribute2 ].num_values() ? _num_instances
+		: _attr_info[ attribute1 ].num_values() * _attr_info[ attribute2 ].num_values();
+	return max_cells * 64;
+}
+
+template <typename T>
+void streaming_dataset<T>::file_error( std::string const & path, char const * message ) {
+	std::cerr << "error: " << path << ": " << message << "\n";
+	exit( 2 );
+}
+
+#endif
@@ -0,0 +1,126 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <random>
+#include <stdexcept>
+#include "synthetic.hpp"
+
+namespace {
+
+// mt19937_64 output is fixed by the standard, unlike the distributions, so reduce by hand
+std::size_t uniform_index( std::mt19937_64 & engine, std::size_t n ) {
+	return static_cast<std::size_t>( engine() % n );
+}
+
+double uniform_real( std::mt19937_64 & engine ) {
+	return static_cast<double>( engine() >> 11 ) * ( 1.0 / 9007199254740992.0 );
+}
+
+}
+
+synthetic_data::synthetic_data( synthetic_options const & options ) : _num_rows( options.num_rows ), _num_columns( options.num_attributes + 1 ) {
+	if( options.cardinality < 1 || options.cardinality > 256 || options.num_classes < 1 || options.num_classes > 256 ) {
+		throw std::invalid_argument( "cardinality and number of classes must be between 1 and 256" );
+	}
+	std::mt19937_64 engine( options.seed );
+	_values.resize( _num_rows * _num_columns );
+	std::vector<double> strength( _num_columns );
+	for( std::size_t column = 1; column < _num_columns; ++column ) {
+		strength[ column ] = options.relevance * ( 1.0 - static_cast<double>( column - 1 ) / options.num_attributes );
+	}
+	for( std::size_t row = 0; row < _num_rows; ++row ) {
+		unsigned char * values = _values.data() + row * _num_columns;
+		std::size_t label;
+		if( options.class_balance <= 0.0 || options.num_classes == 1 ) {
+			label = uniform_index( engine, options.num_classes );
+		} else if( uniform_real( engine ) < options.class_balance ) {
+			label = 0;
+		} else {
+			label = 1 + uniform_index( engine, options.num_classes - 1 );
+		}
+		values[ 0 ] = static_cast<unsigned char>( label );
+		for( std::size_t column = 1; column < _num_columns; ++column ) {
+			double copy = column > 1 ? options.redundancy : 0.0;
+			double u = uniform_real( engine );
+			if( u < copy ) {
+				values[ column ] = values[ column - 1 ];
+			} else if( u < copy + strength[ column ] ) {
+				values[ column ] = static_cast<unsigned char>( ( label + column ) % options.cardinality );
+			} else {
+				values[ column ] = static_cast<unsigned char>( uniform_index( engine, options.cardinality ) );
+			}
+		}
+	}
+}
+
+std::size_t synthetic_data::num_rows() const {
+	return _num_rows;
+}
+
+std::size_t synthetic_data::num_columns() const {
+	return _num_columns;
+}
+
+unsigned char synthetic_data::value( std::size_t row, std::size_t column ) const {
+	return _values[ row * _num_columns + column ];
+}
+
+std::vector<unsigned char> const & synthetic_data::values() const {
+	return _values;
+}
+
+std::vector<unsigned char> synthetic_data::column( std::size_t column ) const {
+	std::vector<unsigned char> result( _num_rows );
+	for( std::size_t row = 0; row < _num_rows; ++row ) {
+		result[ row ] = value( row, column );
+	}
+	return result;
+}
+
+std::string synthetic_data::text() const {
+	std::string result;
+	result.reserve( 8 * _num_columns + 4 * _values.size() );
+	for( std::size_t column = 0; column < _num_columns; ++column ) {
+		result += column == 0 ? "c" : "\ta" + std::to_string( column );
+	}
+	result += '\n';
+	for( std::size_t row = 0; row < _num_rows; ++row ) {
+		for( std::size_t column = 0; column < _num_columns; ++column ) {
+			unsigned int v = value( row, column );
+			if( column > 0 ) {
+				result += '\t';
+			}
+			if( v >= 100 ) {
+				result += static_cast<char>( '0' + v / 100 );
+			}
+			if( v >= 10 ) {
+				result += static_cast<char>( '0' + v / 10 % 10 );
+			}
+			result += static_cast<char>( '0' + v % 10 );
+		}
+		result += '\n';
+	}
+	return result;
+}
+
+void synthetic_data::write_text( std::ostream & os ) const {
+	std::string t = text();
+	os.write( t.data(), static_cast<std::streamsize>( t.size() ) );
+}
@@ -0,0 +1,69 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MRMR_SYNTHETIC_HPP
+#define MRMR_SYNTHETIC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ * Shape of a generated dataset. The class is the first column. Attribute j takes the
+ * value the class implies in a share relevance * ( 1 - j / num_attributes ) of its
+ * rows, so earlier attributes are more relevant, and repeats attribute j - 1 in a
+ * share redundancy of them, so neighbours are redundant. Other values are uniform.
+ */
+struct synthetic_options {
+	std::size_t num_rows = 10000;
+	std::size_t num_attributes = 100;
+	std::size_t cardinality = 4;
+	std::size_t num_classes = 2;
+	double class_balance = 0.0; // share of rows in the first class, 0 for all classes alike
+	double relevance = 0.5;
+	double redundancy = 0.25;
+	std::uint64_t seed = 0;
+};
+
+/*
+ * Discrete dataset drawn from synthetic_options, the same for the same options on
+ * every platform. Values are kept row-major with the class first.
+ */
+class synthetic_data {
+	public:
+		explicit synthetic_data( synthetic_options const & options );
+
+		std::size_t num_rows() const;
+		std::size_t num_columns() const;
+		unsigned char value( std::size_t row, std::size_t column ) const;
+		std::vector<unsigned char> const & values() const;
+		std::vector<unsigned char> column( std::size_t column ) const;
+		std::string text() const;
+		void write_text( std::ostream & os ) const;
+
+	private:
+		std::size_t _num_rows;
+		std::size_t _num_columns;
+		std::vector<unsigned char> _values;
+};
+
+#endif
@@ -18,15 +18,36 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cmath>
 #include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <iterator>
 #include <sstream>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <valarray>
+#include <vector>
+#include <unistd.h>
 #include "attribute_information.hpp"
 #include "dataset.hpp"
+#include "kernels.hpp"
 #include "matrix.hpp"
+#include "mi_cache.hpp"
+#include "mrmr.hpp"
+#include "shard_channel.hpp"
+#include "sharded_dataset.hpp"
+#include "stats.hpp"
+#include "streaming_dataset.hpp"
+#include "synthetic.hpp"
+#include "text_parser.hpp"
+#include "thread_pool.hpp"
 
 std::string test( bool value ) {
 	return value ? "PASSED" : "FAILED";
@@ -41,6 +62,9 @@ int main( int argc, char * argv[] ) {
 	std::cerr << "Testing attribute_information.num_values: " << test( ai.num_values() == 3 ) << std::endl;
 	std::cerr << "Testing attribute_information.entropy: " << test( std::round( ai.entropy() * 1000000000000 ) == 1546179691947 ) << std::endl;
 	std::cerr << "Testing attribute_information.marginal_probability: " << test( ai.marginal_probability( 0 ) == 5.0/16.0 && ai.marginal_probability( 1 ) == 7.0/16.0 && ai.marginal_probability( 2 ) == 4.0 / 16.0 ) << std::endl;
+	std::array<value,16> codes;
+	ai.encode( std::cbegin( a ), std::cend( a ), std::begin( codes ) );
+	std::cerr << "Testing attribute_information.encode: " << test( codes == a && ai.counts()[ 1 ] == 7 && ai.probabilities()[ 2 ] == 4.0 / 16.0 ) << std::endl;
 	matrix<double> m( 2, 3 );
 	std::cerr << "Testing matrix.set and matrix.get: ";
 	m( 0, 0 ) = 0.0;
@@ -62,6 +86,33 @@ int main( int argc, char * argv[] ) {
 	std::cerr << "Testing matrix.transpose: ";
 	matrix<double> t = m.transpose();
 	std::cerr << test( t( 0, 0 ) == 0.0 && t( 0, 1 ) == 1.0 && t( 1, 0 ) == 0.1 && t( 1, 1 ) == 1.1 && t( 2, 0 ) == 0.2 && t( 2, 1 ) == 1.2 ) << std::endl;
+	std::cerr << "Testing parse_number against strtod: ";
+	bool numbers_agree = true;
+	for( std::string number : { "0", "-0", "+7", "0.1", "1.", ".5", "-2.5", "3.14159265358979323846", "1e22", "1e23", "-1.5E-7",
+			"123456789012345678901234567890", "0.000000000000000000000000001", "2.2250738585072014e-308", "inf", "-nan" } ) {
+		char const * first = number.data();
+		double parsed;
+		numbers_agree = numbers_agree && parse_number( first, number.data() + number.size(), parsed ) && first == number.data() + number.size();
+		double expected = std::strtod( number.c_str(), nullptr );
+		numbers_agree = numbers_agree && ( parsed == expected || ( parsed != parsed && expected != expected ) ) && std::signbit( parsed ) == std::signbit( expected );
+	}
+	for( std::string number : { "", "-", "e5", "1e", "x" } ) {
+		char const * first = number.data();
+		double parsed;
+		numbers_agree = numbers_agree && ! parse_number( first, number.data() + number.size(), parsed );
+	}
+	std::cerr << test( numbers_agree ) << std::endl;
+	std::cerr << "Testing parse_table with multiple threads: ";
+	std::string table_str;
+	for( std::size_t i = 0; i < 20000; ++i ) {
+		table_str += std::to_string( i ) + "\t" + std::to_string( i * 0.25 ) + "\t-" + std::to_string( i % 7 ) + "e-1\n";
+	}
+	std::size_t serial_rows, serial_columns, parallel_rows, parallel_columns;
+	std::valarray<double> serial_values, parallel_values;
+	parse_table( table_str.data(), table_str.data() + table_str.size(), 1, serial_rows, serial_columns, serial_values );
+	parse_table( table_str.data(), table_str.data() + table_str.size() - 1, 4, parallel_rows, parallel_columns, parallel_values );
+	std::cerr << test( serial_rows == 20000 && serial_columns == 3 && parallel_rows == serial_rows && parallel_columns == serial_columns
+		&& ( serial_values == parallel_values ).min() && serial_values[ 3 * 19999 + 1 ] == 19999 * 0.25 && serial_values[ 3 * 6 + 2 ] == -0.6 ) << std::endl;
 	std::cerr << "Testing operator>>( istream &, dataset & ) and operator<<( ostream &, dataset & ): ";
 	std::string str( "class\tattr1\tattr2\n0\t0\t1\n0\t1\t1\n0\t0\t0\n1\t1\t1\n1\t0\t1\n1\t1\t1\n" );
 	std::stringstream dataset_ss( str );
@@ -72,6 +123,660 @@ int main( int argc, char * argv[] ) {
 	std::cerr << test( str == output_dataset_ss.str() ) << std::endl;
 	std::cerr << "Testing dataset.attribute_entropy: " << test( ds.attribute_entropy( 0 ) == 1 && ds.attribute_entropy( 1 ) == 1 && std::round( ds.attribute_entropy( 2 ) * 1000000000000 ) == 650022421648 ) << std::endl;
 	std::cerr << "Testing dataset.mutual_information: " << test( round( ds.mutual_information( 0, 1 ) * 10000000 ) == 817042 && round( ds.mutual_information( 0, 2 ) * 10000000 ) == 1908745 )<< std::endl;
+	std::cerr << "Testing dataset.mutual_information without dense histograms: ";
+	double dense_mi = ds.mutual_information( 0, 2 );
+	ds.set_histogram_budget( 0 );
+	std::cerr << test( std::abs( ds.mutual_information( 0, 2 ) - dense_mi ) < 1e-12 ) << std::endl;
+	ds.set_histogram_budget( dataset<unsigned char>::default_histogram_budget );
+	std::cerr << "Testing dataset.mutual_information with sparse values: ";
+	std::string sparse_str( "class\tattr1\tattr2\n0\t0\t1\n0\t1000000\t1\n0\t0\t-70000\n1\t1000000\t1\n1\t0\t1\n1\t1000000\t1\n" );
+	std::stringstream sparse_ss( sparse_str );
+	dataset<int> sparse_ds( sparse_ss, dataset<int>::ROUND );
+	std::cerr << test( sparse_ds.mutual_information( 0, 1 ) == ds.mutual_information( 0, 1 ) && sparse_ds.mutual_information( 0, 2 ) == ds.mutual_information( 0, 2 ) ) << std::endl;
+	std::string wide_str( "class\ta1\ta2\ta3\ta4\ta5\n0\t0\t1\t2\t0\t1\n0\t1\t1\t0\t0\t1\n0\t0\t0\t1\t1\t0\n1\t1\t1\t2\t1\t1\n1\t0\t1\t0\t0\t1\n1\t1\t1\t1\t1\t0\n2\t1\t0\t2\t0\t0\n2\t0\t0\t0\t1\t1\n" );
+	std::stringstream wide_ss( wide_str );
+	dataset<unsigned char> wide( wide_ss, dataset<unsigned char>::ROUND );
+	std::cerr << "Testing dataset.mutual_information_many: ";
+	std::array<std::size_t,4> many_candidates = { 1, 2, 4, 5 };
+	std::array<double,4> many_mi;
+	wide.set_histogram_budget( 40 );
+	wide.mutual_information_many( 3, many_candidates.data(), many_candidates.size(), many_mi.data() );
+	bool many_agree = true;
+	for( std::size_t i = 0; i < many_candidates.size(); ++i ) {
+		many_agree = many_agree && many_mi[ i ] == wide.mutual_information( 3, many_candidates[ i ] );
+	}
+	wide.set_histogram_budget( dataset<unsigned char>::default_histogram_budget );
+	std::cerr << test( many_agree ) << std::endl;
+	std::cerr << "Testing kernels against scalar kernels: ";
+	bool kernels_agree = true;
+	for( kernel_type kernel : { AVX2_KERNEL, AVX512_KERNEL } ) {
+		if( ! kernels_supported( kernel ) ) {
+			continue;
+		}
+		for( std::size_t num_values : { 2, 3, 7, 300 } ) {
+			std::vector<std::int32_t> codes1( 1001 ), codes2( 1001 );
+			std::vector<std::uint16_t> short_codes1( 1001 ), short_codes2( 1001 );
+			std::vector<std::uint8_t> byte_codes1( 1001 ), byte_codes2( 1001 );
+			for( std::size_t i = 0; i < codes1.size(); ++i ) {
+				codes1[ i ] = short_codes1[ i ] = byte_codes1[ i ] = ( i * 7919 ) % num_values % 256;
+				codes2[ i ] = short_codes2[ i ] = byte_codes2[ i ] = ( i * i + 3 ) % num_values % 256;
+			}
+			std::size_t byte_values = std::min<std::size_t>( num_values, 256 );
+			std::vector<std::uint32_t> expected( num_values * num_values, 0 ), expected_bytes( byte_values * byte_values, 0 );
+			std::vector<std::uint32_t> actual( num_values * num_values, 0 ), actual_short( num_values * num_values, 0 ), actual_bytes( byte_values * byte_values, 0 );
+			select_kernels( SCALAR_KERNEL );
+			joint_counts( codes1.data(), codes2.data(), codes1.size(), num_values, num_values, expected.data() );
+			joint_counts( byte_codes1.data(), byte_codes2.data(), codes1.size(), byte_values, byte_values, expected_bytes.data() );
+			std::vector<probability> p( num_values, 1.0 / num_values );
+			double expected_mi = active_kernels().mutual_information( expected.data(), p.data(), num_values, p.data(), num_values, codes1.size() );
+			select_kernels( kernel );
+			joint_counts( codes1.data(), codes2.data(), codes1.size(), num_values, num_values, actual.data() );
+			joint_counts( short_codes1.data(), short_codes2.data(), codes1.size(), num_values, num_values, actual_short.data() );
+			joint_counts( byte_codes1.data(), byte_codes2.data(), codes1.size(), byte_values, byte_values, actual_bytes.data() );
+			double actual_mi = active_kernels().mutual_information( expected.data(), p.data(), num_values, p.data(), num_values, codes1.size() );
+			kernels_agree = kernels_agree && actual == expected && actual_short == expected && actual_bytes == expected_bytes
+				&& std::abs( actual_mi - expected_mi ) < 1e-12
+				&& std::abs( active_kernels().entropy( p.data(), num_values ) - std::log2( num_values ) ) < 1e-12;
+		}
+		std::vector<std::uint64_t> words1( 37 ), words2( 37 );
+		for( std::size_t i = 0; i < words1.size(); ++i ) {
+			words1[ i ] = ( i + 1 ) * 0x9E3779B97F4A7C15ULL;
+			words2[ i ] = ( i + 7 ) * 0xC2B2AE3D27D4EB4FULL;
+		}
+		std::vector<std::uint32_t> expected_nibbles( 256, 0 ), actual_nibbles( 256, 0 );
+		select_kernels( SCALAR_KERNEL );
+		std::uint64_t expected_popcount = active_kernels().and_popcount( words1.data(), words2.data(), words1.size() );
+		active_kernels().nibble_joint_counts( words1.data(), words2.data(), words1.size(), expected_nibbles.data() );
+		select_kernels( kernel );
+		active_kernels().nibble_joint_counts( words1.data(), words2.data(), words1.size(), actual_nibbles.data() );
+		kernels_agree = kernels_agree && active_kernels().and_popcount( words1.data(), words2.data(), words1.size() ) == expected_popcount
+			&& actual_nibbles == expected_nibbles;
+	}
+	select_kernels( AUTO_KERNEL );
+	std::cerr << test( kernels_agree ) << std::endl;
+	std::cerr << "Testing dataset.mutual_information on packed columns: ";
+	dataset<int> packed;
+	std::array<std::size_t,7> packed_values = { 2, 2, 3, 10, 16, 17, 300 };
+	for( std::size_t a = 0; a < packed_values.size(); ++a ) {
+		std::vector<int> column( 1000 );
+		for( std::size_t i = 0; i < column.size(); ++i ) {
+			column[ i ] = static_cast<int>( ( ( i + 1 ) * 2654435761u + a * 40503u ) / 7 % packed_values[ a ] ) * 3 - 5;
+		}
+		std::string column_name = "a" + std::to_string( a );
+		packed.set_attribute( column_name, column.data(), column.size() );
+	}
+	bool packed_agree = packed.columns().bits( 0 ) == 1 && packed.columns().bits( 2 ) == 2 && packed.columns().bits( 4 ) == 4
+		&& packed.columns().bits( 5 ) == 8 && packed.columns().bits( 6 ) == 16;
+	for( std::size_t a1 = 0; a1 < packed_values.size(); ++a1 ) {
+		for( std::size_t a2 = 0; a2 < packed_values.size(); ++a2 ) {
+			packed.set_histogram_budget( dataset<int>::default_histogram_budget );
+			double packed_mi = packed.mutual_information( a1, a2 );
+			packed.set_histogram_budget( 0 );
+			packed_agree = packed_agree && std::abs( packed.mutual_information( a1, a2 ) - packed_mi ) < 1e-12;
+		}
+	}
+	packed.set_histogram_budget( dataset<int>::default_histogram_budget );
+	std::cerr << test( packed_agree ) << std::endl;
+	std::cerr << "Testing dataset.save_binary and dataset::open_binary: ";
+	std::string binary_path( "tests_binary.tmp" );
+	{
+		std::ofstream binary_ofs( binary_path, std::ios::binary );
+		packed.save_binary( binary_ofs );
+	}
+	bool binary_agree = dataset<int>::is_binary( binary_path ) && ! dataset<int>::is_binary( "tests.cpp" );
+	if( binary_agree ) {
+		dataset<int> mapped = dataset<int>::open_binary( binary_path );
+		std::stringstream packed_ss, mapped_ss;
+		packed_ss << packed;
+		mapped_ss << mapped;
+		binary_agree = packed_ss.str() == mapped_ss.str() && mapped.columns().memory_usage() == 0;
+		for( std::size_t a = 0; a < packed_values.size(); ++a ) {
+			binary_agree = binary_agree && mapped.attribute_entropy( a ) == packed.attribute_entropy( a )
+				&& mapped.attribute_info( a ).probabilities() == packed.attribute_info( a ).probabilities()
+				&& mapped.mutual_information( 0, a ) == packed.mutual_information( 0, a );
+		}
+	}
+	std::remove( binary_path.c_str() );
+	std::cerr << test( binary_agree ) << std::endl;
+	std::cerr << "Testing dataset::open_binary of a dataset without rows: ";
+	std::stringstream empty_ss( "a\tb\n" );
+	dataset<int> empty( empty_ss );
+	{
+		std::ofstream binary_ofs( binary_path, std::ios::binary );
+		empty.save_binary( binary_ofs );
+	}
+	dataset<int> empty_mapped = dataset<int>::open_binary( binary_path );
+	std::remove( binary_path.c_str() );
+	std::cerr << test( empty_mapped.num_instances() == 0 && empty_mapped.num_attributes() == 2 && empty_mapped.attribute_name( 1 ) == "b" ) << std::endl;
+	std::cerr << "Testing dataset.reserve and dataset.attribute_value: ";
+	dataset<int> reserved;
+	reserved.reserve( packed_values.size() + 1, 1000 );
+	bool reserved_agree = reserved.num_instances() == 1000 && reserved.num_attributes() == 0;
+	for( std::size_t a = 0; a < packed_values.size(); ++a ) {
+		std::vector<int> column( 1000 );
+		for( std::size_t i = 0; i < column.size(); ++i ) {
+			column[ i ] = static_cast<int>( ( ( i + 1 ) * 2654435761u + a * 40503u ) / 7 % packed_values[ a ] ) * 3 - 5;
+		}
+		reserved_agree = reserved_agree && reserved.set_attribute( "a" + std::to_string( a ), column.data(), column.size() ) == 0;
+	}
+	{
+		std::stringstream packed_ss, reserved_ss;
+		packed_ss << packed;
+		reserved_ss << reserved;
+		reserved_agree = reserved_agree && packed_ss.str() == reserved_ss.str();
+	}
+	std::vector<std::uint8_t> narrow( 1000 );
+	for( std::size_t i = 0; i < narrow.size(); ++i ) {
+		narrow[ i ] = static_cast<std::uint8_t>( i % 251 );
+	}
+	reserved_agree = reserved_agree && reserved.set_attribute( "narrow", narrow.data(), narrow.size() ) == 0
+		&& reserved.set_attribute( "short", narrow.data(), 999 ) == -1
+		&& reserved.set_attribute( "a2", narrow.data(), narrow.size() ) == 0
+		&& reserved.num_attributes() == packed_values.size() + 1
+		&& reserved.attribute_value( "a2" ) == 2 && reserved.attribute_value( "narrow" ) == static_cast<int>( packed_values.size() )
+		&& reserved.attribute_value( "missing" ) == -1
+		&& reserved.attribute_info( 2 ).num_values() == 251 && reserved.attribute_info( 2 ).value( 250 ) == 250;
+	std::cerr << test( reserved_agree ) << std::endl;
+	std::cerr << "Testing dataset.set_attributes from strided buffers: ";
+	std::vector<std::string> buffer_names;
+	std::vector<int> row_major( 1000 * packed_values.size() );
+	for( std::size_t a = 0; a < packed_values.size(); ++a ) {
+		buffer_names.push_back( "a" + std::to_string( a ) );
+		for( std::size_t i = 0; i < 1000; ++i ) {
+			row_major[ i * packed_values.size() + a ] = static_cast<int>( ( ( i + 1 ) * 2654435761u + a * 40503u ) / 7 % packed_values[ a ] ) * 3 - 5;
+		}
+	}
+	dataset<int> from_rows;
+	bool buffers_agree = from_rows.set_attributes( buffer_names, row_major.data(), 1000, static_cast<std::ptrdiff_t>( packed_values.size() ), 1, 3 ) == 0;
+	{
+		std::stringstream packed_ss, rows_ss;
+		packed_ss << packed;
+		rows_ss << from_rows;
+		buffers_agree = buffers_agree && packed_ss.str() == rows_ss.str();
+	}
+	std::vector<std::uint8_t> column_major( 2 * 1000 );
+	for( std::size_t i = 0; i < 1000; ++i ) {
+		column_major[ i ] = static_cast<std::uint8_t>( i % 7 );
+		column_major[ 1000 + i ] = static_cast<std::uint8_t>( i % 13 );
+	}
+	std::vector<std::string> repeated_names = { "a1", "a1" };
+	buffers_agree = buffers_agree && from_rows.set_attributes( repeated_names, column_major.data(), 1000, 1, 1000 ) == 0
+		&& from_rows.num_attributes() == packed_values.size() && from_rows.attribute_info( 1 ).num_values() == 13
+		&& from_rows.set_attributes( repeated_names, column_major.data(), 999, 1, 1000 ) == -1;
+	std::cerr << test( buffers_agree ) << std::endl;
+	std::cerr << "Testing mrmr with multiple threads: ";
+	std::vector<mrmr_result> serial = mrmr( wide, 0, 0, mrmr_method_type::MID, 1 );
+	std::vector<mrmr_result> parallel = mrmr( wide, 0, 0, mrmr_method_type::MID, 4 );
+	bool same_ranking = serial.size() == parallel.size();
+	for( std::size_t i = 0; same_ranking && i < serial.size(); ++i ) {
+		same_ranking = serial[ i ].index == parallel[ i ].index && ( serial[ i ].score == parallel[ i ].score || i == 0 );
+	}
+	std::cerr << test( same_ranking ) << std::endl;
+	std::cerr << "Testing mrmr with a mutual information cache: ";
+	mi_cache cache;
+	std::vector<mrmr_result> first_cached = mrmr( wide, 0, 0, mrmr_method_type::MID, 1, &cache );
+	std::uint64_t first_misses = cache.misses();
+	std::vector<mrmr_result> second_cached = mrmr( wide, 0, 0, mrmr_method_type::MID, 4, &cache );
+	bool cache_agree = cache.misses() == first_misses && cache.hits() == first_misses && first_cached.size() == serial.size();
+	for( std::size_t i = 0; cache_agree && i < serial.size(); ++i ) {
+		cache_agree = first_cached[ i ].index == serial[ i ].index && second_cached[ i ].index == serial[ i ].index
+			&& ( i == 0 || ( first_cached[ i ].score == serial[ i ].score && second_cached[ i ].score == serial[ i ].score ) );
+	}
+	cache.set_max_bytes( 10 * mi_cache::entry_bytes );
+	mrmr( wide, 1, 0, mrmr_method_type::MIQ, 1, &cache );
+	cache_agree = cache_agree && cache.size() == 10 && cache.memory_usage() <= cache.max_bytes();
+	std::cerr << test( cache_agree ) << std::endl;
+	std::cerr << "Testing mrmr_batch against separate runs: ";
+	std::vector<std::size_t> batch_classes = { 6, 0, 3 };
+	std::vector<std::vector<mrmr_result>> batch = mrmr_batch( packed, batch_classes, 0, mrmr_method_type::MIQ, 2 );
+	bool batch_agree = batch.size() == batch_classes.size();
+	for( std::size_t b = 0; batch_agree && b < batch_classes.size(); ++b ) {
+		std::vector<mrmr_result> single = mrmr( packed, batch_classes[ b ], 0, mrmr_method_type::MIQ, 1 );
+		batch_agree = batch[ b ].size() == single.size();
+		for( std::size_t i = 0; batch_agree && i < single.size(); ++i ) {
+			batch_agree = batch[ b ][ i ].index == single[ i ].index && ( i == 0 || batch[ b ][ i ].score == single[ i ].score );
+		}
+	}
+	std::array<double,3 * 7> table_mi;
+	std::array<std::size_t,7> table_candidates = { 0, 1, 2, 3, 4, 5, 6 };
+	packed.mutual_information_table( batch_classes.data(), batch_classes.size(), table_candidates.data(), table_candidates.size(), table_mi.data() );
+	for( std::size_t b = 0; b < batch_classes.size(); ++b ) {
+		for( std::size_t c = 0; c < table_candidates.size(); ++c ) {
+			batch_agree = batch_agree && table_mi[ b * table_candidates.size() + c ] == packed.mutual_information( batch_classes[ b ], c );
+		}
+	}
+	std::cerr << test( batch_agree ) << std::endl;
+	std::cerr << "Testing mrmr_selector.extend against mrmr: ";
+	mi_cache selector_cache;
+	mrmr_selector<int> selector( packed, 2, mrmr_method_type::MID, 2, &selector_cache );
+	bool selector_agree = selector.extend( 2 ) == 2 && selector.num_selected() == 2 && ! selector.finished();
+	selector_agree = selector_agree && selector.extend( 1 ) == 1 && selector.extend( 100 ) == packed_values.size() - 4 && selector.finished()
+		&& selector.extend( 1 ) == 0;
+	mi_cache single_cache;
+	std::vector<mrmr_result> single = mrmr( packed, 2, 0, mrmr_method_type::MID, 1, &single_cache );
+	selector_agree = selector_agree && selector.results().size() == single.size() && selector_cache.misses() == single_cache.misses()
+		&& selector_cache.hits() == 0;
+	for( std::size_t i = 0; selector_agree && i < single.size(); ++i ) {
+		selector_agree = selector.results()[ i ].index == single[ i ].index && ( i == 0 || selector.results()[ i ].score == single[ i ].score );
+	}
+	std::cerr << test( selector_agree ) << std::endl;
+	std::cerr << "Testing lazy mrmr evaluation against exhaustive: ";
+	dataset<int> many;
+	std::vector<int> many_column( 2000 );
+	for( std::size_t a = 0; a < 60; ++a ) {
+		for( std::size_t i = 0; i < many_column.size(); ++i ) {
+			std::size_t noise = ( ( i + 1 ) * 2654435761u + a * 40503u ) / 11 % 5;
+			many_column[ i ] = static_cast<int>( a == 0 ? i % 4 : ( a % 3 == 0 ? ( i % 4 + noise / 4 ) : noise ) );
+		}
+		many.set_attribute( "m" + std::to_string( a ), many_column.data(), many_column.size() );
+	}
+	bool lazy_agree = true;
+	for( mrmr_method_type method : { mrmr_method_type::MID, mrmr_method_type::MIQ } ) {
+		for( std::size_t threads : { 1, 3 } ) {
+			for( std::size_t num_features : { 0, 5 } ) {
+				mi_cache exhaustive_cache, lazy_cache;
+				std::vector<mrmr_result> exhaustive = mrmr( many, 0, num_features, method, threads, &exhaustive_cache );
+				std::vector<mrmr_result> lazy = mrmr( many, 0, num_features, method, threads, &lazy_cache, mrmr_evaluation_type::LAZY );
+				lazy_agree = lazy_agree && lazy.size() == exhaustive.size()
+					&& ( num_features == 0 ? lazy_cache.misses() <= exhaustive_cache.misses() : lazy_cache.misses() < exhaustive_cache.misses() );
+				for( std::size_t i = 0; lazy_agree && i < lazy.size(); ++i ) {
+					lazy_agree = lazy[ i ].index == exhaustive[ i ].index && ( i == 0 || lazy[ i ].score == exhaustive[ i ].score );
+				}
+				std::vector<mrmr_result> packed_exhaustive = mrmr( packed, 3, num_features, method, threads );
+				std::vector<mrmr_result> packed_lazy = mrmr( packed, 3, num_features, method, threads, nullptr, mrmr_evaluation_type::LAZY );
+				std::vector<mrmr_result> wide_exhaustive = mrmr( wide, 0, num_features, method, threads );
+				std::vector<mrmr_result> wide_lazy = mrmr( wide, 0, num_features, method, threads, nullptr, mrmr_evaluation_type::LAZY );
+				lazy_agree = lazy_agree && packed_lazy.size() == packed_exhaustive.size() && wide_lazy.size() == wide_exhaustive.size();
+				for( std::size_t i = 0; lazy_agree && i < packed_lazy.size(); ++i ) {
+					lazy_agree = packed_lazy[ i ].index == packed_exhaustive[ i ].index && ( i == 0 || packed_lazy[ i ].score == packed_exhaustive[ i ].score );
+				}
+				for( std::size_t i = 0; lazy_agree && i < wide_lazy.size(); ++i ) {
+					lazy_agree = wide_lazy[ i ].index == wide_exhaustive[ i ].index && ( i == 0 || wide_lazy[ i ].score == wide_exhaustive[ i ].score );
+				}
+			}
+		}
+	}
+	std::cerr << test( lazy_agree ) << std::endl;
+	std::cerr << "Testing sampled mrmr evaluation against exhaustive: ";
+	std::vector<std::size_t> drawn = dataset<int>::sample_row_indices( 10, 4, 3 );
+	bool sampled_agree = drawn.size() == 4 && std::is_sorted( drawn.begin(), drawn.end() ) && std::adjacent_find( drawn.begin(), drawn.end() ) == drawn.end()
+		&& drawn.back() < 10 && drawn == dataset<int>::sample_row_indices( 10, 4, 3 ) && dataset<int>::sample_row_indices( 5, 9, 3 ).size() == 5;
+	dataset<int> many_sample = many.sample_rows( 500, 11, 2 );
+	sampled_agree = sampled_agree && many_sample.num_instances() == 500 && many_sample.num_attributes() == many.num_attributes()
+		&& many_sample.attribute_name( 7 ) == many.attribute_name( 7 );
+	for( mrmr_method_type method : { mrmr_method_type::MID, mrmr_method_type::MIQ } ) {
+		for( std::size_t threads : { 1, 3 } ) {
+			for( std::size_t num_features : { 0, 5 } ) {
+				std::vector<mrmr_result> exhaustive = mrmr( many, 0, num_features, method, threads );
+				mrmr_selector<int> sampled( many, 0, method, threads, nullptr, mrmr_evaluation_type::SAMPLED, &many_sample );
+				sampled.extend( num_features == 0 ? many.num_attributes() : num_features );
+				sampled_agree = sampled_agree && sampled.results().size() == exhaustive.size() && sampled.num_skipped_scores() > 0;
+				for( std::size_t i = 0; sampled_agree && i < exhaustive.size(); ++i ) {
+					sampled_agree = sampled.results()[ i ].index == exhaustive[ i ].index && ( i == 0 || sampled.results()[ i ].score == exhaustive[ i ].score );
+				}
+			}
+		}
+		// a tolerance wider than any score computes only the leader of each step
+		mrmr_selector<int> tolerant( many, 0, method, 1, nullptr, mrmr_evaluation_type::SAMPLED, &many_sample, 100.0 );
+		sampled_agree = sampled_agree && tolerant.extend( 5 ) == 5 && tolerant.num_exact_scores() == 5;
+		std::vector<mrmr_result> packed_exhaustive = mrmr( packed, 3, 0, method, 1 );
+		dataset<int> packed_sample = packed.sample_rows( packed.num_instances() );
+		std::vector<mrmr_result> packed_sampled = mrmr( packed, 3, 0, method, 1, nullptr, mrmr_evaluation_type::SAMPLED, &packed_sample );
+		sampled_agree = sampled_agree && packed_sampled.size() == packed_exhaustive.size();
+		for( std::size_t i = 0; sampled_agree && i < packed_sampled.size(); ++i ) {
+			sampled_agree = packed_sampled[ i ].index == packed_exhaustive[ i ].index && ( i == 0 || packed_sampled[ i ].score == packed_exhaustive[ i ].score );
+		}
+	}
+	std::cerr << test( sampled_agree ) << std::endl;
+	std::cerr << "Testing sharded_dataset against dataset: ";
+	std::string packed_text;
+	{
+		std::stringstream packed_ss;
+		packed_ss << packed;
+		packed_text = packed_ss.str();
+	}
+	// the first range ends inside the header and holds no rows, the others split rows mid-line
+	std::vector<std::size_t> shard_offsets = { 0, 5, packed_text.size() / 3, packed_text.size() * 2 / 3 + 1, packed_text.size() };
+	std::vector<std::unique_ptr<dataset<int> > > shard_data;
+	std::vector<std::unique_ptr<shard_channel> > worker_channels, coordinator_channels;
+	std::vector<std::thread> workers;
+	std::vector<int> pipe_fds;
+	std::size_t shard_rows = 0;
+	for( std::size_t s = 0; s + 1 < shard_offsets.size(); ++s ) {
+		shard_data.emplace_back( new dataset<int>( packed_text.data(), packed_text.data() + packed_text.size(), shard_offsets[ s ], shard_offsets[ s + 1 ] ) );
+		shard_rows += shard_data.back()->num_instances();
+		int to_worker[ 2 ], from_worker[ 2 ];
+		if( pipe( to_worker ) != 0 || pipe( from_worker ) != 0 ) {
+			return 1;
+		}
+		pipe_fds.insert( pipe_fds.end(), { to_worker[ 0 ], to_worker[ 1 ], from_worker[ 0 ], from_worker[ 1 ] } );
+		worker_channels.emplace_back( new shard_channel( to_worker[ 0 ], from_worker[ 1 ] ) );
+		coordinator_channels.emplace_back( new shard_channel( from_worker[ 0 ], to_worker[ 1 ] ) );
+		workers.emplace_back( [&shard_data, &worker_channels, s]() {
+			serve_shard( *shard_data[ s ], *worker_channels[ s ], 2 );
+		} );
+	}
+	bool sharded_agree = shard_rows == packed.num_instances() && shard_data[ 0 ]->num_instances() == 0;
+	{
+		sharded_dataset<int> sharded( std::move( coordinator_channels ) );
+		sharded_agree = sharded_agree && sharded.num_shards() == 4 && sharded.num_instances() == packed.num_instances()
+			&& sharded.num_attributes() == packed.num_attributes();
+		std::array<std::size_t,7> all_attributes = { 0, 1, 2, 3, 4, 5, 6 };
+		std::array<double,7 * 7> packed_table, sharded_table;
+		packed.mutual_information_table( all_attributes.data(), 7, all_attributes.data(), 7, packed_table.data() );
+		sharded.mutual_information_table( all_attributes.data(), 7, all_attributes.data(), 7, sharded_table.data() );
+		sharded_agree = sharded_agree && packed_table == sharded_table;
+		for( std::size_t a = 0; a < packed_values.size(); ++a ) {
+			sharded_agree = sharded_agree && sharded.attribute_entropy( a ) == packed.attribute_entropy( a )
+				&& sharded.attribute_info( a ).values() == packed.attribute_info( a ).values();
+		}
+		// tables too large for the budget are summed as sparse counts
+		packed.set_histogram_budget( 0 );
+		sharded.set_histogram_budget( 0 );
+		sharded_agree = sharded_agree && std::abs( sharded.mutual_information( 6, 5 ) - packed.mutual_information( 6, 5 ) ) < 1e-12;
+		packed.set_histogram_budget( dataset<int>::default_histogram_budget );
+		sharded.set_histogram_budget( dataset<int>::default_histogram_budget );
+		std::vector<mrmr_result> packed_ranking = mrmr( packed, 4, 0, mrmr_method_type::MIQ, 1 );
+		std::vector<mrmr_result> sharded_ranking = mrmr( sharded, 4, 0, mrmr_method_type::MIQ, 3 );
+		sharded_agree = sharded_agree && packed_ranking.size() == sharded_ranking.size();
+		for( std::size_t i = 0; sharded_agree && i < packed_ranking.size(); ++i ) {
+			sharded_agree = packed_ranking[ i ].index == sharded_ranking[ i ].index && ( i == 0 || packed_ranking[ i ].score == sharded_ranking[ i ].score );
+		}
+	}
+	for( auto & worker : workers ) {
+		worker.join();
+	}
+	for( int fd : pipe_fds ) {
+		close( fd );
+	}
+	std::cerr << test( sharded_agree ) << std::endl;
+	std::cerr << "Testing streaming_dataset against dataset: ";
+	std::string streaming_path( "tests_streaming.tmp" );
+	{
+		std::ofstream streaming_ofs( streaming_path, std::ios::binary );
+		streaming_ofs << packed_text;
+	}
+	bool streaming_agree;
+	{
+		// blocks much shorter than the text and a budget of a few tables force many blocks and passes
+		streaming_dataset<int> streaming( streaming_path, dataset<int>::ROUND, 2, 1024, 97 );
+		streaming_agree = streaming.num_passes() == 1 && streaming.num_instances() == packed.num_instances()
+			&& streaming.num_attributes() == packed.num_attributes();
+		for( std::size_t a = 0; a < packed_values.size(); ++a ) {
+			streaming_agree = streaming_agree && streaming.attribute_name( a ) == packed.attribute_name( a )
+				&& streaming.attribute_entropy( a ) == packed.attribute_entropy( a )
+				&& streaming.attribute_info( a ).values() == packed.attribute_info( a ).values();
+		}
+		std::array<std::size_t,7> all_attributes = { 0, 1, 2, 3, 4, 5, 6 };
+		std::array<double,7 * 7> packed_table, streaming_table;
+		packed.mutual_information_table( all_attributes.data(), 7, all_attributes.data(), 7, packed_table.data() );
+		streaming.mutual_information_table( all_attributes.data(), 7, all_attributes.data(), 7, streaming_table.data() );
+		streaming_agree = streaming_agree && packed_table == streaming_table && streaming.num_passes() > 2;
+		packed.set_histogram_budget( 0 );
+		streaming.set_histogram_budget( 0 );
+		streaming_agree = streaming_agree && std::abs( streaming.mutual_information( 6, 5 ) - packed.mutual_information( 6, 5 ) ) < 1e-12;
+		packed.set_histogram_budget( dataset<int>::default_histogram_budget );
+		streaming.set_histogram_budget( dataset<int>::default_histogram_budget );
+		std::vector<mrmr_result> packed_ranking = mrmr( packed, 4, 0, mrmr_method_type::MIQ, 1 );
+		std::vector<mrmr_result> streaming_ranking = mrmr( streaming, 4, 0, mrmr_method_type::MIQ, 1 );
+		streaming_agree = streaming_agree && packed_ranking.size() == streaming_ranking.size();
+		for( std::size_t i = 0; streaming_agree && i < packed_ranking.size(); ++i ) {
+			streaming_agree = packed_ranking[ i ].index == streaming_ranking[ i ].index && ( i == 0 || packed_ranking[ i ].score == streaming_ranking[ i ].score );
+		}
+	}
+	std::remove( streaming_path.c_str() );
+	std::cerr << test( streaming_agree ) << std::endl;
+	std::cerr << "Testing synthetic_data: ";
+	synthetic_options synthetic_shape;
+	synthetic_shape.num_rows = 3000;
+	synthetic_shape.num_attributes = 12;
+	synthetic_shape.num_classes = 3;
+	synthetic_shape.class_balance = 0.5;
+	synthetic_shape.seed = 7;
+	synthetic_data synthetic( synthetic_shape );
+	std::string synthetic_text = synthetic.text();
+	dataset<value> synthetic_parsed( synthetic_text.data(), synthetic_text.data() + synthetic_text.size() );
+	bool synthetic_agree = synthetic.values() == synthetic_data( synthetic_shape ).values() && synthetic_parsed.num_instances() == 3000
+			&& synthetic_parsed.num_attributes() == 13 && synthetic_parsed.attribute_name( 12 ) == "a12";
+	std::size_t first_class = 0;
+	for( std::size_t row = 0; row < synthetic.num_rows(); ++row ) {
+		first_class += synthetic.value( row, 0 ) == 0;
+		for( std::size_t column = 0; column < synthetic.num_columns(); ++column ) {
+			synthetic_agree = synthetic_agree && synthetic_parsed.attribute_info( column ).value( static_cast<value>( synthetic_parsed.columns().get( column, row ) ) ) == synthetic.value( row, column );
+		}
+	}
+	auto synthetic_ranks = mrmr( synthetic_parsed, 0, 2 );
+	synthetic_agree = synthetic_agree && first_class > 1350 && first_class < 1650 && synthetic_ranks.size() == 3 && synthetic_ranks[ 1 ].name == "a1"
+			&& synthetic_parsed.mutual_information( 0, 1 ) > synthetic_parsed.mutual_information( 0, 12 );
+	std::cerr << test( synthetic_agree ) << std::endl;
+	std::cerr << "Testing statistics counters and phases: ";
+	statistics & stats = *statistics::get();
+	stats.reset();
+	stats.begin_phase( "outer" );
+	{
+		statistics_phase inner( "inner" );
+		synthetic_parsed.mutual_information( 0, 1 );
+	}
+	std::size_t stats_candidates[] = { 2, 3, 4 };
+	double stats_out[ 3 ];
+	synthetic_parsed.mutual_information_many( 0, stats_candidates, 3, stats_out );
+	stats.end_phase();
+	std::string stats_json = stats.json();
+	std::size_t inner_at = stats_json.find( "\"inner\"" );
+	bool stats_agree = stats.mutual_information_calls() == 4 && stats.rows_scanned() == 4 * 3000 && stats.histogram_cells() == 4 * 3 * 4
+			&& stats_json.find( "\"outer\"" ) < inner_at && inner_at != std::string::npos
+			&& stats_json.find( "\"mutual_information_calls\": 1, \"rows_scanned\": 3000", inner_at ) != std::string::npos
+			&& stats.peak_rss_bytes() > 0 && stats.cpu_seconds() > 0.0;
+	stats.reset();
+	stats_agree = stats_agree && stats.mutual_information_calls() == 0 && stats.json().find( "\"phases\": []" ) != std::string::npos;
+	std::cerr << test( stats_agree ) << std::endl;
+	std::cerr << "Testing dataset with columns of mixed widths: ";
+	std::ostringstream mixed_text;
+	mixed_text << "c\tsmall\tshort\twide\tsigned\tmany\n";
+	for( int row = 0; row < 2000; ++row ) {
+		int small = ( row * 7 ) % 5;
+		mixed_text << row % 3 << '\t' << small << '\t' << 300 + small * 1000 << '\t' << 70000 + small * 100000 << '\t' << small - 2 << '\t' << row % 700 << '\n';
+	}
+	std::string mixed_string = mixed_text.str();
+	dataset<std::int32_t> mixed( mixed_string.data(), mixed_string.data() + mixed_string.size() );
+	std::ostringstream mixed_written;
+	mixed_written << mixed;
+	bool mixed_agree = mixed_written.str() == mixed_string && mixed.columns().bits( 3 ) == 4 && mixed.columns().bits( 5 ) == 16;
+	for( std::size_t attribute = 2; attribute <= 4; ++attribute ) {
+		mixed_agree = mixed_agree && std::abs( mixed.attribute_entropy( attribute ) - mixed.attribute_entropy( 1 ) ) < 1e-12
+				&& std::abs( mixed.mutual_information( 0, attribute ) - mixed.mutual_information( 0, 1 ) ) < 1e-12;
+	}
+	double mixed_dense[ 2 ] = { mixed.mutual_information( 1, 5 ), mixed.mutual_information( 5, 0 ) };
+	mixed.set_histogram_budget( 0 );
+	mixed_agree = mixed_agree && std::abs( mixed.mutual_information( 1, 5 ) - mixed_dense[ 0 ] ) < 1e-12
+			&& std::abs( mixed.mutual_information( 5, 0 ) - mixed_dense[ 1 ] ) < 1e-12 && mixed_dense[ 0 ] > 0.0;
+	std::cerr << test( mixed_agree ) << std::endl;
+	std::cerr << "Testing binning methods: ";
+	// each noise value occurs once with each class, so no cut tells the classes apart
+	std::ostringstream binning_text;
+	binning_text << "c\tx\tnoise\n";
+	for( int row = 0; row < 3000; ++row ) {
+		double noise = ( row * 7919 % 1000 ) / 1000.0;
+		binning_text << row % 3 << '\t' << row % 3 + 0.8 * noise << '\t' << noise << '\n';
+	}
+	std::string binning_string = binning_text.str();
+	binning_options binning;
+	binning.num_bins = 4;
+	binning.method = binning_method::EQUAL_WIDTH;
+	dataset<int> equal_width( binning_string.data(), binning_string.data() + binning_string.size(), dataset<int>::ROUND, 2, binning );
+	binning.method = binning_method::EQUAL_FREQUENCY;
+	dataset<int> equal_frequency( binning_string.data(), binning_string.data() + binning_string.size(), dataset<int>::ROUND, 2, binning );
+	bool binning_agree = equal_width.attribute_info( 0 ).counts() == std::vector<std::size_t>( 3, 1000 )
+			&& equal_width.attribute_info( 2 ).counts() == std::vector<std::size_t>( 4, 750 ) && equal_frequency.attribute_info( 2 ).counts().size() == 4;
+	for( std::size_t count : equal_frequency.attribute_info( 2 ).counts() ) {
+		binning_agree = binning_agree && count > 700 && count < 800;
+	}
+	// a sketch holding every row makes each distinct value a candidate cut, so MDL is exact
+	binning.method = binning_method::MDL;
+	binning.class_attributes = { 0 };
+	binning.sketch_capacity = 4096;
+	dataset<int> mdl( binning_string.data(), binning_string.data() + binning_string.size(), dataset<int>::ROUND, 2, binning );
+	binning_agree = binning_agree && mdl.attribute_info( 1 ).counts() == std::vector<std::size_t>( 3, 1000 )
+			&& std::abs( mdl.mutual_information( 0, 1 ) - mdl.attribute_entropy( 0 ) ) < 1e-12 && mdl.attribute_info( 2 ).counts().size() == 1;
+	std::string binning_path( "tests_binning.tmp" );
+	{
+		std::ofstream binning_ofs( binning_path, std::ios::binary );
+		binning_ofs << binning_string;
+	}
+	for( dataset<int> const * binned : { &equal_frequency, &mdl } ) {
+		binning.method = binned == &mdl ? binning_method::MDL : binning_method::EQUAL_FREQUENCY;
+		binning.sketch_capacity = binned == &mdl ? 4096 : 512;
+		streaming_dataset<int> streaming( binning_path, dataset<int>::ROUND, 2, 1024, 997, binning );
+		for( std::size_t a = 0; a < 3; ++a ) {
+			binning_agree = binning_agree && streaming.attribute_info( a ).counts() == binned->attribute_info( a ).counts();
+		}
+	}
+	std::remove( binning_path.c_str() );
+	std::cerr << test( binning_agree ) << std::endl;
+	std::cerr << "Testing sparse columns and libsvm input: ";
+	// the same rows as libsvm text, with a comment, an explicit 0 and a value rounding to 0, and as a table
+	std::ostringstream libsvm_text, table_text;
+	libsvm_text << "# rows of a label and index:value pairs\n";
+	table_text << "class";
+	for( int attribute = 1; attribute <= 40; ++attribute ) {
+		table_text << '\t' << attribute;
+	}
+	table_text << '\n';
+	for( int row = 0; row < 3000; ++row ) {
+		libsvm_text << row % 3;
+		table_text << row % 3;
+		for( int attribute = 1; attribute <= 40; ++attribute ) {
+			int value = attribute == 1 ? ( row % 3 == 2 ) : ( row * 31 + attribute * 7 ) % 97 == 0 ? 1 + row % 3 - 2 * ( attribute % 5 == 0 ) : 0;
+			if( value != 0 || ( attribute == 3 && row % 50 == 0 ) ) {
+				libsvm_text << ' ' << attribute << ':' << value;
+			} else if( attribute == 4 && row % 70 == 0 ) {
+				libsvm_text << ' ' << attribute << ":0.3";
+			}
+			table_text << '\t' << value;
+		}
+		libsvm_text << ( row % 100 == 0 ? "  # trailing comment\n\n" : "\n" );
+		table_text << '\n';
+	}
+	std::string libsvm_string = libsvm_text.str();
+	std::string table_string = table_text.str();
+	dataset<int> from_libsvm = dataset<int>::from_libsvm( libsvm_string.data(), libsvm_string.data() + libsvm_string.size(), dataset<int>::ROUND, 2 );
+	dataset<int> from_table( table_string.data(), table_string.data() + table_string.size() );
+	std::ostringstream libsvm_written, table_written;
+	libsvm_written << from_libsvm;
+	table_written << from_table;
+	bool sparse_agree = libsvm_written.str() == table_written.str() && from_libsvm.num_instances() == 3000 && from_libsvm.num_attributes() == 41
+			&& ! from_libsvm.columns().is_sparse( 1 ) && from_libsvm.columns().is_sparse( 2 ) && from_table.columns().is_sparse( 2 )
+			&& from_libsvm.columns().memory_usage() < from_libsvm.columns().num_columns() * 3000 / 8;
+	std::vector<std::size_t> sparse_attributes( 41 );
+	for( std::size_t a = 0; a < sparse_attributes.size(); ++a ) {
+		sparse_attributes[ a ] = a;
+		sparse_agree = sparse_agree && from_libsvm.attribute_info( a ).counts() == from_table.attribute_info( a ).counts();
+	}
+	// packed columns mapped back from a binary file and the joint tables of hashed rows count the same pairs another way
+	std::string sparse_path( "tests_sparse.tmp" );
+	{
+		std::ofstream sparse_ofs( sparse_path, std::ios::binary );
+		from_libsvm.save_binary( sparse_ofs );
+	}
+	{
+		dataset<int> packed_sparse = dataset<int>::open_binary( sparse_path );
+		std::vector<double> sparse_table( 41 * 41 ), packed_sparse_table( 41 * 41 );
+		from_libsvm.mutual_information_table( sparse_attributes.data(), 41, sparse_attributes.data(), 41, sparse_table.data() );
+		packed_sparse.mutual_information_table( sparse_attributes.data(), 41, sparse_attributes.data(), 41, packed_sparse_table.data() );
+		from_libsvm.set_histogram_budget( 0 );
+		for( std::size_t a = 0; a < 41; ++a ) {
+			for( std::size_t c = 0; c < 41; ++c ) {
+				sparse_agree = sparse_agree && std::abs( sparse_table[ a * 41 + c ] - packed_sparse_table[ a * 41 + c ] ) < 1e-12
+						&& std::abs( sparse_table[ a * 41 + c ] - from_libsvm.mutual_information( a, c ) ) < 1e-12;
+			}
+		}
+		sparse_agree = sparse_agree && sparse_table[ 1 ] > 0.9 && packed_sparse.columns().memory_usage() == 0;
+	}
+	std::remove( sparse_path.c_str() );
+	std::cerr << test( sparse_agree ) << std::endl;
+	std::cerr << "Testing best_mrmr_score kernels: ";
+	bool scores_agree = true;
+	for( bool quotient : { false, true } ) {
+		for( std::size_t length : { 0, 7, 37 } ) {
+			// every fifth candidate ties for the best score and indices are shuffled, so the tie must go to the greatest index wherever it is
+			std::vector<double> relevance( length ), mi( length ), start( length );
+			std::vector<std::size_t> indices( length );
+			std::size_t expected_position = length;
+			for( std::size_t i = 0; i < length; ++i ) {
+				relevance[ i ] = i % 5 == 3 ? 10.0 : 1.0 + 0.1 * ( i % 5 );
+				start[ i ] = 0.5 * ( i % 5 ) + 0.5;
+				mi[ i ] = 0.25 * ( i % 5 );
+				indices[ i ] = ( i * 17 ) % 101;
+				if( i % 5 == 3 && ( expected_position == length || indices[ i ] > indices[ expected_position ] ) ) {
+					expected_position = i;
+				}
+			}
+			double expected_score = quotient ? 10.0 / ( 2.75 / 3.0 + 0.0001 ) : 10.0 - 2.75 / 3.0;
+			for( kernel_type kernel : { SCALAR_KERNEL, AVX2_KERNEL, AVX512_KERNEL } ) {
+				if( ! kernels_supported( kernel ) ) {
+					continue;
+				}
+				select_kernels( kernel );
+				std::vector<double> redundance( start );
+				double score = 0.0;
+				std::size_t position = active_kernels().best_mrmr_score( relevance.data(), redundance.data(), mi.data(), indices.data(),
+						length, 3.0, quotient, &score );
+				scores_agree = scores_agree && position == expected_position && ( length == 0 || score == expected_score );
+				for( std::size_t i = 0; i < length; ++i ) {
+					scores_agree = scores_agree && redundance[ i ] == start[ i ] + mi[ i ];
+				}
+			}
+		}
+	}
+	select_kernels( AUTO_KERNEL );
+	std::cerr << test( scores_agree ) << std::endl;
+	std::cerr << "Testing dataset::holds at the limits of the value type: ";
+	std::cerr << test( dataset<int>::holds( 2147483647.0 ) && dataset<int>::holds( -2147483648.0 ) && ! dataset<int>::holds( 2147483648.0 )
+			&& ! dataset<int>::holds( -2147483649.0 ) && ! dataset<int>::holds( 5e9 ) && ! dataset<int>::holds( std::nan( "" ) )
+			&& dataset<unsigned char>::holds( 255.0 ) && ! dataset<unsigned char>::holds( 256.0 ) && ! dataset<unsigned char>::holds( -1.0 ) ) << std::endl;
+	std::cerr << "Testing statistics phases begun on several threads: ";
+	stats.reset();
+	stats.begin_phase( "outer" );
+	std::thread phase_thread( []() {
+		statistics_phase worker( "worker" );
+	} );
+	phase_thread.join();
+	std::string threads_json = stats.json();
+	std::size_t outer_at = threads_json.find( "\"outer\"" );
+	std::size_t worker_at = threads_json.find( "\"worker\"" );
+	// a phase of another thread is not nested in the one open here, and a reset there ends it
+	bool threads_agree = outer_at < worker_at && worker_at != std::string::npos && threads_json.find( "\"phases\": [] }", outer_at ) < worker_at;
+	std::thread reset_thread( [&stats]() {
+		stats.reset();
+	} );
+	reset_thread.join();
+	stats.end_phase();
+	stats.begin_phase( "after" );
+	stats.end_phase();
+	threads_json = stats.json();
+	threads_agree = threads_agree && threads_json.find( "\"outer\"" ) == std::string::npos && threads_json.find( "\"after\"" ) != std::string::npos;
+	stats.reset();
+	std::cerr << test( threads_agree ) << std::endl;
+	std::cerr << "Testing thread_pool.parallel_for rethrowing the exception of a thread: ";
+	thread_pool throwing_pool( 4 );
+	bool throwing_agree = true;
+	for( std::size_t failing : { std::size_t( 0 ), std::size_t( 999 ) } ) {
+		try {
+			throwing_pool.parallel_for( 0, 1000, 1, [failing]( std::size_t begin, std::size_t, std::size_t ) {
+				if( begin == failing ) {
+					throw std::runtime_error( "failed" );
+				}
+			} );
+			throwing_agree = false;
+		} catch( std::runtime_error const & ) {
+		}
+	}
+	// the pool is still usable after a failed loop
+	std::atomic<std::size_t> throwing_sum( 0 );
+	throwing_pool.parallel_for( 0, 1000, [&throwing_sum]( std::size_t i ) {
+		throwing_sum += i;
+	} );
+	std::cerr << test( throwing_agree && throwing_sum == 999 * 1000 / 2 ) << std::endl;
 	return 0;
 }
 
@@ -0,0 +1,459 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include "text_parser.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+/* Block size used when reading streams that cannot be mapped. */
+const std::size_t read_block_size = 1 << 24;
+
+/* Chunks handed to each thread, so uneven rows still balance. */
+const std::size_t chunks_per_thread = 4;
+
+/* Smallest chunk worth handing to a thread. */
+const std::size_t min_chunk_bytes = 1 << 16;
+
+/* Powers of ten that are exactly representable as doubles. */
+const double exact_powers_of_ten[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+const std::uint64_t max_exact_mantissa = std::uint64_t( 1 ) << 53;
+
+inline bool is_digit( char c ) {
+	return c >= '0' && c <= '9';
+}
+
+inline bool is_end_of_line( char const * p, char const * last ) {
+	return p == last || *p == '\n' || ( *p == '\r' && p + 1 != last && p[ 1 ] == '\n' );
+}
+
+/* Slow path for numbers outside the exact fast path, such as very long mantissas. */
+bool parse_number_strtod( char const * first, char const * last, double & value ) {
+	std::string token( first, last );
+	char * end;
+	value = std::strtod( token.c_str(), &end );
+	return end == token.c_str() + token.size();
+}
+
+struct table_chunk {
+	char const * first;
+	char const * last;
+	std::size_t first_row;
+	std::size_t num_rows;
+	std::size_t error_row;
+	std::string error;
+};
+
+void parse_chunk( table_chunk & chunk, std::size_t num_columns, std::size_t row_offset, table_sink & sink ) {
+	char const * p = chunk.first;
+	std::vector<double> out( num_columns );
+	for( std::size_t row = 0; row < chunk.num_rows; ++row ) {
+		std::size_t column_num = 0;
+		while( true ) {
+			char const * token = p;
+			while( p != chunk.last && *p == ' ' ) {
+				++p;
+			}
+			double value;
+			bool parsed = parse_number( p, chunk.last, value );
+			if( ! parsed || ( p != chunk.last && *p != '\t' && ! is_end_of_line( p, chunk.last ) ) ) {
+				char const * token_end = p;
+				while( token_end != chunk.last && *token_end != '\t' && *token_end != '\n' ) {
+					++token_end;
+				}
+				chunk.error_row = chunk.first_row + row;
+				chunk.error = "invalid value '" + std::string( token, token_end ) + "' at line " + std::to_string( row_offset + chunk.first_row + row + 1 )
+					+ ", column " + std::to_string( column_num + 1 );
+				return;
+			}
+			if( column_num < num_columns ) {
+				out[ column_num ] = value;
+			}
+			++column_num;
+			if( p != chunk.last && *p == '\t' ) {
+				++p;
+				continue;
+			}
+			// end of the row
+			if( column_num != num_columns ) {
+				chunk.error_row = chunk.first_row + row;
+				chunk.error = "inconsistent number of columns at matrix row " + std::to_string( row_offset + chunk.first_row + row + 1 );
+				return;
+			}
+			std::size_t num_stored = sink.store_row( chunk.first_row + row, out.data() );
+			if( num_stored != num_columns ) {
+				chunk.error_row = chunk.first_row + row;
+				chunk.error = "value out of range at line " + std::to_string( row_offset + chunk.first_row + row + 1 )
+					+ ", column " + std::to_string( num_stored + 1 );
+				return;
+			}
+			p = std::find( p, chunk.last, '\n' );
+			if( p != chunk.last ) {
+				++p;
+			}
+			break;
+		}
+	}
+}
+
+/* Splits [first, last) at newlines into chunks for num_threads threads. */
+std::vector<table_chunk> split_chunks( char const * first, char const * last, std::size_t num_threads ) {
+	std::size_t size = static_cast<std::size_t>( last - first );
+	std::size_t num_chunks = std::max<std::size_t>( 1, std::min( num_threads * chunks_per_thread, size / min_chunk_bytes ) );
+	std::vector<table_chunk> chunks;
+	char const * chunk_first = first;
+	for( std::size_t i = 1; i <= num_chunks && chunk_first != last; ++i ) {
+		char const * chunk_last = i == num_chunks ? last : std::max( chunk_first, first + size / num_chunks * i );
+		chunk_last = std::find( chunk_last, last, '\n' );
+		if( chunk_last != last ) {
+			++chunk_last;
+		}
+		chunks.push_back( table_chunk{ chunk_first, chunk_last, 0, 0, std::numeric_limits<std::size_t>::max(), std::string() } );
+		chunk_first = chunk_last;
+	}
+	return chunks;
+}
+
+/* Entries of a chunk of sparse rows, in the order parsed, on rows numbered from the chunk's first. */
+struct sparse_chunk_entries {
+	std::vector<std::uint32_t> columns;
+	std::vector<std::uint32_t> rows;
+	std::vector<double> values;
+	std::size_t num_lines = 0;
+};
+
+inline bool is_blank( char c ) {
+	return c == ' ' || c == '\t';
+}
+
+/*
+ * Parses the sparse rows of a chunk. num_rows counts the rows parsed and error_row holds
+ * the line of the chunk an error is on, numbered from 0, until the lines of the chunks
+ * before it are known.
+ */
+void parse_sparse_chunk( table_chunk & chunk, sparse_chunk_entries & entries ) {
+	char const * p = chunk.first;
+	while( p != chunk.last ) {
+		char const * line_end = std::find( p, chunk.last, '\n' );
+		char const * next_line = line_end == chunk.last ? line_end : line_end + 1;
+		line_end = std::find( p, line_end, '#' );
+		while( line_end != p && ( is_blank( line_end[ -1 ] ) || line_end[ -1 ] == '\r' ) ) {
+			--line_end;
+		}
+		while( p != line_end && is_blank( *p ) ) {
+			++p;
+		}
+		if( p == line_end ) {
+			++entries.num_lines;
+			p = next_line;
+			continue;
+		}
+
+		std::uint32_t const row = static_cast<std::uint32_t>( chunk.num_rows );
+		std::uint64_t last_index = 0;
+		bool is_label = true;
+		while( p != line_end ) {
+			char const * token = p;
+			std::uint64_t index = 0;
+			bool valid = true;
+			if( ! is_label ) {
+				while( p != line_end && is_digit( *p ) && index < std::numeric_limits<std::uint32_t>::max() ) {
+					index = index * 10 + static_cast<std::uint64_t>( *p++ - '0' );
+				}
+				valid = p != token && p != line_end && *p == ':' && index > last_index && index < std::numeric_limits<std::uint32_t>::max();
+				p += valid;
+			}
+			double value;
+			if( ! valid || ! parse_number( p, line_end, value ) || ( p != line_end && ! is_blank( *p ) ) ) {
+				char const * token_end = token;
+				while( token_end != line_end && ! is_blank( *token_end ) ) {
+					++token_end;
+				}
+				chunk.error_row = entries.num_lines;
+				chunk.error = std::string( is_label ? "invalid label '" : "invalid entry '" ) + std::string( token, token_end )
+					+ ( is_label || index > last_index ? "'" : "', indices must increase along a row," );
+				return;
+			}
+			entries.columns.push_back( static_cast<std::uint32_t>( index ) );
+			entries.rows.push_back( row );
+			entries.values.push_back( value );
+			last_index = index;
+			is_label = false;
+			while( p != line_end && is_blank( *p ) ) {
+				++p;
+			}
+		}
+		++chunk.num_rows;
+		++entries.num_lines;
+		p = next_line;
+	}
+}
+
+/* Collects a table row-major into a valarray. */
+class values_sink : public table_sink {
+	public:
+		values_sink( std::size_t & num_rows, std::size_t & num_columns, std::valarray<double> & values ) :
+				_num_rows( num_rows ), _num_columns( num_columns ), _values( values ) {
+		}
+
+		void begin( std::size_t num_rows, std::size_t num_columns ) override {
+			_num_rows = num_rows;
+			_num_columns = num_columns;
+			_values.resize( num_rows * num_columns );
+		}
+
+		std::size_t store_row( std::size_t row, double const * values ) override {
+			std::copy( values, values + _num_columns, &_values[ row * _num_columns ] );
+			return _num_columns;
+		}
+
+	private:
+		std::size_t & _num_rows;
+		std::size_t & _num_columns;
+		std::valarray<double> & _values;
+};
+
+}
+
+table_sink::~table_sink() {
+}
+
+std::vector<char> read_stream( std::istream & is ) {
+	std::vector<char> text;
+	std::size_t size = 0;
+	while( is ) {
+		text.resize( size + read_block_size );
+		is.read( text.data() + size, static_cast<std::streamsize>( read_block_size ) );
+		size += static_cast<std::size_t>( is.gcount() );
+	}
+	text.resize( size );
+	return text;
+}
+
+char const * parse_header( char const * first, char const * last, std::vector<std::string> & names ) {
+	char const * line_end = std::find( first, last, '\n' );
+	char const * p = first;
+	while( true ) {
+		while( p != line_end && ( *p == '\t' || *p == ' ' || *p == '\r' ) ) {
+			++p;
+		}
+		if( p == line_end ) {
+			break;
+		}
+		char const * name = p;
+		while( p != line_end && *p != '\t' && *p != ' ' && *p != '\r' ) {
+			++p;
+		}
+		names.emplace_back( name, p );
+	}
+	return line_end == last ? nullptr : line_end + 1;
+}
+
+bool parse_number( char const * & first, char const * last, double & value ) {
+	char const * p = first;
+	bool negative = false;
+	if( p != last && ( *p == '-' || *p == '+' ) ) {
+		negative = *p == '-';
+		++p;
+	}
+
+	std::uint64_t mantissa = 0;
+	int exponent = 0;
+	bool any_digits = false;
+	bool exact = true;
+	for( ; p != last && is_digit( *p ); ++p ) {
+		any_digits = true;
+		if( mantissa < max_exact_mantissa ) {
+			mantissa = mantissa * 10 + static_cast<std::uint64_t>( *p - '0' );
+		} else {
+			exact = false;
+		}
+	}
+	if( p != last && *p == '.' ) {
+		++p;
+		for( ; p != last && is_digit( *p ); ++p ) {
+			any_digits = true;
+			if( mantissa < max_exact_mantissa ) {
+				mantissa = mantissa * 10 + static_cast<std::uint64_t>( *p - '0' );
+				--exponent;
+			} else if( *p != '0' ) {
+				exact = false;
+			}
+		}
+	}
+	if( ! any_digits ) {
+		// leave words such as inf and nan to strtod
+		char const * token_end = p;
+		while( token_end != last && ( ( *token_end >= 'a' && *token_end <= 'z' ) || ( *token_end >= 'A' && *token_end <= 'Z' ) ) ) {
+			++token_end;
+		}
+		if( token_end == p || ! parse_number_strtod( first, token_end, value ) ) {
+			return false;
+		}
+		first = token_end;
+		return true;
+	}
+	if( p != last && ( *p == 'e' || *p == 'E' ) ) {
+		char const * q = p + 1;
+		bool negative_exponent = false;
+		if( q != last && ( *q == '-' || *q == '+' ) ) {
+			negative_exponent = *q == '-';
+			++q;
+		}
+		if( q == last || ! is_digit( *q ) ) {
+			return false;
+		}
+		int written_exponent = 0;
+		for( ; q != last && is_digit( *q ); ++q ) {
+			if( written_exponent < 100000 ) {
+				written_exponent = written_exponent * 10 + ( *q - '0' );
+			}
+		}
+		exponent += negative_exponent ? -written_exponent : written_exponent;
+		p = q;
+	}
+
+	// a mantissa and a power of ten that are both exact give a correctly rounded quotient or product
+	if( exact && mantissa <= max_exact_mantissa && exponent >= -22 && exponent <= 22 ) {
+		value = static_cast<double>( mantissa );
+		value = exponent < 0 ? value / exact_powers_of_ten[ -exponent ] : value * exact_powers_of_ten[ exponent ];
+		value = negative ? -value : value;
+	} else if( ! parse_number_strtod( first, p, value ) ) {
+		return false;
+	}
+	first = p;
+	return true;
+}
+
+/*
+ * Rows are counted in a first parallel pass so the sink can allocate its storage once
+ * and each chunk be parsed straight into its rows in a second pass. Every chunk stops at
+ * its first malformed row and the earliest one is reported.
+ */
+void parse_table( char const * first, char const * last, std::size_t num_threads, table_sink & sink, std::size_t row_offset ) {
+	if( first == last ) {
+		sink.begin( 0, 0 );
+		return;
+	}
+
+	// the first row sets the number of columns
+	char const * first_line_end = std::find( first, last, '\n' );
+	std::size_t num_columns = static_cast<std::size_t>( std::count( first, first_line_end, '\t' ) ) + 1;
+
+	thread_pool pool( num_threads );
+	std::vector<table_chunk> chunks = split_chunks( first, last, pool.num_threads() );
+
+	pool.parallel_for( 0, chunks.size(), 1, [&chunks]( std::size_t begin, std::size_t, std::size_t ) {
+		table_chunk & chunk = chunks[ begin ];
+		chunk.num_rows = static_cast<std::size_t>( std::count( chunk.first, chunk.last, '\n' ) );
+		if( chunk.last[ -1 ] != '\n' ) {
+			++chunk.num_rows;
+		}
+	} );
+	std::size_t num_rows = 0;
+	for( auto & chunk : chunks ) {
+		chunk.first_row = num_rows;
+		num_rows += chunk.num_rows;
+	}
+
+	sink.begin( num_rows, num_columns );
+	pool.parallel_for( 0, chunks.size(), 1, [&chunks, num_columns, row_offset, &sink]( std::size_t begin, std::size_t, std::size_t ) {
+		parse_chunk( chunks[ begin ], num_columns, row_offset, sink );
+	} );
+
+	for( auto & chunk : chunks ) {
+		if( chunk.error_row != std::numeric_limits<std::size_t>::max() ) {
+			std::cerr << "error: " << chunk.error << "\n";
+			exit( 2 );
+		}
+	}
+}
+
+void parse_table( char const * first, char const * last, std::size_t num_threads,
+		std::size_t & num_rows, std::size_t & num_columns, std::valarray<double> & values ) {
+	values_sink sink( num_rows, num_columns, values );
+	parse_table( first, last, num_threads, sink );
+}
+
+/*
+ * Chunks are parsed in parallel into entries in the order of their rows, which are then
+ * placed column by column, so the entries of each column stay in increasing row order.
+ */
+void parse_sparse_table( char const * first, char const * last, std::size_t num_threads, sparse_table & table ) {
+	thread_pool pool( num_threads );
+	std::vector<table_chunk> chunks = split_chunks( first, last, pool.num_threads() );
+	std::vector<sparse_chunk_entries> entries( chunks.size() );
+	pool.parallel_for( 0, chunks.size(), 1, [&chunks, &entries]( std::size_t begin, std::size_t, std::size_t ) {
+		parse_sparse_chunk( chunks[ begin ], entries[ begin ] );
+	} );
+
+	std::size_t num_lines = 0;
+	table.num_rows = 0;
+	table.num_columns = 0;
+	for( std::size_t i = 0; i < chunks.size(); ++i ) {
+		if( chunks[ i ].error_row != std::numeric_limits<std::size_t>::max() ) {
+			std::cerr << "error: " << chunks[ i ].error << " at line " << num_lines + chunks[ i ].error_row + 1 << "\n";
+			exit( 2 );
+		}
+		chunks[ i ].first_row = table.num_rows;
+		table.num_rows += chunks[ i ].num_rows;
+		num_lines += entries[ i ].num_lines;
+		for( std::uint32_t column : entries[ i ].columns ) {
+			table.num_columns = std::max<std::size_t>( table.num_columns, column + std::size_t( 1 ) );
+		}
+	}
+	if( table.num_rows > std::numeric_limits<std::uint32_t>::max() ) {
+		std::cerr << "error: sparse input has more than " << std::numeric_limits<std::uint32_t>::max() << " rows\n";
+		exit( 2 );
+	}
+
+	table.offsets.assign( table.num_columns + 1, 0 );
+	for( auto const & chunk_entries : entries ) {
+		for( std::uint32_t column : chunk_entries.columns ) {
+			++table.offsets[ column + 1 ];
+		}
+	}
+	for( std::size_t column = 0; column < table.num_columns; ++column ) {
+		table.offsets[ column + 1 ] += table.offsets[ column ];
+	}
+	std::vector<std::size_t> next( table.offsets.begin(), table.offsets.end() - 1 );
+	table.rows.resize( table.offsets.back() );
+	table.values.resize( table.offsets.back() );
+	for( std::size_t i = 0; i < chunks.size(); ++i ) {
+		sparse_chunk_entries & chunk_entries = entries[ i ];
+		for( std::size_t entry = 0; entry < chunk_entries.columns.size(); ++entry ) {
+			std::size_t & position = next[ chunk_entries.columns[ entry ] ];
+			table.rows[ position ] = static_cast<std::uint32_t>( chunks[ i ].first_row + chunk_entries.rows[ entry ] );
+			table.values[ position ] = chunk_entries.values[ entry ];
+			++position;
+		}
+		chunk_entries = sparse_chunk_entries();
+	}
+}
@@ -0,0 +1,103 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MRMR_TEXT_PARSER_HPP
+#define MRMR_TEXT_PARSER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <valarray>
+#include <vector>
+
+/*
+ * Parser for the tab separated text the tools read: an optional header line of names
+ * followed by rows of numbers separated by tabs and terminated by newlines, or sparse
+ * rows in the libsvm format. Input is parsed from memory, either a mapped file or a
+ * stream read in large blocks, and rows are parsed on several threads in chunks split
+ * at newlines.
+ */
+
+/* Reads the remainder of a stream into memory. */
+std::vector<char> read_stream( std::istream & is );
+
+/*
+ * Splits the first line of [first, last) into names separated by whitespace. Returns the
+ * start of the following line, or nullptr when the line is not terminated by a newline.
+ */
+char const * parse_header( char const * first, char const * last, std::vector<std::string> & names );
+
+/*
+ * Receives the rows of a table as they are parsed. begin is called once the size of the
+ * table is known and before any row; store_row is then called once per row, possibly
+ * from several threads at once but never twice for the same row. store_row returns the
+ * number of columns of the row it stored, stopping at a value it cannot hold, which the
+ * parser then reports as malformed input.
+ */
+class table_sink {
+	public:
+		virtual ~table_sink();
+		virtual void begin( std::size_t num_rows, std::size_t num_columns ) = 0;
+		virtual std::size_t store_row( std::size_t row, double const * values ) = 0;
+};
+
+/*
+ * Parses rows of numbers in [first, last) into sink. Malformed input is reported on
+ * standard error with the first offending row and the program exits, as the stream
+ * extraction operator for matrices always has. row_offset is the number of rows of the
+ * input before first, so rows parsed a block at a time are reported by their place in
+ * the whole input.
+ */
+void parse_table( char const * first, char const * last, std::size_t num_threads, table_sink & sink, std::size_t row_offset = 0 );
+
+/* Parses rows of numbers in [first, last) into values, row-major. */
+void parse_table( char const * first, char const * last, std::size_t num_threads,
+		std::size_t & num_rows, std::size_t & num_columns, std::valarray<double> & values );
+
+/*
+ * A table parsed from sparse text in the libsvm format: one row per line, a label and
+ * then index:value pairs with indices increasing from 1, every value not given being 0.
+ * The label is column 0 and index i column i. The entries of column c, the values given
+ * for it and the rows they are on in increasing order, are [ offsets[ c ], offsets[ c + 1 ] )
+ * of rows and values.
+ */
+struct sparse_table {
+	std::size_t num_rows = 0;
+	std::size_t num_columns = 0;
+	std::vector<std::size_t> offsets;
+	std::vector<std::uint32_t> rows;
+	std::vector<double> values;
+};
+
+/*
+ * Parses sparse rows in [first, last) into table, on num_threads threads in chunks split
+ * at newlines. Blank lines and anything after a '#' are skipped; malformed input is
+ * reported with its line and the program exits, as parse_table does.
+ */
+void parse_sparse_table( char const * first, char const * last, std::size_t num_threads, sparse_table & table );
+
+/*
+ * Parses one number at first, independent of the locale, advancing first past it. The
+ * result is the same correctly rounded value std::strtod gives.
+ */
+bool parse_number( char const * & first, char const * last, double & value );
+
+#endif
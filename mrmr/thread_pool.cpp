@@ -0,0 +1,113 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "thread_pool.hpp"
+
+thread_pool::thread_pool( std::size_t num_threads ) : _task( nullptr ), _generation( 0 ), _running( 0 ), _stop( false ) {
+	if( num_threads == 0 ) {
+		num_threads = default_num_threads();
+	}
+	_workers.reserve( num_threads - 1 );
+	for( std::size_t thread_num = 1; thread_num < num_threads; ++thread_num ) {
+		_workers.emplace_back( &thread_pool::worker, this, thread_num );
+	}
+}
+
+thread_pool::~thread_pool() {
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		_stop = true;
+	}
+	_start.notify_all();
+	for( auto & thread : _workers ) {
+		thread.join();
+	}
+}
+
+std::size_t thread_pool::num_threads() const {
+	return _workers.size() + 1;
+}
+
+std::size_t thread_pool::default_num_threads() {
+	std::size_t n = std::thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
+void thread_pool::run( std::function<void( std::size_t )> const & task ) {
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		_task = &task;
+		_running = _workers.size();
+		++_generation;
+	}
+	_start.notify_all();
+
+	std::exception_ptr error;
+	try {
+		task( 0 );
+	} catch( ... ) {
+		error = std::current_exception();
+	}
+
+	// the task lives on the caller's stack, so the workers must be done with it even after a failure
+	std::unique_lock<std::mutex> lock( _mutex );
+	_finish.wait( lock, [this]() { return _running == 0; } );
+	_task = nullptr;
+	if( ! error ) {
+		error = _error;
+	}
+	_error = nullptr;
+	lock.unlock();
+	if( error ) {
+		std::rethrow_exception( error );
+	}
+}
+
+void thread_pool::worker( std::size_t thread_num ) {
+	std::size_t generation = 0;
+	while( true ) {
+		std::function<void( std::size_t )> const * task;
+		{
+			std::unique_lock<std::mutex> lock( _mutex );
+			_start.wait( lock, [this, generation]() { return _stop || _generation != generation; } );
+			if( _stop ) {
+				return;
+			}
+			generation = _generation;
+			task = _task;
+		}
+
+		std::exception_ptr error;
+		try {
+			( *task )( thread_num );
+		} catch( ... ) {
+			error = std::current_exception();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock( _mutex );
+			if( error && ! _error ) {
+				_error = error;
+			}
+			--_running;
+		}
+		_finish.notify_one();
+	}
+}
@@ -0,0 +1,116 @@
+/*
+Copyright (C) 2019 Michael Diponio
+Email: mdiponio@gmail.com
+
+This file is part of the Improved mRMR code base.
+
+Improved mRMR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Improved mRMR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MRMR_THREAD_POOL_HPP
+#define MRMR_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed size pool of worker threads. Work is submitted as a fork-join
+ * parallel loop; the calling thread takes part in the loop, so a pool of
+ * N threads starts N - 1 workers and a pool of 1 thread runs everything
+ * inline. An exception thrown by the loop body on any thread stops the
+ * loop handing out chunks and is rethrown to the caller once every thread
+ * has left the loop.
+ */
+class thread_pool {
+	public:
+		explicit thread_pool( std::size_t num_threads = 1 );
+		thread_pool( thread_pool const & ) = delete;
+		thread_pool & operator=( thread_pool const & ) = delete;
+		~thread_pool();
+
+		std::size_t num_threads() const;
+
+		/* Calls f( begin, end, thread_num ) over chunks of [first, last) of at most grain indices. */
+		template <typename Function> void parallel_for( std::size_t first, std::size_t last, std::size_t grain, Function f );
+
+		/* Calls f( i ) for every i in [first, last). */
+		template <typename Function> void parallel_for( std::size_t first, std::size_t last, Function f );
+
+		static std::size_t default_num_threads();
+
+	private:
+		void run( std::function<void( std::size_t )> const & task );
+		void worker( std::size_t thread_num );
+
+		std::vector<std::thread> _workers;
+		std::mutex _mutex;
+		std::condition_variable _start;
+		std::condition_variable _finish;
+		std::function<void( std::size_t )> const * _task;
+		std::size_t _generation;
+		std::size_t _running;
+		std::exception_ptr _error;
+		bool _stop;
+};
+
+template <typename Function>
+void thread_pool::parallel_for( std::size_t first, std::size_t last, std::size_t grain, Function f ) {
+	if( first >= last ) {
+		return;
+	}
+	if( grain == 0 ) {
+		grain = 1;
+	}
+	if( _workers.empty() || last - first <= grain ) {
+		for( std::size_t begin = first; begin < last; begin += grain ) {
+			f( begin, std::min( last, begin + grain ), std::size_t( 0 ) );
+		}
+		return;
+	}
+
+	// chunks are handed out dynamically so uneven work per index is balanced
+	std::atomic<std::size_t> next( first );
+	std::function<void( std::size_t )> task = [&]( std::size_t thread_num ) {
+		std::size_t begin;
+		while( ( begin = next.fetch_add( grain ) ) < last ) {
+			try {
+				f( begin, std::min( last, begin + grain ), thread_num );
+			} catch( ... ) {
+				// the remaining chunks are left once any thread fails
+				next = last;
+				throw;
+			}
+		}
+	};
+	run( task );
+}
+
+template <typename Function>
+void thread_pool::parallel_for( std::size_t first, std::size_t last, Function f ) {
+	std::size_t grain = ( last - first ) / ( 8 * num_threads() ) + 1;
+	parallel_for( first, last, grain, [&f]( std::size_t begin, std::size_t end, std::size_t ) {
+		for( std::size_t i = begin; i < end; ++i ) {
+			f( i );
+		}
+	} );
+}
+
+#endif
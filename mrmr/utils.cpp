@@ -35,17 +35,28 @@ logger *  logger::get() {
 void logger::message( char const * message, verbosity_level verbosity, message_type mtype ) {
 	if( _level >= verbosity ) {
 		if( mtype == STANDARD || mtype == START ) {
+			if( _line_open ) {
+				*_out << '\n';
+			}
 			std::time_t time = std::time( nullptr );
 			*_out << std::put_time( std::localtime( &time ), "%Y-%m-%d %H:%M:%S" ) << " - " << message;
 		}
 		if( mtype == STANDARD ) {
 			*_out << '\n';
+			_line_open = false;
 		} else if( mtype == START ) {
-			_start_time = std::chrono::high_resolution_clock::now();
-		} else if( mtype == FINISH ) {
+			_phases.emplace_back( std::chrono::high_resolution_clock::now(), message );
+			_line_open = true;
+		} else if( mtype == FINISH && ! _phases.empty() ) {
+			if( ! _line_open ) {
+				std::time_t time = std::time( nullptr );
+				*_out << std::put_time( std::localtime( &time ), "%Y-%m-%d %H:%M:%S" ) << " - " << _phases.back().second;
+			}
 			std::chrono::duration<double> time_span = std::chrono::duration_cast< std::chrono::duration<double> >( 
-                std::chrono::high_resolution_clock::now() - _start_time );
+                std::chrono::high_resolution_clock::now() - _phases.back().first );
 			*_out << "DONE (" << time_span.count() << " seconds)\n";
+			_phases.pop_back();
+			_line_open = false;
 		}
 	}
 }
@@ -23,6 +23,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <chrono>
 #include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
 
 enum verbosity_level : char {
     ERROR = -1,
@@ -37,8 +40,17 @@ enum message_type : char {
 	FINISH = 2
 };
 
+/*
+ * Process-wide log of messages at or below the level set. START messages open a phase
+ * that the next FINISH closes with its time; phases may nest, and a phase whose line was
+ * interrupted by inner messages is named again when it finishes. There is one instance,
+ * which is used through get() and cannot be copied.
+ */
 class logger {
     public:
+        logger( logger const & ) = delete;
+        logger & operator=( logger const & ) = delete;
+
         void message( const char * message, verbosity_level verbosity, message_type m_type = STANDARD );
 
         static logger * get();
@@ -50,12 +62,13 @@ class logger {
     private:
         static logger * _instance;
 
-        std::chrono::time_point<std::chrono::high_resolution_clock> _start_time;
+        std::vector<std::pair<std::chrono::time_point<std::chrono::high_resolution_clock>, std::string> > _phases;
+        bool _line_open;
         verbosity_level _level;
 
         std::ostream * _out;
 
-        logger(verbosity_level level, std::ostream& out): _level(level), _out(&out)
+        logger(verbosity_level level, std::ostream& out): _line_open(false), _level(level), _out(&out)
         { }      
 };
 
@@ -20,11 +20,12 @@
 
 from ctypes import *
 from enum import Enum
+from json import loads
 from os.path import realpath, dirname, isfile
-from typing import List, Tuple
+from typing import Dict, List, NamedTuple, Tuple, Union
 from sys import platform
 
-from numpy import ubyte, ushort, int32
+from numpy import ascontiguousarray, empty, frombuffer, ndarray, ubyte, ushort, int32, int64, float64
 from pandas import DataFrame
 
 
@@ -39,6 +40,31 @@ class MRMRMethod(Enum):
     MIQ = 1
 
 
+class MRMRResult(NamedTuple):
+    """
+    Ranking of features for one label as NumPy arrays, in order of rank:
+
+      - rank - position of each feature in the ranking, from 1
+      - index - column of each feature among the columns sent, of which the label is the first for a data frame
+      - entropy - entropy of each feature
+      - mutual_information - mutual information of each feature with the label
+      - score - MRMR score of each feature
+
+    Arrays returned by mrmr, mrmr_batch, mrmr_array and mrmr_array_batch view the native results in place
+    rather than copies; the native environment holding them is freed once no array refers to it.
+    """
+    rank: ndarray
+    index: ndarray
+    entropy: ndarray
+    mutual_information: ndarray
+    score: ndarray
+    columns: List[str]
+
+    def names(self) -> List[str]:
+        """Names of the ranked features."""
+        return [self.columns[i] for i in self.index.tolist()]
+
+
 class DataType(Enum):
     """
     Data types to send attributes to library.
@@ -54,6 +80,9 @@ _mrmr_lib = None
 # Configurations for different data type options.
 _data_type_options = None
 
+# Statistics of the last mrmr, mrmr_batch, mrmr_array or mrmr_array_batch call, as JSON.
+_last_stats = None
+
 
 def setup(path: str = None) -> None:
     """
@@ -89,18 +118,26 @@ def setup(path: str = None) -> None:
     if not _mrmr_lib:
         raise OSError("failed linking with library")
 
+    # Environments are pointers, which do not fit the default int return type on 64-bit platforms
+    _mrmr_lib.setup_mrmr.restype = c_void_p
+    _mrmr_lib.add_attributes.argtypes = [c_void_p, POINTER(c_char_p), c_void_p, c_int, c_size_t, c_size_t,
+                                         c_ssize_t, c_ssize_t, c_uint]
+    _mrmr_lib.get_result_offsets.restype = POINTER(c_int)
+    _mrmr_lib.get_results.restype = c_void_p
     _mrmr_lib.get_feature_ranks.restype = POINTER(c_char_p)
     _mrmr_lib.get_mrmr_score.restype = POINTER(c_double)
     _mrmr_lib.get_last_error.restype = c_char_p
+    _mrmr_lib.get_stats.restype = c_char_p
 
     _data_type_options = dict()
-    _data_type_options[DataType.UINT8] = (_mrmr_lib.add_attribute_uint8, POINTER(c_uint8), ubyte)
-    _data_type_options[DataType.UINT16] = (_mrmr_lib.add_attribute_uint16, POINTER(c_uint16), ushort)
-    _data_type_options[DataType.INT32] = (_mrmr_lib.add_attribute_int32, POINTER(c_int32), int32)
+    _data_type_options[ubyte] = DataType.UINT8
+    _data_type_options[ushort] = DataType.UINT16
+    _data_type_options[int32] = DataType.INT32
 
     
 def mrmr(dataset: DataFrame, features: List[str] = [], label: str = None, num_features: int = 0,
-         method: MRMRMethod = MRMRMethod.MID) -> Tuple[List[str], List[float]]:
+         method: MRMRMethod = MRMRMethod.MID, num_threads: int = 1, lazy: bool = False, sample_rows: int = 0,
+         tolerance: float = 0.0, arrays: bool = False) -> Union[Tuple[List[str], List[float]], MRMRResult]:
     """
     Run MRMR algorithm
 
@@ -109,26 +146,173 @@ def mrmr(dataset: DataFrame, features: List[str] = [], label: str = None, num_fe
     :param label: feature label (optional, default first column)
     :param num_features: top number of features to rank
     :param method: MRMR method (defaults to MID)
-    :return: tuple containing feature ranks and MRMR scores 
+    :param num_threads: number of threads, 0 for all available cores (defaults to 1)
+    :param lazy: rescore only candidates that may still be best, which gives the same ranking with less
+                 work when few features are ranked (defaults to False)
+    :param sample_rows: estimate scores on this many sampled rows and compute exactly only those of
+                        candidates that may be best, which gives the same ranking with high probability
+                        (defaults to 0, no sampling)
+    :param tolerance: score by which a sampled ranking may miss the best candidate (defaults to 0)
+    :param arrays: return the ranking as an MRMRResult of arrays viewing the native results rather than as
+                   lists (defaults to False)
+    :return: tuple containing feature ranks and MRMR scores, or an MRMRResult
     :raises OSError: native library not linked
     :raises MRMRError mRMR execution error
     """
     if not _mrmr_lib:
         raise OSError("native library not linked")
 
-    # Data type of data to send
-    dtype = DataType.INT32
+    if len(features) == 0:
+        features = list(dataset.columns)
+    else:
+        features = list(features)
 
-    # Create environment 
-    env = _mrmr_lib.setup_mrmr(c_int(dtype.value))
-    if not env:
-        raise MRMRError("failed setting up environment")
+    if not label:
+        label = features.pop(0)
+    elif label in features:
+        features.remove(label)
+    else:
+        raise MRMRError("label not in dataset")
+
+    columns = [label] + features
+    return _run_mrmr(_frame_values(dataset, columns), columns, [0], num_features, method, num_threads, lazy, sample_rows,
+                     tolerance, arrays)[0]
+
+
+def mrmr_batch(dataset: DataFrame, labels: List[str], features: List[str] = [], num_features: int = 0,
+               method: MRMRMethod = MRMRMethod.MID, num_threads: int = 1, lazy: bool = False, sample_rows: int = 0,
+               tolerance: float = 0.0, arrays: bool = False) -> Dict[str, Union[Tuple[List[str], List[float]], MRMRResult]]:
+    """
+    Run MRMR algorithm for several labels at once
+
+    The data is sent once and the mutual information between features that several
+    labels' rankings have in common is computed once. Each label is ranked against the
+    features and the other labels.
+
+    :param dataset: pandas data frame with feature values
+    :param labels: feature labels to rank against
+    :param features: list of features to use (optional, default all)
+    :param num_features: top number of features to rank
+    :param method: MRMR method (defaults to MID)
+    :param num_threads: number of threads, 0 for all available cores (defaults to 1)
+    :param lazy: rescore only candidates that may still be best, which gives the same ranking with less
+                 work when few features are ranked (defaults to False)
+    :param sample_rows: estimate scores on this many sampled rows and compute exactly only those of
+                        candidates that may be best, which gives the same ranking with high probability
+                        (defaults to 0, no sampling)
+    :param tolerance: score by which a sampled ranking may miss the best candidate (defaults to 0)
+    :param arrays: return each ranking as an MRMRResult of arrays viewing the native results rather than as
+                   lists (defaults to False)
+    :return: dictionary from each label to its feature ranks and MRMR scores, or to its MRMRResult
+    :raises OSError: native library not linked
+    :raises MRMRError mRMR execution error
+    """
+    if not _mrmr_lib:
+        raise OSError("native library not linked")
+
+    if len(features) == 0:
+        features = list(dataset.columns)
+
+    for label in labels:
+        if label not in dataset.columns:
+            raise MRMRError("label not in dataset")
+
+    columns = list(labels) + [feature for feature in features if feature not in labels]
+    results = _run_mrmr(_frame_values(dataset, columns), columns, list(range(len(labels))), num_features, method,
+                        num_threads, lazy, sample_rows, tolerance, arrays)
+    return dict(zip(labels, results))
 
-    try:
 
-        # Pass in data feature data
+def mrmr_array(data: ndarray, names: List[str], label: int = 0, num_features: int = 0,
+               method: MRMRMethod = MRMRMethod.MID, num_threads: int = 1, lazy: bool = False, sample_rows: int = 0,
+               tolerance: float = 0.0, arrays: bool = False) -> Union[Tuple[List[str], List[float]], MRMRResult]:
+    """
+    Run MRMR algorithm on a two dimensional array with one column per feature
+
+    The array is read in place by the native library in either row or column major order
+    when it holds uint8, uint16 or int32 values. Otherwise each column is converted to the narrowest of these
+    holding its values.
+
+    :param data: array of feature values with one row per instance
+    :param names: feature names, one per column
+    :param label: column index of the label (optional, default first column)
+    :param num_features: top number of features to rank
+    :param method: MRMR method (defaults to MID)
+    :param num_threads: number of threads, 0 for all available cores (defaults to 1)
+    :param lazy: rescore only candidates that may still be best, which gives the same ranking with less
+                 work when few features are ranked (defaults to False)
+    :param sample_rows: estimate scores on this many sampled rows and compute exactly only those of
+                        candidates that may be best, which gives the same ranking with high probability
+                        (defaults to 0, no sampling)
+    :param tolerance: score by which a sampled ranking may miss the best candidate (defaults to 0)
+    :param arrays: return the ranking as an MRMRResult of arrays viewing the native results rather than as
+                   lists (defaults to False)
+    :return: tuple containing feature ranks and MRMR scores, or an MRMRResult
+    :raises OSError: native library not linked
+    :raises MRMRError mRMR execution error
+    """
+    return _run_mrmr(data, names, [label], num_features, method, num_threads, lazy, sample_rows, tolerance,
+                     arrays)[0]
+
+
+def mrmr_array_batch(data: ndarray, names: List[str], labels: List[int], num_features: int = 0,
+                     method: MRMRMethod = MRMRMethod.MID, num_threads: int = 1, lazy: bool = False, sample_rows: int = 0,
+                     tolerance: float = 0.0, arrays: bool = False) -> List[Union[Tuple[List[str], List[float]], MRMRResult]]:
+    """
+    Run MRMR algorithm for several labels on a two dimensional array with one column per feature
+
+    :param data: array of feature values with one row per instance
+    :param names: feature names, one per column
+    :param labels: column indexes of the labels
+    :param num_features: top number of features to rank
+    :param method: MRMR method (defaults to MID)
+    :param num_threads: number of threads, 0 for all available cores (defaults to 1)
+    :param lazy: rescore only candidates that may still be best, which gives the same ranking with less
+                 work when few features are ranked (defaults to False)
+    :param sample_rows: estimate scores on this many sampled rows and compute exactly only those of
+                        candidates that may be best, which gives the same ranking with high probability
+                        (defaults to 0, no sampling)
+    :param tolerance: score by which a sampled ranking may miss the best candidate (defaults to 0)
+    :param arrays: return each ranking as an MRMRResult of arrays viewing the native results rather than as
+                   lists (defaults to False)
+    :return: feature ranks and MRMR scores, or an MRMRResult, for each label in order
+    :raises OSError: native library not linked
+    :raises MRMRError mRMR execution error
+    """
+    return _run_mrmr(data, names, labels, num_features, method, num_threads, lazy, sample_rows, tolerance, arrays)
+
+
+class MRMRSelector:
+    """
+    Greedy MRMR selection that can be continued
+
+    Data is sent and relevance to the label computed once; each call to extend selects
+    further features without recomputing any mutual information. The ranking after any
+    sequence of extends is the leading part of the ranking mrmr would give for the same
+    total number of features.
+    """
+
+    def __init__(self, dataset: DataFrame, features: List[str] = [], label: str = None,
+                 method: MRMRMethod = MRMRMethod.MID, num_threads: int = 1, lazy: bool = False, sample_rows: int = 0,
+                 tolerance: float = 0.0):
+        """
+        :param dataset: pandas data frame with feature values
+        :param features: list of features to use (optional, default all)
+        :param label: feature label (optional, default first column)
+        :param method: MRMR method (defaults to MID)
+        :param num_threads: number of threads, 0 for all available cores (defaults to 1)
+        :param lazy: rescore only candidates that may still be best (defaults to False)
+        :param sample_rows: estimate scores on this many sampled rows (defaults to 0, no sampling)
+        :param tolerance: score by which a sampled ranking may miss the best candidate (defaults to 0)
+        :raises OSError: native library not linked
+        :raises MRMRError mRMR execution error
+        """
+        self._env = None
+
         if len(features) == 0:
             features = list(dataset.columns)
+        else:
+            features = list(features)
 
         if not label:
             label = features.pop(0)
@@ -137,48 +321,241 @@ def mrmr(dataset: DataFrame, features: List[str] = [], label: str = None, num_fe
         else:
             raise MRMRError("label not in dataset")
 
-        dataset = dataset.dropna()
+        columns = [label] + features
+        self._columns = columns
+        self._env = _send_data(_frame_values(dataset, columns), columns, num_threads)
+        _set_evaluation(self._env, lazy, sample_rows, tolerance)
+
+        ret = _mrmr_lib.start_selection(c_void_p(self._env), c_uint(method.value), c_uint(0), c_uint(num_threads))
+        if ret < 0:
+            err = str(_mrmr_lib.get_last_error(c_void_p(self._env)), encoding='utf-8')
+            self.close()
+            raise MRMRError("Error %d, %s" % (ret, err))
+
+    def extend(self, num_features: int, arrays: bool = False) -> Union[Tuple[List[str], List[float]], MRMRResult]:
+        """
+        Select up to num_features more features
+
+        :param num_features: number of further features to rank
+        :param arrays: return the ranking as an MRMRResult of arrays rather than as lists (defaults to False); these
+                       are copies, as the next extend replaces the native results
+        :return: tuple containing all feature ranks and MRMR scores so far, or an MRMRResult
+        :raises MRMRError mRMR execution error
+        """
+        if not self._env:
+            raise MRMRError("selector closed")
+
+        num_ranked = _mrmr_lib.extend_selection(c_void_p(self._env), c_uint(num_features))
+        if num_ranked < 0:
+            err = str(_mrmr_lib.get_last_error(c_void_p(self._env)), encoding='utf-8')
+            raise MRMRError("Error %d, %s" % (num_ranked, err))
 
-        add_attribute, type_pointer, type_cast = _data_type_options[dtype]
+        result = _results(self._env, None, self._columns, 1)[0]
+        if arrays:
+            return MRMRResult(*(column.copy() for column in result[:5]), result.columns)
 
-        data = dataset[label].astype(type_cast)
-        add_attribute(c_void_p(env), c_char_p(label.encode('utf-8')),
-                      data.values.ctypes.data_as(type_pointer), c_int(data.size))
+        return _lists(result)
 
-        for feature in features:
-            data = dataset[feature].astype(type_cast)
-            add_attribute(c_void_p(env), c_char_p(feature.encode('utf-8')),
-                          data.values.ctypes.data_as(type_pointer), c_int(data.size))
+    def stats(self) -> dict:
+        """
+        Statistics of the selection so far: wall and CPU time of each phase, counts of mutual information
+        computed, rows scanned and histogram cells touched, and peak resident memory
 
-        # Run MRMR
-        num_ranked = _mrmr_lib.perform_mrmr(c_void_p(env), c_uint(method.value), c_uint(0), c_uint(num_features))
+        :return: statistics as parsed from JSON
+        :raises MRMRError mRMR execution error
+        """
+        if not self._env:
+            raise MRMRError("selector closed")
 
-        if num_ranked < 0:
-            # Error occurred
-            err = str(_mrmr_lib.get_last_error(env), encoding='utf-8')
-            raise MRMRError("Error %d, %s" % (num_ranked, err))
+        return loads(str(_mrmr_lib.get_stats(c_void_p(self._env)), encoding='utf-8'))
+
+    def close(self) -> None:
+        """Release the native selection state."""
+        if self._env:
+            _mrmr_lib.destroy_mrmr(c_void_p(self._env))
+            self._env = None
+
+    def __enter__(self):
+        return self
 
-        if num_ranked < 1:
-            # No features ranked
-            return [], []
+    def __exit__(self, *args):
+        self.close()
 
-        # Extract results
-        num = c_int()
-        buf = _mrmr_lib.get_feature_ranks(c_void_p(env), byref(num))
+    def __del__(self):
+        self.close()
 
-        ranks = []
-        for i in range(num.value):
-            ranks.append(buf[i].decode('utf-8'))
 
-        scores = []
-        score_buf = _mrmr_lib.get_mrmr_score(c_void_p(env), byref(num))
-        for i in range(num.value):
-            scores.append(score_buf[i])
+def last_stats() -> dict:
+    """
+    Statistics of the last mrmr, mrmr_batch, mrmr_array or mrmr_array_batch call: wall and CPU time of each
+    phase, counts of mutual information computed, rows scanned and histogram cells touched, and peak resident
+    memory. Calls running at the same time in one process share the counters, and each call starts the
+    statistics afresh, so a call overlapping another keeps only the phases begun after the other started.
+
+    :return: statistics as parsed from JSON, or None before any call
+    """
+    if _last_stats is None:
+        return None
+
+    return loads(str(_last_stats, encoding='utf-8'))
+
+
+def _frame_values(dataset: DataFrame, columns: List[str]) -> ndarray:
+    dataset = dataset.dropna()
+    if columns != list(dataset.columns):
+        dataset = dataset[columns]
+
+    # A frame holding a single supported type is sent as one block, usually without a copy
+    return dataset.to_numpy()
+
+
+def _send_data(data: ndarray, names: List[str], num_threads: int) -> int:
+    if not _mrmr_lib:
+        raise OSError("native library not linked")
 
-        return ranks, scores
+    if data.ndim != 2 or data.shape[1] != len(names):
+        raise MRMRError("data must be two dimensional with one column per name")
 
-    finally:
+    # Create environment; the library packs every column at the width its own values need
+    env = _mrmr_lib.setup_mrmr(c_int(DataType.INT32.value))
+    if not env:
+        raise MRMRError("failed setting up environment")
+
+    # Pass in all feature data at once when its type is supported, otherwise in runs of columns narrowed alike
+    num_instances = data.shape[0]
+    encoded_names = [str(name).encode('utf-8') for name in names]
+    ret = 0
+    for first, block in _column_blocks(data):
+        dtype = _data_type_options[block.dtype.type]
+        c_names = (c_char_p * block.shape[1])(*encoded_names[first:first + block.shape[1]])
+        ret = _mrmr_lib.add_attributes(c_void_p(env), c_names, c_void_p(block.ctypes.data), c_int(dtype.value),
+                                       c_size_t(num_instances), c_size_t(block.shape[1]),
+                                       c_ssize_t(block.strides[0]), c_ssize_t(block.strides[1]), c_uint(num_threads))
+        if ret < 0:
+            break
+
+    if ret < 0:
+        err = str(_mrmr_lib.get_last_error(c_void_p(env)), encoding='utf-8')
         _mrmr_lib.destroy_mrmr(c_void_p(env))
+        raise MRMRError("Error %d, %s" % (ret, err))
+
+    return env
+
+
+def _column_blocks(data: ndarray):
+    """
+    Yields each first column and the block of columns starting there to send. Data of a supported type is one
+    block as it is. Any other type is converted column by column to the narrowest supported type holding the
+    column's values, one run of consecutive columns of the same type at a time, rather than all to int32.
+    A column with values beyond int32 raises MRMRError rather than wrapping.
+    """
+    if data.dtype.type in _data_type_options:
+        yield 0, data
+        return
+
+    if data.shape[0] == 0:
+        yield 0, ascontiguousarray(data, dtype=int32)
+        return
+
+    lows, highs = data.min(axis=0), data.max(axis=0)
+    for column, (low, high) in enumerate(zip(lows, highs)):
+        if low < -2 ** 31 or high >= 2 ** 31:
+            raise MRMRError("values of column %d do not fit in int32" % column)
+
+    types = [ubyte if low >= 0 and high < 256 else ushort if low >= 0 and high < 65536 else int32
+             for low, high in zip(lows, highs)]
+    first = 0
+    for last in range(1, len(types) + 1):
+        if last == len(types) or types[last] != types[first]:
+            yield first, ascontiguousarray(data[:, first:last], dtype=types[first])
+            first = last
+
+
+class _Environment:
+    """Native environment, destroyed once nothing refers to it."""
+
+    def __init__(self, env: int):
+        self.env = env
+
+    def close(self) -> None:
+        if self.env:
+            _mrmr_lib.destroy_mrmr(c_void_p(self.env))
+            self.env = None
+
+    def __del__(self):
+        self.close()
+
+
+# Types of the columns of the native results buffer, each as long as the results.
+_result_types = [int64, int64, float64, float64, float64]
+
+
+def _results(env: int, owner: _Environment, columns: List[str], num_labels: int) -> List[MRMRResult]:
+    num = c_int()
+    offsets_buf = _mrmr_lib.get_result_offsets(c_void_p(env), byref(num))
+    offsets = [offsets_buf[i] for i in range(num.value)]
+
+    address = _mrmr_lib.get_results(c_void_p(env), byref(num))
+    size = num.value
+    if size == 0:
+        arrays = [empty(0, dtype=dtype) for dtype in _result_types]
+    else:
+        # Each array views its column of the buffer, whose owner stays alive as long as the buffer is referred to
+        buf = (c_char * (size * 8 * len(_result_types))).from_address(address)
+        buf.owner = owner
+        arrays = [frombuffer(buf, dtype=dtype, count=size, offset=column * size * 8)
+                  for column, dtype in enumerate(_result_types)]
+
+    return [MRMRResult(*(array[offsets[i]:offsets[i + 1]] for array in arrays), columns) for i in range(num_labels)]
+
+
+def _lists(result: MRMRResult) -> Tuple[List[str], List[float]]:
+    return result.names(), result.score.tolist()
+
+
+def _set_evaluation(env: int, lazy: bool, sample_rows: int, tolerance: float) -> None:
+    if sample_rows > 0:
+        _mrmr_lib.set_evaluation(c_void_p(env), c_int(2))
+        _mrmr_lib.set_sampling(c_void_p(env), c_size_t(sample_rows), c_double(tolerance))
+    else:
+        _mrmr_lib.set_evaluation(c_void_p(env), c_int(1 if lazy else 0))
+
+
+def _run_mrmr(data: ndarray, names: List[str], labels: List[int], num_features: int, method: MRMRMethod,
+              num_threads: int, lazy: bool, sample_rows: int, tolerance: float,
+              arrays: bool) -> List[Union[Tuple[List[str], List[float]], MRMRResult]]:
+    env = _send_data(data, names, num_threads)
+
+    # Kept alive by the result arrays, which view its buffer
+    owner = _Environment(env)
+
+    try:
+        _set_evaluation(env, lazy, sample_rows, tolerance)
+
+        # Run MRMR
+        if len(labels) == 1:
+            num_ranked = _mrmr_lib.perform_mrmr(c_void_p(env), c_uint(method.value), c_uint(labels[0]),
+                                                c_uint(num_features), c_uint(num_threads))
+        else:
+            c_labels = (c_uint * len(labels))(*labels)
+            num_ranked = _mrmr_lib.perform_mrmr_batch(c_void_p(env), c_uint(method.value), c_labels, c_uint(len(labels)),
+                                                      c_uint(num_features), c_uint(num_threads))
+
+        if num_ranked < 0:
+            # Error occurred
+            err = str(_mrmr_lib.get_last_error(c_void_p(env)), encoding='utf-8')
+            raise MRMRError("Error %d, %s" % (num_ranked, err))
+
+        global _last_stats
+        _last_stats = _mrmr_lib.get_stats(c_void_p(env))
+
+    except BaseException:
+        owner.close()
+        raise
+
+    # Extract results
+    results = _results(env, owner, list(names), len(labels))
+    return results if arrays else [_lists(result) for result in results]
 
 
 class MRMRError(Exception):